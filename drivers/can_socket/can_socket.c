@@ -20,6 +20,9 @@ License along with this library; if not, write to the Free Software
 Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 */
 
+#if defined CO_ENABLE_SHARED_HEARTBEAT && !defined RTCAN_SOCKET
+#define _GNU_SOURCE		/* for sendmmsg */
+#endif
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -66,6 +69,26 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 #include "can_driver.h"
 
+#if defined CO_ENABLE_TXTIME && !defined RTCAN_SOCKET
+#include <time.h>
+#include <linux/net_tstamp.h>
+#ifdef SO_TXTIME
+#define CAN_TXTIME
+#endif
+#endif
+
+#ifdef CAN_TXTIME
+/* Handle returned by canOpen_driver. The socket comes first, so that the
+ * handle can still be used as an (int *). */
+typedef struct {
+  int fd;
+  int txtime; /* SO_TXTIME accepted by the socket */
+} CANSocket;
+#define CAN_HANDLE_SIZE sizeof (CANSocket)
+#else
+#define CAN_HANDLE_SIZE sizeof (int)
+#endif
+
 /*********functions which permit to communicate with the board****************/
 UNS8
 canReceive_driver (CAN_HANDLE fd0, Message * m)
@@ -97,25 +120,32 @@ canReceive_driver (CAN_HANDLE fd0, Message * m)
 
 
 /***************************************************************************/
-UNS8
-canSend_driver (CAN_HANDLE fd0, Message const * m)
+static void
+messageToFrame (Message const * m, struct can_frame *frame)
 {
-  int res;
-  struct can_frame frame;
-
-  frame.can_id = m->cob_id;
-  if (frame.can_id >= 0x800)
-    frame.can_id |= CAN_EFF_FLAG;
-  frame.can_dlc = m->len;
+  frame->can_id = m->cob_id;
+  if (frame->can_id >= 0x800)
+    frame->can_id |= CAN_EFF_FLAG;
+  frame->can_dlc = m->len;
   if (m->rtr)
-    frame.can_id |= CAN_RTR_FLAG;
+    frame->can_id |= CAN_RTR_FLAG;
   else
-    memcpy (frame.data, m->data, 8);
+    memcpy (frame->data, m->data, 8);
 
 #if defined DEBUG_MSG_CONSOLE_ON
   MSG("out : ");
   print_message(m);
 #endif
+}
+
+/***************************************************************************/
+UNS8
+canSend_driver (CAN_HANDLE fd0, Message const * m)
+{
+  int res;
+  struct can_frame frame;
+
+  messageToFrame (m, &frame);
   res = CAN_SEND (*(int *) fd0, &frame, sizeof (frame), 0);
   if (res < 0)
     {
@@ -126,6 +156,101 @@ canSend_driver (CAN_HANDLE fd0, Message const * m)
   return 0;
 }
 
+#ifdef CO_ENABLE_SHARED_HEARTBEAT
+/* Frames given to the kernel in one sendmmsg call */
+#define SEND_BATCH_MAX 64
+
+/***************************************************************************/
+UNS16
+canSendBatch_driver (CAN_HANDLE fd0, Message const * m, UNS16 count)
+{
+#ifdef RTCAN_SOCKET
+  UNS16 sent = 0;
+
+  while (sent < count && canSend_driver (fd0, &m[sent]) == 0)
+    sent++;
+  return sent;
+#else
+  struct can_frame frames[SEND_BATCH_MAX];
+  struct iovec iov[SEND_BATCH_MAX];
+  struct mmsghdr msgs[SEND_BATCH_MAX];
+  UNS16 sent = 0;
+
+  while (sent < count)
+    {
+      int i, res;
+      int n = count - sent < SEND_BATCH_MAX ? count - sent : SEND_BATCH_MAX;
+
+      memset (msgs, 0, n * sizeof (struct mmsghdr));
+      for (i = 0; i < n; i++)
+        {
+          messageToFrame (&m[sent + i], &frames[i]);
+          iov[i].iov_base = &frames[i];
+          iov[i].iov_len = sizeof (struct can_frame);
+          msgs[i].msg_hdr.msg_iov = &iov[i];
+          msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+      res = sendmmsg (*(int *) fd0, msgs, n, 0);
+      if (res < 0)
+        {
+          fprintf (stderr, "Send failed: %s\n", strerror (CAN_ERRNO (res)));
+          break;
+        }
+      sent += res;
+      if (res < n)
+        break;
+    }
+  return sent;
+#endif
+}
+#endif
+
+#ifdef CO_ENABLE_TXTIME
+/***************************************************************************/
+UNS8
+canSendAt_driver (CAN_HANDLE fd0, Message const * m, UNS64 launchTime)
+{
+#ifdef CAN_TXTIME
+  int res;
+  struct can_frame frame;
+  struct iovec iov;
+  struct msghdr msg;
+  struct cmsghdr *cmsg;
+  char control[CMSG_SPACE (sizeof (launchTime))];
+
+  if (!((CANSocket *) fd0)->txtime)
+    return CAN_TXTIME_UNSUPPORTED;
+
+  messageToFrame (m, &frame);
+  iov.iov_base = &frame;
+  iov.iov_len = sizeof (frame);
+  memset (&msg, 0, sizeof (msg));
+  memset (control, 0, sizeof (control));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof (control);
+
+  /* The launch time goes along with the frame, ETF qdisc releases it */
+  cmsg = CMSG_FIRSTHDR (&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_TXTIME;
+  cmsg->cmsg_len = CMSG_LEN (sizeof (launchTime));
+  memcpy (CMSG_DATA (cmsg), &launchTime, sizeof (launchTime));
+
+  res = sendmsg (*(int *) fd0, &msg, 0);
+  if (res < 0)
+    {
+      fprintf (stderr, "Send failed: %s\n", strerror (CAN_ERRNO (res)));
+      return 1;
+    }
+  return 0;
+#else
+  return CAN_TXTIME_UNSUPPORTED;
+#endif
+}
+#endif
+
 /***************************************************************************/
 #ifdef RTCAN_SOCKET
 int
@@ -173,7 +298,7 @@ canOpen_driver (s_BOARD * board)
   struct ifreq ifr;
   struct sockaddr_can addr;
   int err;
-  CAN_HANDLE fd0 = malloc (sizeof (int));
+  CAN_HANDLE fd0 = malloc (CAN_HANDLE_SIZE);
 #ifdef RTCAN_SOCKET
   can_baudrate_t *baudrate;
   can_mode_t *mode;
@@ -225,6 +350,18 @@ canOpen_driver (s_BOARD * board)
     }
   }
 #endif
+
+#ifdef CAN_TXTIME
+  {
+    /* Launch time support is optional : without it, canSendAt_driver reports
+       CAN_TXTIME_UNSUPPORTED and the caller sends immediately. */
+    struct sock_txtime txtime;
+    txtime.clockid = CLOCK_TAI;
+    txtime.flags = 0;
+    ((CANSocket *) fd0)->txtime =
+      CAN_SETSOCKOPT (*(int *) fd0, SOL_SOCKET, SO_TXTIME, &txtime, sizeof (txtime)) == 0;
+  }
+#endif
   
   addr.can_family = AF_CAN;
   addr.can_ifindex = ifr.ifr_ifindex;
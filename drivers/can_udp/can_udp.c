@@ -0,0 +1,418 @@
+/*
+This file is part of CanFestival, a library implementing CanOpen Stack.
+
+Copyright (C): Edouard TISSERANT and Francis DUPIN
+
+See COPYING file for copyrights details.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/*
+	CAN over UDP driver.
+
+	The bus is an UDP port, usually on a multicast group, shared by all the
+	nodes : busname is "address:port[:flush_us]", for instance
+	"239.255.0.1:5000" or "239.255.0.1:5000:200". Each datagram carries
+	several frames : sent frames are buffered and flushed when the datagram
+	is full or flush_us microseconds after the first buffered frame
+	(default CAN_UDP_FLUSH_US, 0 sends every frame in its own datagram).
+
+	Datagram layout (multi-byte fields are little endian) :
+	  magic (2) version (1) count (1) sender (4) sequence (4)
+	  then count records : cob_id (2) rtr << 7 | len (1) data (len)
+
+	Datagrams sent by the port itself are looped back by the kernel and
+	dropped. The sequence number of every other sender is followed, and the
+	missing datagrams are counted and reported.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define NEED_PRINT_MESSAGE
+#include "can_driver.h"
+#include "def.h"
+
+#define CAN_UDP_MAGIC 0xCF01
+#define CAN_UDP_VERSION 1
+#define CAN_UDP_HEADER_SIZE 12
+#define CAN_UDP_RECORD_MAX_SIZE 11
+/* Fits in an Ethernet frame without fragmentation */
+#define CAN_UDP_DATAGRAM_SIZE 1472
+#define CAN_UDP_FLUSH_US 500
+#define CAN_UDP_MAX_PEERS 32
+#define CAN_UDP_RCVBUF_SIZE (1024 * 1024)
+
+typedef struct {
+	UNS32 sender;
+	UNS32 nextSeq;
+} CANUdpPeer;
+
+typedef struct {
+	int fd;
+	struct sockaddr_in dest;
+	UNS32 sender;
+	long flushUs;
+
+	/* Transmission, shared with the flush thread */
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	pthread_t flusher;
+	int running;
+	UNS32 txSeq;
+	UNS8 txCount;
+	int txLen;
+	struct timespec txDeadline;
+	UNS8 txBuf[CAN_UDP_DATAGRAM_SIZE];
+
+	/* Reception, only used by the receive thread */
+	UNS8 rxCount;
+	int rxPos;
+	int rxLen;
+	UNS8 rxBuf[CAN_UDP_DATAGRAM_SIZE];
+	CANUdpPeer peers[CAN_UDP_MAX_PEERS];
+	int nbPeers;
+	UNS32 lost;
+} CANUdpPort;
+
+static UNS32 nbPortsOpened = 0;
+
+static void putUNS16(UNS8* p, UNS16 v)
+{
+	p[0] = (UNS8)v;
+	p[1] = (UNS8)(v >> 8);
+}
+
+static void putUNS32(UNS8* p, UNS32 v)
+{
+	putUNS16(p, (UNS16)v);
+	putUNS16(p + 2, (UNS16)(v >> 16));
+}
+
+static UNS16 getUNS16(const UNS8* p)
+{
+	return (UNS16)(p[0] | (p[1] << 8));
+}
+
+static UNS32 getUNS32(const UNS8* p)
+{
+	return (UNS32)getUNS16(p) | ((UNS32)getUNS16(p + 2) << 16);
+}
+
+/* Send the buffered frames. Called with port->lock held. */
+static int flushFrames(CANUdpPort* port)
+{
+	ssize_t res;
+
+	if (!port->txCount)
+		return 0;
+	port->txBuf[3] = port->txCount;
+	putUNS32(port->txBuf + 8, port->txSeq++);
+	res = sendto(port->fd, port->txBuf, port->txLen, 0,
+		(struct sockaddr*)&port->dest, sizeof(port->dest));
+	port->txCount = 0;
+	port->txLen = CAN_UDP_HEADER_SIZE;
+	if (res < 0) {
+		fprintf(stderr, "can_udp: sendto failed: %s\n", strerror(errno));
+		return 1;
+	}
+	return 0;
+}
+
+static void* flushLoop(void* arg)
+{
+	CANUdpPort* port = (CANUdpPort*)arg;
+
+	pthread_mutex_lock(&port->lock);
+	while (port->running) {
+		if (!port->txCount)
+			pthread_cond_wait(&port->cond, &port->lock);
+		else if (pthread_cond_timedwait(&port->cond, &port->lock,
+				&port->txDeadline) == ETIMEDOUT)
+			flushFrames(port);
+	}
+	flushFrames(port);
+	pthread_mutex_unlock(&port->lock);
+	return NULL;
+}
+
+/* Follow the sequence numbers of a sender and count the lost datagrams */
+static void checkSequence(CANUdpPort* port, UNS32 sender, UNS32 seq)
+{
+	int i;
+	CANUdpPeer* peer = NULL;
+
+	for (i = 0; i < port->nbPeers; i++) {
+		if (port->peers[i].sender == sender) {
+			peer = &port->peers[i];
+			break;
+		}
+	}
+	if (!peer) {
+		if (port->nbPeers == CAN_UDP_MAX_PEERS)
+			return;
+		peer = &port->peers[port->nbPeers++];
+		peer->sender = sender;
+		peer->nextSeq = seq;
+	}
+	if (seq != peer->nextSeq) {
+		/* Late or duplicated datagrams are not counted as lost */
+		if ((INTEGER32)(seq - peer->nextSeq) > 0) {
+			port->lost += seq - peer->nextSeq;
+			fprintf(stderr, "can_udp: %u datagram(s) lost from %08x (%u total)\n",
+				seq - peer->nextSeq, sender, port->lost);
+		}
+	}
+	if ((INTEGER32)(seq - peer->nextSeq) >= 0)
+		peer->nextSeq = seq + 1;
+}
+
+/*********functions which permit to communicate with the board****************/
+UNS8 canReceive_driver(CAN_HANDLE fd0, Message *m)
+{
+	CANUdpPort* port = (CANUdpPort*)fd0;
+	const UNS8* rec;
+
+	while (!port->rxCount) {
+		ssize_t res = recv(port->fd, port->rxBuf, sizeof(port->rxBuf), 0);
+		if (res < 0) {
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "can_udp: recv failed: %s\n", strerror(errno));
+			return 1;
+		}
+		if (res == 0)
+			return 1; /* shutdown by canClose_driver */
+		if (res < CAN_UDP_HEADER_SIZE
+			|| getUNS16(port->rxBuf) != CAN_UDP_MAGIC
+			|| port->rxBuf[2] != CAN_UDP_VERSION
+			|| getUNS32(port->rxBuf + 4) == port->sender)
+			continue;
+		checkSequence(port, getUNS32(port->rxBuf + 4), getUNS32(port->rxBuf + 8));
+		port->rxCount = port->rxBuf[3];
+		port->rxPos = CAN_UDP_HEADER_SIZE;
+		port->rxLen = (int)res;
+	}
+
+	rec = port->rxBuf + port->rxPos;
+	port->rxCount--;
+	if (port->rxPos + 3 > port->rxLen
+		|| (rec[2] & 0x0F) > 8
+		|| port->rxPos + 3 + (rec[2] & 0x0F) > port->rxLen) {
+		/* Truncated or corrupted datagram, drop the remaining frames */
+		port->rxCount = 0;
+		fprintf(stderr, "can_udp: malformed datagram\n");
+		return canReceive_driver(fd0, m);
+	}
+	m->cob_id = getUNS16(rec);
+	m->rtr = rec[2] >> 7;
+	m->len = rec[2] & 0x0F;
+	memcpy(m->data, rec + 3, m->len);
+	port->rxPos += 3 + m->len;
+	return 0;
+}
+
+/***************************************************************************/
+UNS8 canSend_driver(CAN_HANDLE fd0, Message const *m)
+{
+	CANUdpPort* port = (CANUdpPort*)fd0;
+	UNS8* rec;
+	UNS8 len = m->len > 8 ? 8 : m->len;
+	int res = 0;
+
+#if defined DEBUG_MSG_CONSOLE_ON
+	MSG("out : ");
+	print_message(m);
+#endif
+	pthread_mutex_lock(&port->lock);
+	rec = port->txBuf + port->txLen;
+	putUNS16(rec, m->cob_id);
+	rec[2] = (UNS8)((m->rtr ? 0x80 : 0) | len);
+	memcpy(rec + 3, m->data, len);
+	port->txLen += 3 + len;
+	if (!port->txCount++ && port->flushUs) {
+		clock_gettime(CLOCK_MONOTONIC, &port->txDeadline);
+		port->txDeadline.tv_nsec += port->flushUs * 1000;
+		port->txDeadline.tv_sec += port->txDeadline.tv_nsec / 1000000000;
+		port->txDeadline.tv_nsec %= 1000000000;
+		pthread_cond_signal(&port->cond);
+	}
+	if (!port->flushUs || port->txCount == 0xFF
+		|| port->txLen + CAN_UDP_RECORD_MAX_SIZE > CAN_UDP_DATAGRAM_SIZE)
+		res = flushFrames(port);
+	pthread_mutex_unlock(&port->lock);
+	return (UNS8)res;
+}
+
+/***************************************************************************/
+UNS8 canChangeBaudRate_driver( CAN_HANDLE fd0, char* baud)
+{
+	/* No bit rate on UDP */
+	return 0;
+}
+
+/* busname is "address:port[:flush_us]" */
+static int parseBusname(const char* busname, struct sockaddr_in* dest, long* flushUs)
+{
+	char addr[64];
+	const char* sep = strchr(busname, ':');
+	char* end;
+	long udpPort;
+
+	if (!sep || sep - busname >= (int)sizeof(addr))
+		return 1;
+	memcpy(addr, busname, sep - busname);
+	addr[sep - busname] = '\0';
+	memset(dest, 0, sizeof(*dest));
+	dest->sin_family = AF_INET;
+	if (inet_pton(AF_INET, addr, &dest->sin_addr) != 1)
+		return 1;
+	udpPort = strtol(sep + 1, &end, 10);
+	if (end == sep + 1 || udpPort <= 0 || udpPort > 0xFFFF)
+		return 1;
+	dest->sin_port = htons((UNS16)udpPort);
+	*flushUs = CAN_UDP_FLUSH_US;
+	if (*end == ':') {
+		*flushUs = strtol(end + 1, &end, 10);
+		if (*flushUs < 0 || *flushUs >= 1000000)
+			return 1;
+	}
+	return *end != '\0';
+}
+
+/***************************************************************************/
+CAN_HANDLE canOpen_driver(s_BOARD *board)
+{
+	CANUdpPort* port;
+	struct sockaddr_in local;
+	struct timespec now;
+	pthread_condattr_t condattr;
+	int one = 1;
+	int rcvbuf = CAN_UDP_RCVBUF_SIZE;
+
+	port = (CANUdpPort*)calloc(1, sizeof(CANUdpPort));
+	if (!port) {
+		fprintf(stderr, "can_udp: out of memory\n");
+		return NULL;
+	}
+	if (parseBusname(board->busname, &port->dest, &port->flushUs)) {
+		fprintf(stderr, "can_udp: invalid busname %s, expected address:port[:flush_us]\n",
+			board->busname);
+		free(port);
+		return NULL;
+	}
+
+	port->fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (port->fd < 0) {
+		fprintf(stderr, "can_udp: socket failed: %s\n", strerror(errno));
+		free(port);
+		return NULL;
+	}
+	/* Several nodes of the same host share the bus port */
+	setsockopt(port->fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+#ifdef SO_REUSEPORT
+	setsockopt(port->fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+#endif
+	/* Absorb bursts while the receive thread dispatches */
+	setsockopt(port->fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+	memset(&local, 0, sizeof(local));
+	local.sin_family = AF_INET;
+	local.sin_port = port->dest.sin_port;
+	local.sin_addr.s_addr = htonl(INADDR_ANY);
+	if (bind(port->fd, (struct sockaddr*)&local, sizeof(local)) < 0) {
+		fprintf(stderr, "can_udp: bind failed: %s\n", strerror(errno));
+		goto error;
+	}
+	if (IN_MULTICAST(ntohl(port->dest.sin_addr.s_addr))) {
+		struct ip_mreq mreq;
+		mreq.imr_multiaddr = port->dest.sin_addr;
+		mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+		if (setsockopt(port->fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) {
+			fprintf(stderr, "can_udp: multicast join failed: %s\n", strerror(errno));
+			goto error;
+		}
+		/* Nodes of the same host receive the frames too */
+		setsockopt(port->fd, IPPROTO_IP, IP_MULTICAST_LOOP, &one, sizeof(one));
+	}
+
+	clock_gettime(CLOCK_REALTIME, &now);
+	port->sender = ((UNS32)getpid() << 12) ^ (UNS32)now.tv_nsec ^ nbPortsOpened++;
+	putUNS16(port->txBuf, CAN_UDP_MAGIC);
+	port->txBuf[2] = CAN_UDP_VERSION;
+	putUNS32(port->txBuf + 4, port->sender);
+	port->txLen = CAN_UDP_HEADER_SIZE;
+
+	pthread_mutex_init(&port->lock, NULL);
+	pthread_condattr_init(&condattr);
+	pthread_condattr_setclock(&condattr, CLOCK_MONOTONIC);
+	pthread_cond_init(&port->cond, &condattr);
+	pthread_condattr_destroy(&condattr);
+	port->running = 1;
+	if (port->flushUs && pthread_create(&port->flusher, NULL, flushLoop, port)) {
+		fprintf(stderr, "can_udp: cannot start the flush thread\n");
+		pthread_cond_destroy(&port->cond);
+		pthread_mutex_destroy(&port->lock);
+		goto error;
+	}
+	return (CAN_HANDLE)port;
+
+error:
+	close(port->fd);
+	free(port);
+	return NULL;
+}
+
+/***************************************************************************/
+int canClose_driver(CAN_HANDLE fd0)
+{
+	CANUdpPort* port = (CANUdpPort*)fd0;
+
+	if (port) {
+		pthread_mutex_lock(&port->lock);
+		port->running = 0;
+		pthread_cond_signal(&port->cond);
+		if (!port->flushUs)
+			flushFrames(port);
+		pthread_mutex_unlock(&port->lock);
+		/* The flush thread sends the last buffered frames */
+		if (port->flushUs)
+			pthread_join(port->flusher, NULL);
+		/* Wake up the receive thread */
+		shutdown(port->fd, SHUT_RDWR);
+		close(port->fd);
+		pthread_cond_destroy(&port->cond);
+		pthread_mutex_destroy(&port->lock);
+		free(port);
+	}
+	return 0;
+}
+
+/***************************************************************************/
+int canfd_driver(CAN_HANDLE fd0)
+{
+	if ((CANUdpPort*)fd0)
+		return ((CANUdpPort*)fd0)->fd;
+	return -1;
+}
@@ -4,6 +4,10 @@
 #include <pthread.h> 
 #include <signal.h>
 #include <time.h>
+#ifdef CO_ENABLE_CMD_QUEUE
+#include <errno.h>
+#include <semaphore.h>
+#endif
 
 #include "applicfg.h"
 #include "timer.h"
@@ -14,6 +18,16 @@ static struct timeval last_sig;
 
 static timer_t timer;
 
+#ifdef CO_ENABLE_TIMER_CONTEXTS
+/* A single timer thread, so a single timer table */
+static s_timer_context timer_context = TIMER_CONTEXT_INITIALIZER;
+
+s_timer_context* getTimerContext(void)
+{
+	return &timer_context;
+}
+#endif
+
 void TimerCleanup(void)
 {
 	/* only used in realtime apps */
@@ -33,6 +47,32 @@ void LeaveMutex(void)
 	}
 }
 
+#ifdef CO_ENABLE_CMD_QUEUE
+/* Posted commands are run by their own thread, so that TimeDispatch is
+   only called when an alarm is due */
+static pthread_t kick_thread;
+static sem_t kick_sem;
+static int kick_stop;
+
+static void* kick_loop(void* arg)
+{
+	for(;;) {
+		while(sem_wait(&kick_sem) && errno == EINTR);
+		if(__atomic_load_n(&kick_stop, __ATOMIC_ACQUIRE))
+			break;
+		EnterMutex();
+		_runCommandQueues();
+		LeaveMutex();
+	}
+	return NULL;
+}
+
+void TimerKick(void)
+{
+	sem_post(&kick_sem);
+}
+#endif
+
 void timer_notify(sigval_t val)
 {
 	if(gettimeofday(&last_sig,NULL)) {
@@ -68,10 +108,26 @@ void TimerInit(void)
 		perror("timer_create()");
 	}
 #endif
+
+#ifdef CO_ENABLE_CMD_QUEUE
+	sem_init(&kick_sem, 0, 0);
+	kick_stop = 0;
+	if(pthread_create(&kick_thread, NULL, kick_loop, NULL)) {
+		perror("pthread_create()");
+	}
+#endif
 }
 
 void StopTimerLoop(TimerCallback_t exitfunction)
 {
+#ifdef CO_ENABLE_CMD_QUEUE
+	/* The commands still posted are run by the next receive */
+	__atomic_store_n(&kick_stop, 1, __ATOMIC_RELEASE);
+	sem_post(&kick_sem);
+	if(pthread_join(kick_thread, NULL)) {
+		perror("pthread_join()");
+	}
+#endif
 	EnterMutex();
 	if(timer_delete (timer)) {
 		perror("timer_delete()");
@@ -23,6 +23,12 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <unistd.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
+#ifdef CO_ENABLE_RX_QUEUE
+#include <string.h>
+#include <pthread.h>
+#include <semaphore.h>
+#endif
 #else
 #include <linux/module.h>
 #include <linux/delay.h>
@@ -53,12 +59,41 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 #define MAX_NB_CAN_PORTS 16
 
+#ifdef CO_ENABLE_RX_QUEUE
+/* Priority classes of the received frames, dispatched in that order */
+#define RX_CLASS_NMT 0 /* NMT, SYNC, EMCY, TIME, error control */
+#define RX_CLASS_PDO 1
+#define RX_CLASS_SDO 2 /* SDO, LSS */
+#define RX_CLASSES 3
+
+#if RX_QUEUE_SIZE & (RX_QUEUE_SIZE - 1)
+#error RX_QUEUE_SIZE must be a power of 2
+#endif
+
+/** Received frame and its reception time */
+typedef struct {
+  Message m;
+  UNS64 stamp; /**< CLOCK_MONOTONIC, in us */
+} s_rx_entry;
+
+/** Frames of a priority class, from the receive thread to the dispatch thread */
+typedef struct {
+  UNS32 head; /**< Next entry to write, only written by the receive thread */
+  UNS32 tail; /**< Next entry to read, only written by the dispatch thread */
+  s_rx_entry entries[RX_QUEUE_SIZE];
+} s_rx_ring;
+#endif
+
 /** CAN port structure */
 typedef struct {
   char used;  /**< flag indicating CAN port usage, will be used to abort Receiver task*/
   CAN_HANDLE fd; /**< CAN port file descriptor*/
   TASK_HANDLE receiveTask; /**< CAN Receiver task*/
   CO_Data* d; /**< CAN object data*/
+#ifdef CO_ENABLE_RX_QUEUE
+  s_rx_ring rx[RX_CLASSES]; /**< Received frames waiting for the dispatch thread */
+  s_rx_queue_stats rxStats; /**< Receive queue counters */
+#endif
 } CANPort;
 
 #include "can_driver.h"
@@ -108,6 +143,16 @@ LIB_HANDLE LoadCanDriver(const char* driver_name)
 	DLSYM(canOpen)
 	DLSYM(canChangeBaudRate)
 	DLSYM(canClose)
+#ifdef CO_ENABLE_TXTIME
+	/* Optional, drivers without launch time support leave it NULL */
+	*(void **) (&canSendAt_driver) = dlsym(handle, "canSendAt_driver");
+	dlerror();
+#endif
+#ifdef CO_ENABLE_SHARED_HEARTBEAT
+	/* Optional, canSendBatch falls back to canSend without it */
+	*(void **) (&canSendBatch_driver) = dlsym(handle, "canSendBatch_driver");
+	dlerror();
+#endif
 
 	return handle;
 }
@@ -132,6 +177,195 @@ UNS8 canSend(CAN_PORT port, Message *m)
 	return 1; // NOT OK
 }
 
+#ifdef CO_ENABLE_SHARED_HEARTBEAT
+#ifdef NOT_USE_DYNAMIC_LOADING
+/* Statically linked drivers without batch support don't define it */
+UNS16 canSendBatch_driver(CAN_HANDLE, Message const *, UNS16) __attribute__((weak));
+#endif
+
+/**
+ * CAN send routine for several messages
+ * @param port CAN port
+ * @param m CAN messages
+ * @param count number of messages
+ * @return number of messages sent
+ */
+UNS16 canSendBatch(CAN_PORT port, Message *m, UNS16 count)
+{
+	UNS16 sent = 0;
+	if(port){
+		if (&DLL_CALL(canSendBatch) != NULL)
+			return DLL_CALL(canSendBatch)(((CANPort*)port)->fd, m, count);
+		while(sent < count && DLL_CALL(canSend)(((CANPort*)port)->fd, &m[sent]) == 0)
+			sent++;
+	}
+	return sent;
+}
+#endif
+
+#ifdef CO_ENABLE_TXTIME
+#ifdef NOT_USE_DYNAMIC_LOADING
+/* Statically linked drivers without launch time support don't define it */
+UNS8 canSendAt_driver(CAN_HANDLE, Message const *, UNS64) __attribute__((weak));
+#endif
+
+/**
+ * CAN send routine with launch time
+ * @param port CAN port
+ * @param m CAN message
+ * @param launchTime launch time in ns (CLOCK_TAI)
+ * @return success, error or CAN_TXTIME_UNSUPPORTED
+ */
+UNS8 canSendAt(CAN_PORT port, Message *m, UNS64 launchTime)
+{
+	if(port){
+		if (&DLL_CALL(canSendAt) == NULL)
+			return CAN_TXTIME_UNSUPPORTED;
+		return DLL_CALL(canSendAt)(((CANPort*)port)->fd, m, launchTime);
+	}
+	return 1; // NOT OK
+}
+
+/**
+ * Clock used for launch times
+ * @return current CLOCK_TAI time in ns
+ */
+UNS64 canTxTime(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_TAI, &ts);
+	return (UNS64)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+#endif
+
+#ifdef CO_ENABLE_RX_QUEUE
+#define RX_LOAD_ACQUIRE(v)      __atomic_load_n(&(v), __ATOMIC_ACQUIRE)
+#define RX_STORE_RELEASE(v, x)  __atomic_store_n(&(v), (x), __ATOMIC_RELEASE)
+
+/* Dispatch thread, running while a CAN port is open */
+static TASK_HANDLE rx_dispatch_task;
+static volatile char rx_dispatch_running = 0;
+/* One token per queued frame */
+static sem_t rx_pending;
+
+static UNS64 rxTime(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (UNS64)ts.tv_sec * 1000000ull + ts.tv_nsec / 1000;
+}
+
+/**
+ * Priority class of a received frame, from its function code
+ * @param m CAN message
+ * @return RX_CLASS_NMT, RX_CLASS_PDO or RX_CLASS_SDO
+ */
+static int rxClass(Message const *m)
+{
+	if (m->cob_id > 0x7FF)
+		return RX_CLASS_PDO; /* Extended identifiers are only used by PDOs */
+	switch (m->cob_id >> 7) {
+	case 0x0: /* NMT */
+	case 0x1: /* SYNC, EMCY */
+	case 0x2: /* TIME */
+	case 0xE: /* Heartbeat, node guarding */
+		return RX_CLASS_NMT;
+	case 0xB: /* SDO */
+	case 0xC:
+	case 0xF: /* LSS */
+		return RX_CLASS_SDO;
+	default:
+		return RX_CLASS_PDO;
+	}
+}
+
+/**
+ * Queue a received frame, called by the receive thread of the port
+ * @param port CAN port
+ * @param m CAN message
+ */
+static void rxQueuePush(CANPort *port, Message const *m)
+{
+	s_rx_ring *ring = &port->rx[rxClass(m)];
+	UNS32 head = ring->head;
+	UNS32 used = head - RX_LOAD_ACQUIRE(ring->tail);
+
+	port->rxStats.received++;
+	if (used >= RX_QUEUE_SIZE) {
+		port->rxStats.dropped++;
+		return;
+	}
+	if (used + 1 > port->rxStats.high_water)
+		port->rxStats.high_water = used + 1;
+	ring->entries[head & (RX_QUEUE_SIZE - 1)].m = *m;
+	ring->entries[head & (RX_QUEUE_SIZE - 1)].stamp = rxTime();
+	RX_STORE_RELEASE(ring->head, head + 1);
+	sem_post(&rx_pending);
+}
+
+/**
+ * Take the oldest frame of the highest priority class, the ports of a
+ * class being served in turn
+ * @param m CAN message
+ * @return the port of the frame, NULL if the queues are empty
+ */
+static CANPort *rxQueuePop(Message *m)
+{
+	static int next_port = 0;
+	int c, i;
+
+	for (c = 0; c < RX_CLASSES; c++) {
+		for (i = 0; i < MAX_NB_CAN_PORTS; i++) {
+			CANPort *port = &canports[(next_port + i) % MAX_NB_CAN_PORTS];
+			s_rx_ring *ring = &port->rx[c];
+			UNS32 tail = ring->tail;
+			UNS64 latency;
+
+			if (!port->used || RX_LOAD_ACQUIRE(ring->head) == tail)
+				continue;
+			*m = ring->entries[tail & (RX_QUEUE_SIZE - 1)].m;
+			latency = rxTime() - ring->entries[tail & (RX_QUEUE_SIZE - 1)].stamp;
+			RX_STORE_RELEASE(ring->tail, tail + 1);
+			if (latency > port->rxStats.max_latency_us)
+				port->rxStats.max_latency_us = (UNS32)latency;
+			next_port = (next_port + i + 1) % MAX_NB_CAN_PORTS;
+			return port;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Dispatch Task, processes the queued frames of all the ports
+ */
+static void canDispatchLoop(void)
+{
+	Message m;
+	CANPort *port;
+
+	while (rx_dispatch_running) {
+		if (sem_wait(&rx_pending) != 0)
+			continue;
+		/* Frames of a closed port are left, their token finds nothing */
+		if ((port = rxQueuePop(&m)) == NULL)
+			continue;
+		EnterMutex();
+		canDispatch(port->d, &m);
+		LeaveMutex();
+	}
+}
+
+/**
+ * Receive queue counters of a port
+ * @param port CAN port
+ * @param stats counters, copied
+ */
+void canRxQueueStats(CAN_PORT port, s_rx_queue_stats *stats)
+{
+	*stats = ((CANPort*)port)->rxStats;
+}
+#endif
+
 /**
  * CAN Receiver Task
  * @param port CAN port
@@ -140,13 +374,25 @@ void canReceiveLoop(CAN_PORT port)
 {
        Message m;
 
+#ifdef CO_ENABLE_RX_QUEUE
+       /* Started without port, the task is the dispatch thread */
+       if (port == NULL) {
+               canDispatchLoop();
+               return;
+       }
+#endif
+
        while (((CANPort*)port)->used) {
                if (DLL_CALL(canReceive)(((CANPort*)port)->fd, &m) != 0)
                        break;
 
+#ifdef CO_ENABLE_RX_QUEUE
+               rxQueuePush((CANPort*)port, &m);
+#else
                EnterMutex();
                canDispatch(((CANPort*)port)->d, &m);
                LeaveMutex();
+#endif
        }
 }
 
@@ -173,6 +419,15 @@ CAN_PORT canOpen(s_BOARD *board, CO_Data * d)
 #endif
 	CAN_HANDLE fd0 = DLL_CALL(canOpen)(board);
 	if(fd0){
+#ifdef CO_ENABLE_RX_QUEUE
+		memset(canports[i].rx, 0, sizeof(canports[i].rx));
+		memset(&canports[i].rxStats, 0, sizeof(canports[i].rxStats));
+		if (!rx_dispatch_running) {
+			sem_init(&rx_pending, 0, 0);
+			rx_dispatch_running = 1;
+			CreateReceiveTask(NULL, &rx_dispatch_task, &canReceiveLoop);
+		}
+#endif
 		canports[i].used = 1;
 		canports[i].fd = fd0;
 		canports[i].d = d;
@@ -203,6 +458,20 @@ int canClose(CO_Data * d)
         WaitReceiveTaskEnd(&port->receiveTask);
 
         d->canHandle = NULL;
+
+#ifdef CO_ENABLE_RX_QUEUE
+        {
+            int i;
+            for (i = 0; i < MAX_NB_CAN_PORTS && !canports[i].used; i++);
+            if (i == MAX_NB_CAN_PORTS && rx_dispatch_running) {
+                /* Last port closed, the dispatch thread ends by itself */
+                rx_dispatch_running = 0;
+                sem_post(&rx_pending);
+                pthread_join(rx_dispatch_task, NULL);
+                sem_destroy(&rx_pending);
+            }
+        }
+#endif
     }
 
 	return res;
@@ -0,0 +1,824 @@
+/*
+This file is part of CanFestival, a library implementing CanOpen Stack.
+
+Copyright (C): Edouard TISSERANT and Francis DUPIN
+
+See COPYING file for copyrights details.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/*
+	Offline decoder of the PDOs of a candump log.
+
+	The dictionaries of the nodes are linked in the decoder, see DICTS in
+	the Makefile. For each node given with -d, the dictionary is set to its
+	node-id and each valid PDO is compiled to an unpack plan: the COB-ID,
+	then for each mapped object its bit offset, its size and its type. The
+	TPDOs of all the nodes are planned first, then the RPDOs whose COB-ID
+	no TPDO produces, a master mapping the TPDOs of nodes not given.
+
+	The log is read by large chunks and its frames are parsed into a batch,
+	the frames of a COB-ID with no plan being dropped at once. The frames
+	of a batch are then grouped by plan, and each signal of a plan is
+	unpacked over all the frames of the plan by a loop with no branch: a
+	shift and a mask of the 8 data bytes loaded as a little endian integer,
+	as copyBits() does in pdo.c, then the sign extension or the reading as
+	a float. The compiler vectorizes these loops.
+
+	The output is columnar: with -o, each plan is a table of the directory,
+	one file of doubles per column, a time column (s) and one column per
+	signal. A signal not in a frame too short is NaN, as proceedPDO()
+	leaves the object. columns.txt lists the columns.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <math.h>
+#include <sys/time.h>
+
+#include "canfestival.h"
+#include "objacces.h"
+
+/* Dictionaries linked in the decoder, see Makefile */
+extern CO_Data* const log_dicts[];
+extern const char* const log_dict_names[];
+extern const int log_dicts_count;
+
+#define LOG_MAX_PLANS 2048
+#define LOG_MAX_SIGNALS 64
+#define LOG_CHUNK (64 << 20)
+
+/* Types of the signals */
+#define LOG_UNSIGNED 0
+#define LOG_SIGNED 1
+#define LOG_REAL32 2
+#define LOG_REAL64 3
+
+typedef struct {
+	UNS16 index;
+	UNS8 subIndex;
+	UNS8 shift;                  /* bit offset in the data */
+	UNS8 bits;
+	UNS8 type;                   /* LOG_... */
+	UNS8 needed;                 /* bytes of the frame holding the signal */
+	char column[8];
+} log_signal;
+
+typedef struct {
+	UNS16 cob_id;
+	int dict;
+	UNS8 nodeId;
+	UNS16 pdo;                   /* communication parameter, 0x1400 or 0x1800 + n */
+	int signals_count;
+	log_signal signals[LOG_MAX_SIGNALS];
+	unsigned long rows;
+} log_plan;
+
+/* Frames of a batch, in log order then grouped by plan */
+typedef struct {
+	double *time;
+	UNS64 *data;
+	UNS8 *len;
+	short *plan;
+	double *group_time;
+	UNS64 *group_data;
+	UNS8 *group_len;
+	double *column;
+	int count;
+} log_batch;
+
+static log_plan plans[LOG_MAX_PLANS];
+static int plans_count;
+static short plan_of_cob[0x800];
+static const char *output_dir;
+static int batch_size = 1 << 20;
+static int print_plans;
+static signed char hex[256];
+static const char *type_names[] = {"unsigned", "signed", "real32", "real64"};
+
+static unsigned long lines, frames, unplanned, skipped, malformed;
+static double parse_seconds, decode_seconds, write_seconds;
+
+static double log_now(void)
+{
+	struct timeval t;
+	gettimeofday(&t, NULL);
+	return t.tv_sec + t.tv_usec / 1e6;
+}
+
+/*****************************  Unpack plans  ******************************/
+
+static UNS8 log_signal_type(UNS8 dataType)
+{
+	switch(dataType)
+	{
+		case int8: case int16: case int24: case int32:
+		case int40: case int48: case int56: case int64:
+			return LOG_SIGNED;
+		case real32:
+			return LOG_REAL32;
+		case real64:
+			return LOG_REAL64;
+		default:
+			return LOG_UNSIGNED;
+	}
+}
+
+/* Append to a column file, created empty with NULL. The files are only
+   open while written, a log may have thousands of columns. */
+static int log_column(log_plan *p, const char *column, const double *values, int n)
+{
+	char path[1024];
+	FILE *f;
+
+	snprintf(path, sizeof(path), "%s/%03X_%s.f64", output_dir, p->cob_id, column);
+	f = fopen(path, values ? "ab" : "wb");
+	if(!f || (n && fwrite(values, sizeof(double), n, f) != (size_t)n))
+	{
+		perror(path);
+		if(f)
+			fclose(f);
+		return 1;
+	}
+	fclose(f);
+	return 0;
+}
+
+/* Plan a PDO of a dictionary, 0 if planned or not valid */
+static int log_plan_pdo(int dict, UNS16 com, UNS16 map)
+{
+	CO_Data *d = log_dicts[dict];
+	const subindex *comEntry = d->objdict[com].pSubindex;
+	const subindex *mapEntry = d->objdict[map].pSubindex;
+	UNS32 cob_id = *(UNS32*)comEntry[1].pObject;
+	UNS8 count = *(UNS8*)mapEntry[0].pObject;
+	UNS16 offset = 0;
+	log_plan *p;
+	int i;
+
+	/* Not valid, or 29 bits identifier */
+	if(cob_id & 0xA0000000)
+		return 0;
+	cob_id &= 0x7FF;
+	if(plan_of_cob[cob_id] >= 0)
+	{
+		log_plan *o = &plans[plan_of_cob[cob_id]];
+		if(o->dict != dict || o->nodeId != *d->bDeviceNodeId)
+			fprintf(stderr, "COB-ID 0x%03X of %s node %d 0x%04X already decoded as %s node %d 0x%04X\n",
+				cob_id, log_dict_names[dict], *d->bDeviceNodeId, d->objdict[com].index,
+				log_dict_names[o->dict], o->nodeId, o->pdo);
+		return 0;
+	}
+	if(plans_count == LOG_MAX_PLANS)
+	{
+		fprintf(stderr, "More than %d PDOs\n", LOG_MAX_PLANS);
+		return 1;
+	}
+	p = &plans[plans_count];
+	memset(p, 0, sizeof(*p));
+	p->cob_id = cob_id;
+	p->dict = dict;
+	p->nodeId = *d->bDeviceNodeId;
+	p->pdo = d->objdict[com].index;
+
+	for(i = 0; i < count && i < LOG_MAX_SIGNALS; i++)
+	{
+		UNS32 mapping = *(UNS32*)mapEntry[i + 1].pObject;
+		log_signal *s = &p->signals[p->signals_count];
+		const subindex *entry;
+		UNS8 bits = mapping & 0xFF;
+
+		/* Entries not fitting are skipped, as buildPDO() and proceedPDO() do */
+		if(!bits || offset + bits > 64)
+			continue;
+		s->index = mapping >> 16;
+		s->subIndex = (mapping >> 8) & 0xFF;
+		s->shift = offset;
+		s->bits = bits;
+		s->needed = (offset + bits + 7) >> 3;
+		snprintf(s->column, sizeof(s->column), "%04X_%02X", s->index, s->subIndex);
+		offset += bits;
+		/* Dummy entries, of a data type index, only take room */
+		if(s->index < 0x20)
+			continue;
+		if(_findODentry(d, s->index, s->subIndex, &entry) == OD_SUCCESSFUL)
+			s->type = log_signal_type(entry->bDataType);
+		else
+			fprintf(stderr, "0x%04X/%d mapped in 0x%04X of %s is not in the dictionary, decoded as unsigned\n",
+				s->index, s->subIndex, p->pdo, log_dict_names[dict]);
+		p->signals_count++;
+	}
+	if(!p->signals_count)
+		return 0;
+
+	if(output_dir)
+	{
+		if(log_column(p, "time", NULL, 0))
+			return 1;
+		for(i = 0; i < p->signals_count; i++)
+			if(log_column(p, p->signals[i].column, NULL, 0))
+				return 1;
+	}
+	plan_of_cob[cob_id] = plans_count++;
+	return 0;
+}
+
+/* Plan the TPDOs or the RPDOs of a node */
+static int log_plan_node(int dict, UNS8 nodeId, int transmit)
+{
+	CO_Data *d = log_dicts[dict];
+	UNS16 com = transmit ? d->firstIndex->PDO_TRS : d->firstIndex->PDO_RCV;
+	UNS16 last = transmit ? d->lastIndex->PDO_TRS : d->lastIndex->PDO_RCV;
+	UNS16 map = transmit ? d->firstIndex->PDO_TRS_MAP : d->firstIndex->PDO_RCV_MAP;
+
+	setNodeId(d, nodeId);
+	if(!com || !map)
+		return 0;
+	for(; com <= last; com++, map++)
+		if(log_plan_pdo(dict, com, map))
+			return 1;
+	return 0;
+}
+
+/* Nodes given with -d */
+typedef struct {
+	int dict;
+	UNS8 first;
+	UNS8 last;
+} log_nodes;
+
+static log_nodes nodes[256];
+static int nodes_count;
+
+static int log_add_nodes(char *arg)
+{
+	char *range = strchr(arg, ':');
+	log_nodes *n = &nodes[nodes_count];
+	int first, last;
+
+	if(nodes_count == 256)
+		return 1;
+	if(range)
+		*range++ = 0;
+	for(n->dict = 0; n->dict < log_dicts_count; n->dict++)
+		if(!strcmp(log_dict_names[n->dict], arg))
+			break;
+	if(n->dict == log_dicts_count)
+	{
+		fprintf(stderr, "No dictionary %s linked, see DICTS in the Makefile\n", arg);
+		return 1;
+	}
+	if(range)
+	{
+		if(sscanf(range, "%d-%d", &first, &last) != 2)
+			last = first = atoi(range);
+	}
+	else
+		last = first = *log_dicts[n->dict]->bDeviceNodeId;
+	if(first < 1 || first > last || last > 127)
+	{
+		fprintf(stderr, "Invalid node-id %s for %s\n", range ? range : "0", arg);
+		return 1;
+	}
+	n->first = first;
+	n->last = last;
+	nodes_count++;
+	return 0;
+}
+
+static int log_compile(void)
+{
+	int i, id, transmit;
+
+	for(i = 0; i < 0x800; i++)
+		plan_of_cob[i] = -1;
+	for(transmit = 1; transmit >= 0; transmit--)
+		for(i = 0; i < nodes_count; i++)
+			for(id = nodes[i].first; id <= nodes[i].last; id++)
+				if(log_plan_node(nodes[i].dict, id, transmit))
+					return 1;
+	return 0;
+}
+
+static void log_print_plans(void)
+{
+	int i, j;
+
+	for(i = 0; i < plans_count; i++)
+	{
+		log_plan *p = &plans[i];
+		printf("0x%03X %s node %d 0x%04X\n", p->cob_id, log_dict_names[p->dict], p->nodeId, p->pdo);
+		for(j = 0; j < p->signals_count; j++)
+		{
+			log_signal *s = &p->signals[j];
+			printf("  0x%04X/%d bits %d-%d %s\n", s->index, s->subIndex, s->shift,
+				s->shift + s->bits - 1, type_names[s->type]);
+		}
+	}
+}
+
+/******************************  Log parsing  ******************************/
+
+/*
+	Lines of candump -l, or of candump with or without -t:
+	(1436509052.249713) can0 181#11223344
+	(1436509052.249713)  can0  181   [4]  11 22 33 44
+	  can0  181   [4]  11 22 33 44
+	Remote, extended and FD frames are skipped.
+*/
+static const char* log_parse_line(const char *c, const char *end, log_batch *b)
+{
+	const char *eol = memchr(c, '\n', end - c);
+	double time = 0;
+	UNS32 cob_id = 0;
+	UNS64 data = 0;
+	int len = 0, digits;
+
+	if(!eol)
+		eol = end;
+	lines++;
+	while(c < eol && (*c == ' ' || *c == '\t'))
+		c++;
+	if(c < eol && *c == '(')
+	{
+		UNS64 sec = 0, frac = 0, scale = 1;
+		for(c++; c < eol && *c >= '0' && *c <= '9'; c++)
+			sec = sec * 10 + (*c - '0');
+		if(c < eol && *c == '.')
+			for(c++; c < eol && *c >= '0' && *c <= '9'; c++)
+			{
+				frac = frac * 10 + (*c - '0');
+				scale *= 10;
+			}
+		time = sec + (double)frac / scale;
+		while(c < eol && *c != ' ')
+			c++;
+		while(c < eol && *c == ' ')
+			c++;
+	}
+	/* Interface */
+	while(c < eol && *c != ' ' && *c != '\t')
+		c++;
+	while(c < eol && (*c == ' ' || *c == '\t'))
+		c++;
+	/* Identifier */
+	for(digits = 0; c < eol && hex[(UNS8)*c] >= 0; c++, digits++)
+		cob_id = (cob_id << 4) | hex[(UNS8)*c];
+	if(!digits || c == eol)
+	{
+		malformed++;
+		return eol + 1;
+	}
+	if(digits > 3 || cob_id > 0x7FF)
+	{
+		skipped++;
+		return eol + 1;
+	}
+	if(plan_of_cob[cob_id] < 0)
+	{
+		unplanned++;
+		return eol + 1;
+	}
+	if(*c == '#')
+	{
+		c++;
+		if(c < eol && (*c == 'R' || *c == '#'))
+		{
+			skipped++;
+			return eol + 1;
+		}
+		for(; c + 1 < eol && hex[(UNS8)c[0]] >= 0 && hex[(UNS8)c[1]] >= 0 && len < 8; c += 2, len++)
+			data |= (UNS64)((hex[(UNS8)c[0]] << 4) | hex[(UNS8)c[1]]) << (len * 8);
+	}
+	else
+	{
+		int dlc;
+		while(c < eol && *c == ' ')
+			c++;
+		if(c + 2 >= eol || *c != '[' || c[1] < '0' || c[1] > '8' || c[2] != ']')
+		{
+			malformed++;
+			return eol + 1;
+		}
+		dlc = c[1] - '0';
+		for(c += 3; len < dlc; len++)
+		{
+			while(c < eol && *c == ' ')
+				c++;
+			if(c + 1 >= eol || hex[(UNS8)c[0]] < 0 || hex[(UNS8)c[1]] < 0)
+			{
+				/* "remote request" */
+				skipped++;
+				return eol + 1;
+			}
+			data |= (UNS64)((hex[(UNS8)c[0]] << 4) | hex[(UNS8)c[1]]) << (len * 8);
+			c += 2;
+		}
+	}
+	b->time[b->count] = time;
+	b->data[b->count] = data;
+	b->len[b->count] = len;
+	b->plan[b->count] = plan_of_cob[cob_id];
+	b->count++;
+	frames++;
+	return eol + 1;
+}
+
+/*****************************  Unpack kernels  ****************************/
+
+/* The loops have no branch, so that the compiler vectorizes them. The
+   signals of 32 bits at most are converted from 32 bits integers, the
+   conversion of 64 bits integers to doubles needing AVX-512. */
+static void log_unpack_unsigned32(const UNS64 *data, const UNS8 *len, int n, const log_signal *s, double *out)
+{
+	UNS32 mask = s->bits == 32 ? ~(UNS32)0 : ((UNS32)1 << s->bits) - 1;
+	int shift = s->shift, needed = s->needed, i;
+	double v;
+
+	for(i = 0; i < n; i++)
+	{
+		/* Biased to a signed integer */
+		v = (double)(INTEGER32)(((UNS32)(data[i] >> shift) & mask) ^ 0x80000000) + 2147483648.0;
+		out[i] = len[i] >= needed ? v : NAN;
+	}
+}
+
+static void log_unpack_signed32(const UNS64 *data, const UNS8 *len, int n, const log_signal *s, double *out)
+{
+	int shift = s->shift, up = 32 - s->bits, needed = s->needed, i;
+	double v;
+
+	for(i = 0; i < n; i++)
+	{
+		v = (INTEGER32)((UNS32)(data[i] >> shift) << up) >> up;
+		out[i] = len[i] >= needed ? v : NAN;
+	}
+}
+
+static void log_unpack_unsigned(const UNS64 *data, const UNS8 *len, int n, const log_signal *s, double *out)
+{
+	UNS64 mask = s->bits == 64 ? ~(UNS64)0 : ((UNS64)1 << s->bits) - 1;
+	int shift = s->shift, needed = s->needed, i;
+	double v;
+
+	for(i = 0; i < n; i++)
+	{
+		v = (double)((data[i] >> shift) & mask);
+		out[i] = len[i] >= needed ? v : NAN;
+	}
+}
+
+static void log_unpack_signed(const UNS64 *data, const UNS8 *len, int n, const log_signal *s, double *out)
+{
+	int up = 64 - s->shift - s->bits, down = 64 - s->bits, needed = s->needed, i;
+	double v;
+
+	for(i = 0; i < n; i++)
+	{
+		v = (double)((INTEGER64)(data[i] << up) >> down);
+		out[i] = len[i] >= needed ? v : NAN;
+	}
+}
+
+static void log_unpack_real32(const UNS64 *data, const UNS8 *len, int n, const log_signal *s, double *out)
+{
+	int shift = s->shift, needed = s->needed, i;
+	UNS32 v;
+	float f;
+
+	for(i = 0; i < n; i++)
+	{
+		v = (UNS32)(data[i] >> shift);
+		memcpy(&f, &v, sizeof(f));
+		out[i] = len[i] >= needed ? f : NAN;
+	}
+}
+
+static void log_unpack_real64(const UNS64 *data, const UNS8 *len, int n, const log_signal *s, double *out)
+{
+	int needed = s->needed, i;
+	double f;
+
+	for(i = 0; i < n; i++)
+	{
+		memcpy(&f, &data[i], sizeof(f));
+		out[i] = len[i] >= needed ? f : NAN;
+	}
+}
+
+/* Group the frames of the batch by plan, then unpack each signal of each plan */
+static int log_decode(log_batch *b)
+{
+	static int start[LOG_MAX_PLANS + 1];
+	int i, j, k, n;
+	double t0 = log_now(), t1;
+
+	memset(start, 0, (plans_count + 1) * sizeof(int));
+	for(i = 0; i < b->count; i++)
+		start[b->plan[i] + 1]++;
+	for(i = 0; i < plans_count; i++)
+		start[i + 1] += start[i];
+	for(i = 0; i < b->count; i++)
+	{
+		k = start[b->plan[i]]++;
+		b->group_time[k] = b->time[i];
+		b->group_data[k] = b->data[i];
+		b->group_len[k] = b->len[i];
+	}
+	/* start[i] is now the end of plan i */
+	for(i = 0, k = 0; i < plans_count; k = start[i++])
+	{
+		log_plan *p = &plans[i];
+		const UNS64 *data = b->group_data + k;
+		const UNS8 *len = b->group_len + k;
+
+		n = start[i] - k;
+		if(!n)
+			continue;
+		p->rows += n;
+		t1 = log_now();
+		decode_seconds += t1 - t0;
+		if(output_dir && log_column(p, "time", b->group_time + k, n))
+			return 1;
+		t0 = log_now();
+		write_seconds += t0 - t1;
+		for(j = 0; j < p->signals_count; j++)
+		{
+			log_signal *s = &p->signals[j];
+			switch(s->type)
+			{
+				case LOG_SIGNED:
+					if(s->bits <= 32)
+						log_unpack_signed32(data, len, n, s, b->column);
+					else
+						log_unpack_signed(data, len, n, s, b->column);
+					break;
+				case LOG_REAL32: log_unpack_real32(data, len, n, s, b->column); break;
+				case LOG_REAL64: log_unpack_real64(data, len, n, s, b->column); break;
+				default:
+					if(s->bits <= 32)
+						log_unpack_unsigned32(data, len, n, s, b->column);
+					else
+						log_unpack_unsigned(data, len, n, s, b->column);
+					break;
+			}
+			t1 = log_now();
+			decode_seconds += t1 - t0;
+			if(output_dir && log_column(p, s->column, b->column, n))
+				return 1;
+			t0 = log_now();
+			write_seconds += t0 - t1;
+		}
+	}
+	decode_seconds += log_now() - t0;
+	b->count = 0;
+	return 0;
+}
+
+static int log_read(FILE *in, log_batch *b)
+{
+	char *chunk = malloc(LOG_CHUNK + 1);
+	size_t kept = 0, got;
+	const char *c, *end;
+	double t0;
+
+	if(!chunk)
+		return 1;
+	for(;;)
+	{
+		t0 = log_now();
+		got = fread(chunk + kept, 1, LOG_CHUNK - kept, in);
+		end = chunk + kept + got;
+		if(!got && !kept)
+			break;
+		/* Last line of the chunk parsed with the next one */
+		if(got)
+		{
+			const char *last = end;
+			while(last > chunk && last[-1] != '\n')
+				last--;
+			if(last == chunk && kept + got == LOG_CHUNK)
+			{
+				fprintf(stderr, "Line longer than %d bytes\n", LOG_CHUNK);
+				free(chunk);
+				return 1;
+			}
+			end = last;
+		}
+		for(c = chunk; c < end;)
+		{
+			if(*c == '\n')
+			{
+				c++;
+				continue;
+			}
+			c = log_parse_line(c, end, b);
+			if(b->count == batch_size)
+			{
+				parse_seconds += log_now() - t0;
+				if(log_decode(b))
+				{
+					free(chunk);
+					return 1;
+				}
+				t0 = log_now();
+			}
+		}
+		kept = chunk + kept + got - end;
+		memmove(chunk, end, kept);
+		parse_seconds += log_now() - t0;
+		if(!got)
+			break;
+	}
+	free(chunk);
+	return b->count ? log_decode(b) : 0;
+}
+
+/******************************  Output  ***********************************/
+
+static int log_manifest(void)
+{
+	char path[1024];
+	FILE *f;
+	int i, j;
+
+	snprintf(path, sizeof(path), "%s/columns.txt", output_dir);
+	f = fopen(path, "w");
+	if(!f)
+	{
+		perror(path);
+		return 1;
+	}
+	fprintf(f, "# file rows cob-id dictionary node-id pdo index subindex bits type\n");
+	for(i = 0; i < plans_count; i++)
+	{
+		log_plan *p = &plans[i];
+		fprintf(f, "%03X_time.f64 %lu 0x%03X %s %d 0x%04X - - - time\n", p->cob_id, p->rows, p->cob_id,
+			log_dict_names[p->dict], p->nodeId, p->pdo);
+		for(j = 0; j < p->signals_count; j++)
+		{
+			log_signal *s = &p->signals[j];
+			fprintf(f, "%03X_%s.f64 %lu 0x%03X %s %d 0x%04X 0x%04X %d %d %s\n", p->cob_id, s->column,
+				p->rows, p->cob_id, log_dict_names[p->dict], p->nodeId, p->pdo,
+				s->index, s->subIndex, s->bits, type_names[s->type]);
+		}
+	}
+	fclose(f);
+	return 0;
+}
+
+/* The library sends nothing, the dictionaries are only read */
+UNS8 canSend(CAN_PORT port, Message *m)
+{
+	return 0;
+}
+
+void setTimer(TIMEVAL value)
+{
+}
+
+TIMEVAL getElapsedTime(void)
+{
+	return 0;
+}
+
+#ifdef CO_ENABLE_LSS
+UNS8 canChangeBaudRate(CAN_PORT port, char* baud)
+{
+	return 0;
+}
+#endif
+
+#ifdef CO_ENABLE_SHARED_HEARTBEAT
+UNS16 canSendBatch(CAN_PORT port, Message *m, UNS16 count)
+{
+	return count;
+}
+#endif
+
+#ifdef CO_ENABLE_TXTIME
+UNS8 canSendAt(CAN_PORT port, Message *m, UNS64 launchTime)
+{
+	return CAN_TXTIME_UNSUPPORTED;
+}
+
+UNS64 canTxTime(void)
+{
+	return 0;
+}
+#endif
+
+#ifdef CO_ENABLE_TIMER_CONTEXTS
+static s_timer_context log_timers = TIMER_CONTEXT_INITIALIZER;
+
+s_timer_context* getTimerContext(void)
+{
+	return &log_timers;
+}
+#endif
+
+#ifdef CO_ENABLE_CMD_QUEUE
+void TimerKick(void)
+{
+}
+#endif
+
+static void help(void)
+{
+	int i;
+
+	printf("Usage: CANLogDecode -d dictionary[:node-id[-node-id]] [-d ...] [-o directory] [-b frames] [-p] [log]\n");
+	printf("  -d : nodes of a dictionary, its node-id by default. Dictionaries linked :");
+	for(i = 0; i < log_dicts_count; i++)
+		printf(" %s", log_dict_names[i]);
+	printf("\n");
+	printf("  -o : write the columns of each PDO in this directory, none by default\n");
+	printf("  -b : frames decoded per batch (%d)\n", batch_size);
+	printf("  -p : print the unpack plans\n");
+	printf("  log : candump log, standard input by default\n");
+}
+
+int main(int argc, char **argv)
+{
+	log_batch b;
+	FILE *in = stdin;
+	double t0, seconds;
+	int c, i;
+
+	while((c = getopt(argc, argv, "d:o:b:ph")) != EOF)
+	{
+		switch(c)
+		{
+			case 'd': if(log_add_nodes(optarg)) return 1; break;
+			case 'o': output_dir = optarg; break;
+			case 'b': batch_size = atoi(optarg); break;
+			case 'p': print_plans = 1; break;
+			default: help(); return c == 'h' ? 0 : 1;
+		}
+	}
+	if(!nodes_count || batch_size < 1)
+	{
+		help();
+		return 1;
+	}
+	if(optind < argc && !(in = fopen(argv[optind], "r")))
+	{
+		perror(argv[optind]);
+		return 1;
+	}
+
+	memset(hex, -1, sizeof(hex));
+	for(i = 0; i < 10; i++)
+		hex['0' + i] = i;
+	for(i = 0; i < 6; i++)
+		hex['A' + i] = hex['a' + i] = 10 + i;
+
+	if(log_compile())
+		return 1;
+	if(print_plans)
+		log_print_plans();
+
+	memset(&b, 0, sizeof(b));
+	b.time = malloc(batch_size * sizeof(double));
+	b.data = malloc(batch_size * sizeof(UNS64));
+	b.len = malloc(batch_size);
+	b.plan = malloc(batch_size * sizeof(short));
+	b.group_time = malloc(batch_size * sizeof(double));
+	b.group_data = malloc(batch_size * sizeof(UNS64));
+	b.group_len = malloc(batch_size);
+	b.column = malloc(batch_size * sizeof(double));
+	if(!b.time || !b.data || !b.len || !b.plan || !b.group_time || !b.group_data || !b.group_len || !b.column)
+	{
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+
+	t0 = log_now();
+	if(log_read(in, &b))
+		return 1;
+	seconds = log_now() - t0;
+	if(output_dir && log_manifest())
+		return 1;
+
+	printf("%d PDOs planned, %lu lines : %lu PDO frames decoded, %lu frames of other COB-IDs, %lu skipped, %lu malformed\n",
+		plans_count, lines, frames, unplanned, skipped, malformed);
+	printf("%.2f s : %.0f lines/s, parsing %.2f s, unpacking %.3f s (%.0f frames/s), writing %.2f s\n",
+		seconds, lines / seconds, parse_seconds, decode_seconds,
+		decode_seconds > 0 ? frames / decode_seconds : 0, write_seconds);
+	return 0;
+}
@@ -0,0 +1,901 @@
+/*
+This file is part of CanFestival, a library implementing CanOpen Stack.
+
+Copyright (C): Edouard TISSERANT and Francis DUPIN
+
+See COPYING file for copyrights details.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/*
+	Multi-core simulation of large CANopen networks.
+
+	Every simulated node is an instance of SimNode, with its own timer
+	table (CO_ENABLE_TIMER_CONTEXTS) and its own virtual clock. The nodes
+	are spread over one or more buses and are run by a pool of worker
+	threads, that claim them by small chunks at each step.
+
+	The simulated time advances by steps no longer than the shortest CAN
+	frame. A frame sent during a step can't be received before the next
+	one, so in a step the nodes are independent: the workers run them in
+	parallel, each node dispatching the frames it receives and its alarms
+	in time order. Between two steps, the frames the nodes sent are given
+	the bus by CAN arbitration, and appended to the log of their bus with
+	their end of transmission time. The log is the inbox of every node of
+	the bus: it is only written between the steps and each node reads it
+	from its own cursor. A node is run by a single worker during a step,
+	and the steps are separated by barriers, so nothing needs a lock.
+
+	The result only depends on the simulated network, never on the number
+	of threads: the checksum of the frames on the buses proves it.
+
+	With -d, the frames of a node only wait for the bus after a processing
+	time, as the answer of a real node to an SDO request.
+
+	With -m (CO_ENABLE_MULTIBUS), each bus also has a master, an instance
+	of SimMaster, and the masters form one multi-bus master. Each master
+	is run like the nodes, in parallel with the others, and drives its bus
+	from an alarm: it waits for the boot-up of the nodes, starts them,
+	reads an object of each of them by SDO, then detects the loss of the
+	heartbeat of a node the simulator stops.
+
+	With -c (CO_ENABLE_CONF_BACKUP), each master then saves the
+	configuration of the nodes of its bus in an archive written to a file.
+	The simulator invalidates the first RPDO of every node, and the masters
+	restore the configuration from the file read back.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/time.h>
+
+#include "canfestival.h"
+#include "objacces.h"
+
+/* Instances of SimNode, see Makefile */
+extern CO_Data* const sim_nodes[];
+extern const int sim_nodes_count;
+/* Instances of SimMaster, see Makefile */
+extern CO_Data* sim_masters[];
+extern const int sim_masters_count;
+
+#define SIM_MAX_THREADS 64
+#define SIM_NODES_PER_BUS 127
+/* Nodes claimed at once by a worker */
+#define SIM_CHUNK 4
+/* Barrier spins before yielding the CPU */
+#define SIM_SPINS 2000
+/* Bits of a frame without data, with the interframe space, no stuffing */
+#define SIM_FRAME_BITS 47
+
+typedef struct {
+	TIMEVAL time; /* Sending time in an outbox, end of transmission in a log */
+	int sender;
+	Message m;
+} sim_frame;
+
+typedef struct {
+	sim_frame *frames;
+	int first, count, size;
+} sim_queue;
+
+typedef struct {
+	CO_Data *d;
+	int bus;
+	s_timer_context timers;
+	TIMEVAL now; /* Virtual clock */
+	TIMEVAL last_dispatch; /* Time of the last TimeDispatch */
+	TIMEVAL next_alarm; /* Time set by setTimer */
+	sim_queue outbox; /* Frames sent during the step */
+	int arbitration; /* Last arbitration round with a frame of the node */
+	unsigned long dispatched;
+	int dead; /* Stopped by the simulator */
+} sim_node;
+
+typedef struct {
+	sim_queue log; /* Frames received by the nodes of the bus */
+	sim_queue pending; /* Frames waiting for the bus */
+	TIMEVAL free; /* End of the last frame */
+	unsigned long frames, bits;
+	UNS32 checksum;
+} sim_bus;
+
+typedef struct {
+	volatile int count;
+	volatile int sense;
+	int threads;
+} sim_barrier;
+
+static sim_node *nodes;
+static int nodes_count = 256;
+/* Nodes and masters, the masters follow the nodes in nodes[] */
+static int run_count;
+static int multibus;
+static sim_bus *buses;
+static int buses_count = 0;
+static int threads_count = 1;
+static int bitrate = 1000; /* kbit/s */
+static TIMEVAL sync_period = 20000;
+static TIMEVAL duration = 10000000;
+static TIMEVAL node_delay = 0; /* Processing time of the nodes, not of the masters */
+
+static sim_barrier barrier;
+static volatile TIMEVAL step_end;
+static volatile int next_node;
+static volatile int stop;
+static int arbitration_round;
+static unsigned long steps;
+
+/* Node run by the calling thread, for the timers and CAN driver functions */
+static __thread sim_node *current;
+
+/***************************  Virtual drivers  *****************************/
+s_timer_context* getTimerContext(void)
+{
+	return &current->timers;
+}
+
+void setTimer(TIMEVAL value)
+{
+	current->next_alarm = value >= TIMEVAL_MAX - current->now ? TIMEVAL_MAX : current->now + value;
+}
+
+TIMEVAL getElapsedTime(void)
+{
+	return current->now - current->last_dispatch;
+}
+
+static void sim_queue_push(sim_queue *q, TIMEVAL time, int sender, Message const *m)
+{
+	sim_frame *f;
+	if(q->first + q->count == q->size)
+	{
+		if(q->first > q->size / 2)
+		{
+			memmove(q->frames, q->frames + q->first, q->count * sizeof(sim_frame));
+			q->first = 0;
+		}
+		else
+		{
+			q->size = q->size ? q->size * 2 : 64;
+			q->frames = realloc(q->frames, q->size * sizeof(sim_frame));
+			if(!q->frames)
+			{
+				fprintf(stderr, "Out of memory\n");
+				exit(1);
+			}
+		}
+	}
+	f = &q->frames[q->first + q->count++];
+	f->time = time;
+	f->sender = sender;
+	f->m = *m;
+}
+
+UNS8 canSend(CAN_PORT port, Message *m)
+{
+	TIMEVAL delay = current - nodes < nodes_count ? node_delay : 0;
+	sim_queue_push(&current->outbox, current->now + delay, current - nodes, m);
+	return 0;
+}
+
+/****************************  Simulation  *********************************/
+static TIMEVAL frame_time(Message const *m)
+{
+	UNS32 bits = SIM_FRAME_BITS + (m->rtr ? 0 : 8 * m->len);
+	return (bits * 1000 + bitrate - 1) / bitrate;
+}
+
+static void sim_barrier_wait(int *sense)
+{
+	int spins = 0;
+	*sense = !*sense;
+	if(__sync_add_and_fetch(&barrier.count, 1) == barrier.threads)
+	{
+		barrier.count = 0;
+		__sync_synchronize();
+		barrier.sense = *sense;
+	}
+	else
+	{
+		while(barrier.sense != *sense)
+			if(++spins > SIM_SPINS)
+				sched_yield();
+	}
+	__sync_synchronize();
+}
+
+/* Dispatch the frames and alarms of a node, until the end of the step */
+static void sim_run_node(sim_node *n, TIMEVAL end)
+{
+	sim_queue *log = &buses[n->bus].log;
+	int i;
+
+	if(n->dead)
+		return;
+	current = n;
+	for(i = log->first; ; i++)
+	{
+		sim_frame *f = i < log->first + log->count && log->frames[i].time < end ? &log->frames[i] : NULL;
+		TIMEVAL t = f ? f->time : end;
+
+		/* Alarms first, up to the time of the frame */
+		while(n->next_alarm <= t && n->next_alarm < end)
+		{
+			n->now = n->next_alarm;
+			n->last_dispatch = n->now;
+			n->next_alarm = TIMEVAL_MAX;
+			TimeDispatch();
+		}
+		if(!f)
+			break;
+		n->now = f->time;
+		if(f->sender != n - nodes)
+		{
+			canDispatch(n->d, &f->m);
+			n->dispatched++;
+		}
+	}
+	current = NULL;
+}
+
+static void sim_run_step(void)
+{
+	int first, i;
+	while((first = __sync_fetch_and_add(&next_node, SIM_CHUNK)) < run_count)
+		for(i = first; i < first + SIM_CHUNK && i < run_count; i++)
+			sim_run_node(&nodes[i], step_end);
+}
+
+static void* sim_worker(void *arg)
+{
+	int sense = 0;
+	for(;;)
+	{
+		sim_barrier_wait(&sense);
+		if(stop)
+			break;
+		sim_run_step();
+		sim_barrier_wait(&sense);
+	}
+	return NULL;
+}
+
+static void sim_checksum(sim_bus *bus, sim_frame const *f)
+{
+	UNS8 const *p = (UNS8 const *)&f->m.cob_id;
+	UNS32 h = bus->checksum;
+	int i;
+	h = (h ^ (UNS32)f->time) * 16777619;
+	h = (h ^ (UNS32)(f->time >> 32)) * 16777619;
+	for(i = 0; i < (int)sizeof(f->m.cob_id); i++)
+		h = (h ^ p[i]) * 16777619;
+	h = (h ^ f->m.len) * 16777619;
+	for(i = 0; i < f->m.len && i < 8; i++)
+		h = (h ^ f->m.data[i]) * 16777619;
+	bus->checksum = h;
+}
+
+/* Give the bus to the frames that start before the end of the step */
+static void sim_arbitrate(sim_bus *bus, TIMEVAL end)
+{
+	sim_queue *q = &bus->pending;
+	while(q->count)
+	{
+		TIMEVAL start = TIMEVAL_MAX;
+		int i, won = -1;
+		for(i = q->first; i < q->first + q->count; i++)
+			if(q->frames[i].time < start)
+				start = q->frames[i].time;
+		if(start < bus->free)
+			start = bus->free;
+		if(start >= end)
+			break;
+		/* Lowest COB-ID among the first pending frame of each node */
+		arbitration_round++;
+		for(i = q->first; i < q->first + q->count; i++)
+		{
+			sim_frame *f = &q->frames[i];
+			if(f->time > start || nodes[f->sender].arbitration == arbitration_round)
+				continue;
+			nodes[f->sender].arbitration = arbitration_round;
+			if(won < 0 || f->m.cob_id < q->frames[won].m.cob_id)
+				won = i;
+		}
+		bus->free = start + frame_time(&q->frames[won].m);
+		bus->frames++;
+		bus->bits += SIM_FRAME_BITS + (q->frames[won].m.rtr ? 0 : 8 * q->frames[won].m.len);
+		sim_queue_push(&bus->log, bus->free, q->frames[won].sender, &q->frames[won].m);
+		sim_checksum(bus, &bus->log.frames[bus->log.first + bus->log.count - 1]);
+		memmove(&q->frames[won], &q->frames[won + 1], (q->first + q->count - won - 1) * sizeof(sim_frame));
+		q->count--;
+	}
+}
+
+/* Between two steps : bus arbitration, and time of the next step */
+static TIMEVAL sim_next_step(TIMEVAL end)
+{
+	TIMEVAL next = TIMEVAL_MAX;
+	int i, j;
+
+	for(i = 0; i < run_count; i++)
+	{
+		sim_node *n = &nodes[i];
+		for(j = n->outbox.first; j < n->outbox.first + n->outbox.count; j++)
+			sim_queue_push(&buses[n->bus].pending, n->outbox.frames[j].time, i, &n->outbox.frames[j].m);
+		n->outbox.first = n->outbox.count = 0;
+		if(n->next_alarm < next)
+			next = n->next_alarm;
+	}
+	for(i = 0; i < buses_count; i++)
+	{
+		sim_bus *bus = &buses[i];
+		/* Every node received the frames of the step */
+		while(bus->log.count && bus->log.frames[bus->log.first].time < end)
+		{
+			bus->log.first++;
+			bus->log.count--;
+		}
+		sim_arbitrate(bus, end);
+		if(bus->log.count && bus->log.frames[bus->log.first].time < next)
+			next = bus->log.frames[bus->log.first].time;
+		for(j = bus->pending.first; j < bus->pending.first + bus->pending.count; j++)
+		{
+			TIMEVAL start = bus->pending.frames[j].time < bus->free ? bus->free : bus->pending.frames[j].time;
+			if(start < next)
+				next = start;
+		}
+	}
+	return next < end ? end : next;
+}
+
+static void sim_post_sync(CO_Data* d)
+{
+	UNS32 value, size = sizeof(value);
+	UNS8 type;
+	/* Each node forwards the value of the previous one, incremented */
+	getODentry(d, 0x2001, 0, &value, &size, &type, 0);
+	value++;
+	writeLocalDict(d, 0x2000, 0, &value, &size, 0);
+}
+
+#ifdef CO_ENABLE_MULTIBUS
+/* Steps of the scenario of a bus master */
+#define SIM_BOOTING 0
+#define SIM_STARTING 1
+#define SIM_READING 2
+#define SIM_SAVING 3
+#define SIM_SAVED 4
+#define SIM_RESTORING 5
+#define SIM_SUPERVISING 6
+#define SIM_DONE 7
+/* Alarms of a master : heartbeat consumers, SDO lines and its own */
+#define SIM_MASTER_TIMERS (SIM_NODES_PER_BUS + SDO_MAX_SIMULTANEOUS_TRANSFERS + 4)
+
+typedef struct {
+	int phase;
+	int nodes; /* Nodes on the bus, node-ids 1 to nodes */
+	int next_read, reading, read, read_errors;
+	UNS8 lost; /* Node stopped by the simulator */
+	TIMEVAL booted, operational, read_end, stopped, detected;
+#ifdef CO_ENABLE_CONF_BACKUP
+	s_conf_backup backup;
+	UNS8 node_ids[SIM_NODES_PER_BUS];
+	int save_started, restore_started, restored;
+	UNS32 saved_bytes, archive_size;
+	UNS8 saved, save_errors, restore_errors;
+	TIMEVAL save_end, restore_start, restore_end;
+#endif
+} sim_master;
+
+static s_multibus sim_multibus;
+static sim_master *masters;
+#ifdef CO_ENABLE_CONF_BACKUP
+static char *conf_file;
+static int conf_lines = CONF_BACKUP_MAX_LINES;
+static s_conf_object conf_objects[512];
+static UNS16 conf_objects_count;
+#endif
+
+static void sim_master_read(UNS8 bus);
+
+static void sim_master_sdo(CO_Data* d, UNS8 nodeId)
+{
+	UNS8 bus = multiBusIndex(&sim_multibus, d);
+	sim_master *m = &masters[bus];
+	UNS32 value, size = sizeof(value), abortCode;
+
+	if(getReadResultNetworkDict(d, nodeId, &value, &size, &abortCode) != SDO_FINISHED)
+		m->read_errors++;
+	closeSDOtransfer(d, nodeId, SDO_CLIENT);
+	m->reading--;
+	m->read++;
+	sim_master_read(bus);
+}
+
+/* Keep the SDO lines of the master of the bus busy */
+static void sim_master_read(UNS8 bus)
+{
+	sim_master *m = &masters[bus];
+	while(m->reading < SDO_MAX_SIMULTANEOUS_TRANSFERS && m->next_read < m->nodes)
+	{
+		if(multiBusReadNetworkDict(&sim_multibus, bus, m->next_read + 1, 0x1000, 0, 0, sim_master_sdo, 0))
+			break;
+		m->next_read++;
+		m->reading++;
+	}
+	if(m->read == m->nodes && m->phase == SIM_READING)
+	{
+		m->read_end = current->now;
+		m->phase = SIM_SUPERVISING;
+#ifdef CO_ENABLE_CONF_BACKUP
+		if(conf_file)
+			m->phase = SIM_SAVING;
+#endif
+	}
+}
+
+#ifdef CO_ENABLE_CONF_BACKUP
+static void sim_master_conf_done(s_conf_backup* cb, UNS8 nodeId, UNS32 abortCode)
+{
+	sim_master *m = &masters[multiBusIndex(&sim_multibus, cb->d)];
+	if(nodeId)
+		return;
+	if(m->phase == SIM_SAVING)
+	{
+		m->save_end = current->now;
+		m->saved = cb->nodesDone;
+		m->save_errors = cb->nodesFailed;
+		m->saved_bytes = cb->bytes;
+		m->archive_size = cb->archiveSize;
+		m->phase = SIM_SAVED;
+	}
+	else
+	{
+		m->restore_end = current->now;
+		m->restored = cb->nodesDone;
+		m->restore_errors = cb->nodesFailed;
+		m->phase = SIM_SUPERVISING;
+	}
+}
+#endif
+
+static void sim_master_heartbeat_error(s_multibus* mb, UNS8 bus, UNS8 nodeId)
+{
+	sim_master *m = &masters[bus];
+	if(nodeId == m->lost && m->phase == SIM_SUPERVISING)
+	{
+		m->detected = current->now;
+		m->phase = SIM_DONE;
+	}
+}
+
+/* Scenario of a bus, every ms */
+static void sim_master_alarm(CO_Data* d, UNS32 bus)
+{
+	sim_master *m = &masters[bus];
+	switch(m->phase)
+	{
+		case SIM_BOOTING:
+			if(multiBusCountNodes(&sim_multibus, bus, Pre_operational) == m->nodes)
+			{
+				m->booted = current->now;
+				multiBusNMT(&sim_multibus, bus, 0, NMT_Start_Node);
+				m->phase = SIM_STARTING;
+			}
+			break;
+		case SIM_STARTING:
+			if(multiBusCountNodes(&sim_multibus, bus, Operational) == m->nodes)
+			{
+				m->operational = current->now;
+				m->phase = SIM_READING;
+				sim_master_read(bus);
+			}
+			break;
+		case SIM_READING:
+			/* Reads that could not start */
+			sim_master_read(bus);
+			break;
+#ifdef CO_ENABLE_CONF_BACKUP
+		case SIM_SAVING:
+			if(!m->save_started)
+			{
+				m->save_started = 1;
+				if(confBackupSave(&m->backup, m->node_ids, m->nodes, sim_master_conf_done))
+					m->phase = SIM_SUPERVISING;
+			}
+			break;
+		case SIM_RESTORING:
+			if(!m->restore_started)
+			{
+				m->restore_started = 1;
+				m->restore_start = current->now;
+				if(confBackupRestore(&m->backup, m->backup.archive, m->archive_size, sim_master_conf_done))
+					m->phase = SIM_SUPERVISING;
+			}
+			break;
+#endif
+	}
+}
+
+#ifdef CO_ENABLE_CONF_BACKUP
+/* Between two steps : write the archives, lose the configuration of the
+   first RPDO of the nodes, and read the archives back to restore it */
+static int sim_conf_step(void)
+{
+	char name[256];
+	FILE *f;
+	int i, ok;
+
+	for(i = 0; i < buses_count; i++)
+		if(masters[i].phase != SIM_SAVED)
+			return 0;
+	for(i = 0; i < buses_count; i++)
+	{
+		sim_master *m = &masters[i];
+		if(buses_count == 1)
+			snprintf(name, sizeof(name), "%s", conf_file);
+		else
+			snprintf(name, sizeof(name), "%s.%d", conf_file, i);
+		f = fopen(name, "wb");
+		ok = f && fwrite(m->backup.archive, 1, m->archive_size, f) == m->archive_size;
+		if(f)
+			ok = !fclose(f) && ok;
+		memset(m->backup.archive, 0, m->archive_size);
+		f = ok ? fopen(name, "rb") : NULL;
+		ok = f && fread(m->backup.archive, 1, m->archive_size, f) == m->archive_size;
+		if(f)
+			fclose(f);
+		if(!ok)
+		{
+			perror(name);
+			exit(1);
+		}
+		m->phase = SIM_RESTORING;
+	}
+	for(i = 0; i < nodes_count; i++)
+	{
+		const subindex *cobId;
+		if(_findODentry(nodes[i].d, 0x1400, 1, &cobId) == OD_SUCCESSFUL)
+			*(UNS32 *)cobId->pObject |= 0x80000000;
+	}
+	return 1;
+}
+
+/* Nodes whose first RPDO is valid again */
+static int sim_conf_restored(int bus)
+{
+	int i, count = 0;
+	for(i = bus; i < nodes_count; i += buses_count)
+	{
+		const subindex *cobId;
+		if(_findODentry(nodes[i].d, 0x1400, 1, &cobId) == OD_SUCCESSFUL && !(*(UNS32 *)cobId->pObject & 0x80000000))
+			count++;
+	}
+	return count;
+}
+#endif
+
+/* Between two steps : stop the last node of each bus once all are read */
+static int sim_multibus_step(TIMEVAL end)
+{
+	int i, done = 0;
+#ifdef CO_ENABLE_CONF_BACKUP
+	if(conf_file && sim_conf_step())
+		return 0;
+#endif
+	for(i = 0; i < buses_count; i++)
+		if(masters[i].phase < SIM_SUPERVISING)
+			return 0;
+	for(i = 0; i < buses_count; i++)
+	{
+		sim_master *m = &masters[i];
+		if(!m->lost)
+		{
+			sim_node *n = &nodes[(m->nodes - 1) * buses_count + i];
+			n->dead = 1;
+			n->next_alarm = TIMEVAL_MAX;
+			m->lost = m->nodes;
+			m->stopped = end;
+		}
+		done += m->phase == SIM_DONE;
+	}
+	return done == buses_count;
+}
+
+static int sim_multibus_init(void)
+{
+	int i;
+
+	if(MAX_NB_TIMER < SIM_MASTER_TIMERS)
+	{
+		fprintf(stderr, "A master needs %d alarms, configure with --MAX_NB_TIMER=%d or more\n",
+			SIM_MASTER_TIMERS, SIM_MASTER_TIMERS);
+		return 1;
+	}
+	if(buses_count > sim_masters_count)
+	{
+		fprintf(stderr, "%d buses, at most %d masters\n", buses_count, sim_masters_count);
+		return 1;
+	}
+	masters = calloc(buses_count, sizeof(sim_master));
+	if(!masters)
+		return 1;
+	for(i = 0; i < nodes_count; i++)
+		masters[i % buses_count].nodes++;
+	if(initMultiBus(&sim_multibus, sim_masters, buses_count))
+		return 1;
+	sim_multibus.heartbeatError = sim_master_heartbeat_error;
+#ifdef CO_ENABLE_CONF_BACKUP
+	/* The nodes share one dictionary */
+	if(conf_file && !(conf_objects_count = confBackupObjects(sim_nodes[0], conf_objects, sizeof(conf_objects) / sizeof(conf_objects[0]))))
+		return 1;
+#endif
+
+	for(i = 0; i < buses_count; i++)
+	{
+		sim_node *n = &nodes[nodes_count + i];
+		n->d = sim_masters[i];
+		n->bus = i;
+		current = n;
+#ifdef CO_ENABLE_CONF_BACKUP
+		if(conf_file)
+		{
+			sim_master *m = &masters[i];
+			UNS32 size;
+			int j;
+			for(j = 0; j < m->nodes; j++)
+				m->node_ids[j] = j + 1;
+			if(initConfBackup(&m->backup, n->d, conf_objects, conf_objects_count, NULL, 0, conf_lines))
+				return 1;
+			size = CONF_BACKUP_HEADER + m->nodes * (CONF_BACKUP_NODE_HEADER + m->backup.nodeMax);
+			m->backup.archive = malloc(size);
+			m->backup.archiveMax = size;
+			if(!m->backup.archive)
+				return 1;
+		}
+#endif
+		setState(n->d, Initialisation);
+		setState(n->d, Pre_operational);
+		SetAlarm(n->d, i, sim_master_alarm, MS_TO_TIMEVAL(1), MS_TO_TIMEVAL(1));
+	}
+	return 0;
+}
+
+static void sim_multibus_report(void)
+{
+	int i;
+	for(i = 0; i < buses_count; i++)
+	{
+		sim_master *m = &masters[i];
+		printf("  bus %d master : %d nodes, booted at %llu ms, operational at %llu ms, %d SDO reads (%d errors) in %llu ms, heartbeat loss detected in %llu ms\n",
+			i, m->nodes, (unsigned long long)m->booted / 1000, (unsigned long long)m->operational / 1000,
+			m->read, m->read_errors, (unsigned long long)(m->read_end - m->operational) / 1000,
+			(unsigned long long)(m->phase == SIM_DONE ? (m->detected - m->stopped) / 1000 : 0));
+#ifdef CO_ENABLE_CONF_BACKUP
+		if(conf_file)
+			printf("  bus %d configuration : %d nodes saved (%d errors), %lu objects, %lu bytes in %llu ms, archive of %lu bytes, %d nodes restored (%d errors) in %llu ms, %d nodes checked\n",
+				i, m->saved, m->save_errors, (unsigned long)m->saved * conf_objects_count, (unsigned long)m->saved_bytes,
+				(unsigned long long)(m->save_end - m->read_end) / 1000, (unsigned long)m->archive_size,
+				m->restored, m->restore_errors, (unsigned long long)(m->restore_end - m->restore_start) / 1000,
+				sim_conf_restored(i));
+#endif
+	}
+	printf("multi-bus master : %lu nodes operational, %lu disconnected, %s\n",
+		(unsigned long)multiBusCountNodes(&sim_multibus, MULTIBUS_ALL, Operational),
+		(unsigned long)multiBusCountNodes(&sim_multibus, MULTIBUS_ALL, Disconnected),
+		masters[0].phase == SIM_DONE ? "scenario complete" : "scenario not complete");
+}
+#endif
+
+static int sim_init(void)
+{
+	TIMEVAL step = (SIM_FRAME_BITS * 1000 + bitrate - 1) / bitrate;
+	s_timer_context blank = TIMER_CONTEXT_INITIALIZER;
+	int i, per_bus;
+
+	if(!buses_count)
+		buses_count = (nodes_count + 63) / 64;
+	per_bus = (nodes_count + buses_count - 1) / buses_count;
+	if(per_bus > SIM_NODES_PER_BUS)
+	{
+		fprintf(stderr, "%d nodes per bus, at most %d\n", per_bus, SIM_NODES_PER_BUS);
+		return 1;
+	}
+	run_count = nodes_count + (multibus ? buses_count : 0);
+	nodes = calloc(run_count, sizeof(sim_node));
+	buses = calloc(buses_count, sizeof(sim_bus));
+	if(!nodes || !buses)
+		return 1;
+	for(i = 0; i < buses_count; i++)
+		buses[i].checksum = 2166136261u;
+
+	/* Node i is node-id (i / buses_count) + 1 on bus i % buses_count */
+	for(i = 0; i < run_count; i++)
+	{
+		nodes[i].timers = blank;
+		nodes[i].next_alarm = TIMEVAL_MAX;
+	}
+	for(i = 0; i < nodes_count; i++)
+	{
+		sim_node *n = &nodes[i];
+		UNS8 id = i / buses_count + 1;
+		UNS8 previous = id > 1 ? id - 1 : (nodes_count - 1 - i % buses_count) / buses_count + 1;
+		UNS32 value, size = sizeof(value);
+
+		n->d = sim_nodes[i];
+		n->bus = i % buses_count;
+		current = n;
+
+		setNodeId(n->d, id);
+		n->d->post_sync = sim_post_sync;
+		/* Receive the TPDO of the previous node of the bus */
+		value = 0x180 + previous;
+		writeLocalDict(n->d, 0x1400, 1, &value, &size, 0);
+		if(id == 1)
+		{
+			/* First node of a bus is the SYNC producer */
+			value = sync_period;
+			writeLocalDict(n->d, 0x1006, 0, &value, &size, 0);
+			value = 0x40000080;
+			writeLocalDict(n->d, 0x1005, 0, &value, &size, 0);
+		}
+		setState(n->d, Initialisation);
+		/* The bus masters start the nodes */
+		setState(n->d, multibus ? Pre_operational : Operational);
+	}
+#ifdef CO_ENABLE_MULTIBUS
+	if(multibus && sim_multibus_init())
+		return 1;
+#endif
+	current = NULL;
+	printf("%d nodes on %d bus(es) at %d kbit/s, SYNC every %llu us, %d thread(s), steps of %llu us\n",
+		nodes_count, buses_count, bitrate, (unsigned long long)sync_period, threads_count, (unsigned long long)step);
+	return 0;
+}
+
+static void sim_run(void)
+{
+	TIMEVAL step = (SIM_FRAME_BITS * 1000 + bitrate - 1) / bitrate;
+	TIMEVAL start = 0;
+	pthread_t threads[SIM_MAX_THREADS];
+	struct timeval t0, t1;
+	unsigned long frames = 0, dispatched = 0;
+	UNS32 checksum = 0;
+	double seconds;
+	int i, sense = 0;
+
+	barrier.threads = threads_count;
+	for(i = 1; i < threads_count; i++)
+		if(pthread_create(&threads[i], NULL, sim_worker, NULL))
+		{
+			perror("pthread_create()");
+			exit(1);
+		}
+
+	gettimeofday(&t0, NULL);
+	while(start < duration)
+	{
+		step_end = start + step;
+		next_node = 0;
+		sim_barrier_wait(&sense);
+		sim_run_step();
+		sim_barrier_wait(&sense);
+		start = sim_next_step(step_end);
+		steps++;
+#ifdef CO_ENABLE_MULTIBUS
+		if(multibus && sim_multibus_step(step_end))
+		{
+			/* Scenario complete, stop there */
+			duration = step_end;
+			break;
+		}
+#endif
+	}
+	stop = 1;
+	sim_barrier_wait(&sense);
+	for(i = 1; i < threads_count; i++)
+		pthread_join(threads[i], NULL);
+	gettimeofday(&t1, NULL);
+
+	seconds = (t1.tv_sec - t0.tv_sec) + (t1.tv_usec - t0.tv_usec) / 1e6;
+	for(i = 0; i < run_count; i++)
+		dispatched += nodes[i].dispatched;
+	for(i = 0; i < buses_count; i++)
+	{
+		frames += buses[i].frames;
+		checksum = (checksum ^ buses[i].checksum) * 16777619;
+		printf("  bus %d : %lu frames, load %.1f%%, checksum %08x\n", i, buses[i].frames,
+			buses[i].bits * 100.0 / ((double)duration * bitrate / 1000), buses[i].checksum);
+	}
+	printf("%.1f s simulated in %.2f s : %lu frames, %lu dispatched, %lu steps\n",
+		duration / 1e6, seconds, frames, dispatched, steps);
+	printf("%.0f simulated frames/s, %.0f dispatched frames/s, checksum %08x\n",
+		frames / seconds, dispatched / seconds, checksum);
+#ifdef CO_ENABLE_MULTIBUS
+	if(multibus)
+		sim_multibus_report();
+#endif
+}
+
+static void help(void)
+{
+	printf("Usage: NetworkSim [-n nodes] [-b buses] [-t threads] [-s seconds] [-r kbit/s] [-p sync period us] [-d us] [-m] [-c file] [-l lines]\n");
+	printf("  -n : simulated nodes, at most %d (%d)\n", sim_nodes_count, nodes_count);
+	printf("  -b : buses, at most %d nodes per bus (one per 64 nodes)\n", SIM_NODES_PER_BUS);
+	printf("  -t : worker threads, at most %d (%d)\n", SIM_MAX_THREADS, threads_count);
+	printf("  -s : simulated seconds (%llu)\n", (unsigned long long)(duration / 1000000));
+	printf("  -r : bit rate in kbit/s (%d)\n", bitrate);
+	printf("  -p : SYNC period in us (%llu)\n", (unsigned long long)sync_period);
+	printf("  -d : processing time of the nodes in us, before their frames wait for the bus (%llu)\n", (unsigned long long)node_delay);
+	printf("  -m : a master on each bus, one multi-bus master, stops once its scenario is complete\n");
+#ifdef CO_ENABLE_CONF_BACKUP
+	printf("  -c : with -m, the masters save the configuration of the nodes in this file, then restore it\n");
+	printf("  -l : nodes whose configuration is transferred at once by a master (%d)\n", CONF_BACKUP_MAX_LINES);
+#endif
+}
+
+int main(int argc, char **argv)
+{
+	int c;
+	while((c = getopt(argc, argv, "n:b:t:s:r:p:d:mc:l:h")) != EOF)
+	{
+		switch(c)
+		{
+			case 'n': nodes_count = atoi(optarg); break;
+			case 'b': buses_count = atoi(optarg); break;
+			case 't': threads_count = atoi(optarg); break;
+			case 's': duration = (TIMEVAL)atoi(optarg) * 1000000; break;
+			case 'r': bitrate = atoi(optarg); break;
+			case 'p': sync_period = atoi(optarg); break;
+			case 'd': node_delay = atoi(optarg); break;
+			case 'm': multibus = 1; break;
+#ifdef CO_ENABLE_CONF_BACKUP
+			case 'c': conf_file = optarg; break;
+			case 'l': conf_lines = atoi(optarg); break;
+#endif
+			default: help(); return c == 'h' ? 0 : 1;
+		}
+	}
+	if(nodes_count < 1 || nodes_count > sim_nodes_count || buses_count < 0 ||
+		threads_count < 1 || threads_count > SIM_MAX_THREADS || bitrate < 1)
+	{
+		help();
+		return 1;
+	}
+#ifndef CO_ENABLE_MULTIBUS
+	if(multibus)
+	{
+		fprintf(stderr, "-m needs the multi-bus master (--enable-multibus)\n");
+		return 1;
+	}
+#endif
+#ifdef CO_ENABLE_CONF_BACKUP
+	if(conf_file && !multibus)
+	{
+		fprintf(stderr, "-c needs the masters (-m)\n");
+		return 1;
+	}
+#endif
+	if(sim_init())
+		return 1;
+	sim_run();
+	return 0;
+}
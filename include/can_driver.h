@@ -69,6 +69,20 @@ CAN_HANDLE DLL_CALL(canOpen)(s_BOARD *)FCT_PTR_INIT;
 int DLL_CALL(canClose)(CAN_HANDLE)FCT_PTR_INIT;
 UNS8 DLL_CALL(canChangeBaudRate)(CAN_HANDLE, char *)FCT_PTR_INIT;
 
+#ifdef CO_ENABLE_TXTIME
+/* Returned by canSendAt when the message can't be queued with a launch time.
+ * Nothing has been sent in that case. */
+#define CAN_TXTIME_UNSUPPORTED 0xFE
+
+/* Optional driver entry point : queue a message to be sent at launchTime (ns, CLOCK_TAI) */
+UNS8 DLL_CALL(canSendAt)(CAN_HANDLE, Message const *, UNS64)FCT_PTR_INIT;
+#endif
+
+#ifdef CO_ENABLE_SHARED_HEARTBEAT
+/* Optional driver entry point : send count messages in one call, returns the number sent */
+UNS16 DLL_CALL(canSendBatch)(CAN_HANDLE, Message const *, UNS16)FCT_PTR_INIT;
+#endif
+
 #if defined DEBUG_MSG_CONSOLE_ON || defined NEED_PRINT_MESSAGE
 #include "def.h"
 
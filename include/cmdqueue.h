@@ -0,0 +1,208 @@
+/*
+This file is part of CanFestival, a library implementing CanOpen Stack.
+
+Copyright (C): Edouard TISSERANT and Francis DUPIN
+
+See COPYING file for copyrights details.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/** @defgroup cmdqueue Command submission queue
+ * @brief Any thread can post NMT, SDO, PDO, EMCY and state commands to a node
+ * without taking the stack mutex. The commands are run in order by the stack,
+ * with the mutex held, before the next received message is processed or after
+ * the alarms of the next timer pass. Posting to an empty queue kicks the timers
+ * driver so that it is serviced at once.
+ *  @ingroup userapi
+ */
+
+#ifndef __cmdqueue_h__
+#define __cmdqueue_h__
+
+#include <applicfg.h>
+
+typedef struct struct_s_co_command s_co_command;
+typedef struct struct_s_cmd_queue s_cmd_queue;
+
+#include "data.h"
+
+/* Bytes of SDO data copied in the command, larger data is referenced */
+#define CO_COMMAND_DATA_SIZE 8
+
+/* Command types */
+#define CO_CMD_NMT          0x01
+#define CO_CMD_STATE        0x02
+#define CO_CMD_PDO_EVENT    0x03
+#define CO_CMD_EMCY_ERROR   0x04
+#define CO_CMD_EMCY_RECOVER 0x05
+#define CO_CMD_SDO_WRITE    0x06
+#define CO_CMD_SDO_READ     0x07
+#define CO_CMD_CALL         0x08
+
+/* Function run by a CO_CMD_CALL command, with the stack mutex held */
+typedef void (*CommandFunction_t)(CO_Data* d, void* context);
+
+/** A command. The cells of the queue are provided by the application. */
+struct struct_s_co_command {
+  UNS32 sequence;                      /* internal, cell state */
+  UNS8 type;                           /* CO_CMD_... */
+  UNS8 nodeId;                         /* NMT and SDO */
+  UNS8 value;                          /* cs, state, errRegMask or SDO dataType */
+  UNS8 subIndex;                       /* SDO */
+  UNS16 index;                         /* SDO index or EMCY errCode */
+  UNS16 addInfo;                       /* EMCY */
+  UNS32 count;                         /* SDO */
+  UNS8 useBlockMode;                   /* SDO */
+  SDOCallback_t callback;              /* SDO */
+  CommandFunction_t function;          /* CO_CMD_CALL */
+  void* data;                          /* SDO data bigger than CO_COMMAND_DATA_SIZE, or function context */
+  UNS8 buffer[CO_COMMAND_DATA_SIZE];   /* SDO data up to CO_COMMAND_DATA_SIZE */
+};
+
+/** Bounded multiple producers / single consumer queue of a node */
+struct struct_s_cmd_queue {
+  CO_Data* d;
+  s_co_command* cells;
+  UNS32 mask;                          /* queue size - 1, size is a power of 2 */
+  UNS32 enqueue;                       /* next cell to post, producers side */
+  UNS32 dequeue;                       /* next cell to run, stack side */
+  UNS32 kicked;                        /* timers driver kicked, not serviced yet */
+  UNS32 posted;                        /* commands posted */
+  UNS32 rejected;                      /* commands not posted because the queue was full */
+  UNS32 failed;                        /* commands run that returned an error */
+  s_cmd_queue* next;
+};
+
+/**
+ * @ingroup cmdqueue
+ * @brief Enable the command queue of a node. Must be called with the stack
+ * mutex held, before any command is posted.
+ * @param *d Pointer on a CAN object data structure
+ * @param *q Queue storage, provided by the application
+ * @param *cells Commands storage
+ * @param size Number of commands in cells, must be a power of 2
+ * @return 0 if OK, 0xFF if size is invalid
+ */
+UNS8 initCommandQueue(CO_Data* d, s_cmd_queue* q, s_co_command* cells, UNS32 size);
+
+/**
+ * @ingroup cmdqueue
+ * @brief Remove the command queue of a node, the pending commands are dropped.
+ * Must be called with the stack mutex held, once no thread posts to it.
+ * @param *d Pointer on a CAN object data structure
+ */
+void stopCommandQueue(CO_Data* d);
+
+/**
+ * @ingroup cmdqueue
+ * @brief Post masterSendNMTstateChange(). Lock-free, from any thread.
+ * @param *d Pointer on a CAN object data structure
+ * @param nodeId Id of the slave node, 0 for all the nodes
+ * @param cs The new state
+ * @return 0 if posted, 0xFF if the queue is full or not enabled
+ */
+UNS8 postNMTStateChange(CO_Data* d, UNS8 nodeId, UNS8 cs);
+
+/**
+ * @ingroup cmdqueue
+ * @brief Post setState(). Lock-free, from any thread.
+ * @param *d Pointer on a CAN object data structure
+ * @param newState The new state of the node
+ * @return 0 if posted, 0xFF if the queue is full or not enabled
+ */
+UNS8 postSetState(CO_Data* d, e_nodeState newState);
+
+/**
+ * @ingroup cmdqueue
+ * @brief Post sendAsyncPDOevent(). Lock-free, from any thread.
+ * @param *d Pointer on a CAN object data structure
+ * @return 0 if posted, 0xFF if the queue is full or not enabled
+ */
+UNS8 postPDOEvent(CO_Data* d);
+
+/**
+ * @ingroup cmdqueue
+ * @brief Post EMCY_setError(). Lock-free, from any thread.
+ * @param *d Pointer on a CAN object data structure
+ * @param errCode The error code
+ * @param errRegMask The error register mask
+ * @param addInfo The additional information
+ * @return 0 if posted, 0xFF if the queue is full or not enabled
+ */
+UNS8 postEMCYError(CO_Data* d, UNS16 errCode, UNS8 errRegMask, UNS16 addInfo);
+
+/**
+ * @ingroup cmdqueue
+ * @brief Post EMCY_errorRecovered(). Lock-free, from any thread.
+ * @param *d Pointer on a CAN object data structure
+ * @param errCode The error code
+ * @return 0 if posted, 0xFF if the queue is full or not enabled
+ */
+UNS8 postEMCYRecovered(CO_Data* d, UNS16 errCode);
+
+/**
+ * @ingroup cmdqueue
+ * @brief Post writeNetworkDictCallBack(). Lock-free, from any thread.
+ * Up to CO_COMMAND_DATA_SIZE bytes of data are copied, bigger data must stay
+ * valid until Callback is called. If the transfer cannot start, the command
+ * is counted as failed and Callback is not called.
+ * @param *d Pointer on a CAN object data structure
+ * @param nodeId Node Id of the slave
+ * @param index At index indicated
+ * @param subIndex At subIndex indicated
+ * @param count Number of bytes to write
+ * @param dataType visible_string for strings, 0 for the other types
+ * @param *data Pointer to data
+ * @param Callback Callback function
+ * @param useBlockMode
+ * @return 0 if posted, 0xFF if the queue is full or not enabled
+ */
+UNS8 postWriteNetworkDict(CO_Data* d, UNS8 nodeId, UNS16 index, UNS8 subIndex,
+		UNS32 count, UNS8 dataType, void* data, SDOCallback_t Callback, UNS8 useBlockMode);
+
+/**
+ * @ingroup cmdqueue
+ * @brief Post readNetworkDictCallback(). Lock-free, from any thread.
+ * If the transfer cannot start, the command is counted as failed and
+ * Callback is not called.
+ * @param *d Pointer on a CAN object data structure
+ * @param nodeId Node Id of the slave
+ * @param index At index indicated
+ * @param subIndex At subIndex indicated
+ * @param dataType visible_string for strings, 0 for the other types
+ * @param Callback Callback function
+ * @param useBlockMode
+ * @return 0 if posted, 0xFF if the queue is full or not enabled
+ */
+UNS8 postReadNetworkDict(CO_Data* d, UNS8 nodeId, UNS16 index, UNS8 subIndex,
+		UNS8 dataType, SDOCallback_t Callback, UNS8 useBlockMode);
+
+/**
+ * @ingroup cmdqueue
+ * @brief Post a call of function with the stack mutex held, for the other
+ * services. Lock-free, from any thread.
+ * @param *d Pointer on a CAN object data structure
+ * @param function Function to call
+ * @param *context Passed to function
+ * @return 0 if posted, 0xFF if the queue is full or not enabled
+ */
+UNS8 postCommand(CO_Data* d, CommandFunction_t function, void* context);
+
+/* Internal, called by the stack with the mutex held */
+void _runCommands(CO_Data* d);
+void _runCommandQueues(void);
+
+#endif /* __cmdqueue_h__ */
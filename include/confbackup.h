@@ -0,0 +1,173 @@
+/*
+This file is part of CanFestival, a library implementing CanOpen Stack.
+
+Copyright (C): Edouard TISSERANT and Francis DUPIN
+
+See COPYING file for copyrights details.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/** @defgroup confbackup Configuration backup
+ * @brief Backup and restore of the configuration of the nodes of a bus by
+ * the master. The objects saved are the readable and writable entries of
+ * the dictionary of the nodes, as generated from their EDS by objdictgen.
+ * The master uploads them from several nodes at once, one SDO client entry
+ * per node, the big objects by block SDO when the node supports it. Each
+ * node is saved as a concise DCF in one archive, which is then downloaded
+ * back to the nodes the same way.
+ *  @ingroup userapi
+ */
+
+#ifndef __confbackup_h__
+#define __confbackup_h__
+
+#include <applicfg.h>
+
+typedef struct struct_s_conf_object s_conf_object;
+typedef struct struct_s_conf_line s_conf_line;
+typedef struct struct_s_conf_backup s_conf_backup;
+
+#include "data.h"
+
+/* Archive : header of 2 UNS32 little endian (magic, number of nodes), then
+   for each node its node-id (UNS8), the size of its DCF (UNS32) and its
+   concise DCF (number of entries, then index, subindex, size and data of
+   each entry, little endian). */
+#define CONF_BACKUP_MAGIC 0x31424643     /* "CFB1" */
+#define CONF_BACKUP_HEADER 8
+#define CONF_BACKUP_NODE_HEADER 5
+
+/* Nodes transferred at once, at most one per SDO client entry */
+#ifndef CONF_BACKUP_MAX_LINES
+#define CONF_BACKUP_MAX_LINES SDO_MAX_SIMULTANEOUS_TRANSFERS
+#endif
+
+/* Objects transferred by block SDO */
+#define CONF_BACKUP_BLOCK_MIN 8
+
+/* Object flags */
+#define CONF_OBJECT_BLOCK 0x01           /* uploaded by block SDO */
+#define CONF_OBJECT_CLEAR 0x02           /* not uploaded, 0 is restored, see PDO mappings */
+
+/* States */
+#define CONF_BACKUP_IDLE 0
+#define CONF_BACKUP_SAVING 1
+#define CONF_BACKUP_RESTORING 2
+
+/* End of the transfer of a node, abortCode is 0 if done. Called with
+   nodeId 0 once every node is done. */
+typedef void (*confBackupDone_t)(s_conf_backup* cb, UNS8 nodeId, UNS32 abortCode);
+
+/** An object saved */
+struct struct_s_conf_object {
+  UNS16 index;
+  UNS8 subIndex;
+  UNS8 flags;                          /* CONF_OBJECT_... */
+  UNS32 size;                          /* size in the dictionary, largest value saved */
+};
+
+/** Transfer of a node on an SDO client entry */
+struct struct_s_conf_line {
+  UNS8 nodeId;                         /* 0 if the line is free */
+  UNS8 noBlock;                        /* the node refused a block transfer */
+  UNS16 object;                        /* object being saved */
+  UNS8* dcf;                           /* DCF of the node in the archive */
+  UNS32 dcfSize;                       /* bytes of the DCF */
+  UNS32 entries;                       /* entries saved, or left to restore */
+  UNS8* cursor;                        /* entry being restored */
+};
+
+/** Backup context of a master. The structure is provided by the application. */
+struct struct_s_conf_backup {
+  CO_Data* d;
+  const s_conf_object* objects;
+  UNS16 objectsCount;
+  UNS32 nodeMax;                       /* largest DCF of a node */
+  UNS8* archive;
+  UNS32 archiveMax;
+  UNS32 archiveSize;                   /* bytes of the archive, once saved */
+  UNS8 lines;                          /* nodes transferred at once */
+  UNS8 state;                          /* CONF_BACKUP_... */
+  const UNS8* nodeIds;                 /* nodes to save */
+  UNS8 nodesCount;
+  UNS8 nextNode;                       /* next node to start, index in nodeIds or in the archive */
+  UNS8* nextRecord;                    /* next node to restore */
+  UNS8 running;                        /* nodes being transferred */
+  confBackupDone_t done;
+  s_conf_line line[CONF_BACKUP_MAX_LINES];
+  s_conf_backup* next;
+  /* Metrics of the last backup or restore */
+  UNS8 nodesDone;                      /* nodes saved or restored */
+  UNS8 nodesFailed;
+  UNS32 transfers;                     /* SDO transfers done */
+  UNS32 bytes;                         /* bytes of the values transferred */
+};
+
+/**
+ * @ingroup confbackup
+ * @brief List the objects of a dictionary to save: the entries readable and
+ * writable, but the error history, the store and restore commands and the
+ * program download objects. A PDO mapping is cleared before its entries
+ * are restored, and its number of entries restored last.
+ * @param *model Dictionary of the nodes, generated from their EDS
+ * @param *objects List of objects
+ * @param max Its size
+ * @return Number of objects listed, 0 if the list is too short
+ */
+UNS16 confBackupObjects(CO_Data* model, s_conf_object* objects, UNS16 max);
+
+/**
+ * @ingroup confbackup
+ * @brief Initialize a backup context of a master.
+ * @param *cb Context provided by the application
+ * @param *d Pointer on the CAN object data structure of the master
+ * @param *objects Objects to save, kept while the context is used
+ * @param objectsCount
+ * @param *archive Buffer of the archive
+ * @param archiveMax Its size
+ * @param lines Nodes transferred at once, at most CONF_BACKUP_MAX_LINES and
+ * the number of SDO client entries of the master
+ * @return 0 if OK, 0xFF if lines is invalid
+ */
+UNS8 initConfBackup(s_conf_backup* cb, CO_Data* d, const s_conf_object* objects, UNS16 objectsCount,
+		UNS8* archive, UNS32 archiveMax, UNS8 lines);
+
+/**
+ * @ingroup confbackup
+ * @brief Save the configuration of nodes in the archive. The SDO client
+ * entries with no transfer on use are given to the nodes until done is
+ * called with nodeId 0. The archive is complete then, archiveSize being
+ * its size. A node failing is left out of the archive.
+ * @param *cb Context
+ * @param *nodeIds Nodes to save, kept until done
+ * @param nodesCount
+ * @param done Called at the end of each node, and at the end
+ * @return 0 if started, 0xFF if busy or the archive is too small
+ */
+UNS8 confBackupSave(s_conf_backup* cb, const UNS8* nodeIds, UNS8 nodesCount, confBackupDone_t done);
+
+/**
+ * @ingroup confbackup
+ * @brief Restore the configuration of the nodes of an archive.
+ * @param *cb Context
+ * @param *archive Archive, kept until done
+ * @param size Its size
+ * @param done Called at the end of each node, and at the end
+ * @return 0 if started, 0xFF if busy or the archive is not valid
+ */
+UNS8 confBackupRestore(s_conf_backup* cb, UNS8* archive, UNS32 size, confBackupDone_t done);
+
+#endif /* __confbackup_h__ */
@@ -48,6 +48,35 @@ typedef struct struct_CO_Data CO_Data;
 #ifdef CO_ENABLE_LSS
 #include "lss.h"
 #endif
+#ifdef CO_ENABLE_OD_SUBSCRIPTIONS
+#include "odsubscribe.h"
+#endif
+#ifdef CO_ENABLE_PDO_REMAP
+#include "pdoremap.h"
+#endif
+#ifdef CO_ENABLE_CMD_QUEUE
+#include "cmdqueue.h"
+#endif
+#ifdef CO_ENABLE_MULTIBUS
+#include "multibus.h"
+#endif
+#ifdef CO_ENABLE_SDO_ZIP
+#include "sdozip.h"
+#endif
+#ifdef CO_ENABLE_FW_DELTA
+#include "fwdelta.h"
+#endif
+#ifdef CO_ENABLE_EMCY_RING
+#include "emcyring.h"
+#endif
+#ifdef CO_ENABLE_CONF_BACKUP
+#include "confbackup.h"
+#endif
+#ifdef CO_ENABLE_HOOK_PROFILE
+#include "hookprofile.h"
+#else
+#define PROFILE_HOOK(d, hook, index, subIndex, call) call
+#endif
 
 
 typedef UNS32 (*valueRangeTest_t)(UNS8 typeValue, void *Value);
@@ -73,6 +102,15 @@ struct struct_CO_Data {
 	
 	/* SDO */
 	s_transfer transfers[SDO_MAX_SIMULTANEOUS_TRANSFERS];
+#ifdef CO_ENABLE_SDO_DEFER
+	pre_sdoUpload_t pre_sdoUpload;
+#endif
+#ifdef CO_ENABLE_SDO_BUDGET
+	s_sdo_budget* sdoBudget;
+#endif
+#ifdef CO_ENABLE_SDO_ZIP
+	s_sdo_zip* sdoZip;
+#endif
 	/* s_sdo_parameter *sdo_parameters; */
 
 	/* State machine */
@@ -91,8 +129,14 @@ struct struct_CO_Data {
 	TIMER_HANDLE *ConsumerHeartBeatTimers;
 	UNS16 *ProducerHeartBeatTime;
 	TIMER_HANDLE ProducerHeartBeatTimer;
+#ifdef CO_ENABLE_SHARED_HEARTBEAT
+	CO_Data* heartbeatNext; /* Next producer of the shared heartbeat service */
+	UNS32 heartbeatDue; /* Time of the next heartbeat, in ms of the service */
+#endif
 	heartbeatError_t heartbeatError;
+#ifndef CO_PROFILE_SLAVE
 	e_nodeState NMTable[NMT_MAX_NODE_ID]; 
+#endif
 
 	/* NMT-nodeguarding */
 	TIMER_HANDLE GuardTimeTimer;
@@ -100,12 +144,18 @@ struct struct_CO_Data {
 	nodeguardError_t nodeguardError;
 	UNS16 *GuardTime;
 	UNS8 *LifeTimeFactor;
+#ifndef CO_PROFILE_SLAVE
 	UNS8 nodeGuardStatus[NMT_MAX_NODE_ID];
+#endif
 
 	/* SYNC */
 	TIMER_HANDLE syncTimer;
 	UNS32 *COB_ID_Sync;
 	UNS32 *Sync_Cycle_Period;
+#ifdef CO_ENABLE_TXTIME
+	UNS64 syncLaunchTime;	/* Launch time of the next SYNC queued by SyncAlarm */
+	UNS64 txLaunchTime;	/* Launch time of the TPDOs sent while processing it, 0 otherwise */
+#endif
 	/*UNS32 *Sync_window_length;;*/
 	post_sync_t post_sync;
 	post_TPDO_t post_TPDO;
@@ -117,7 +167,17 @@ struct struct_CO_Data {
 	CAN_PORT canHandle;	
 	scanIndexOD_t scanIndexOD;
 	storeODSubIndex_t storeODSubIndex; 
+#ifdef CO_ENABLE_OD_SUBSCRIPTIONS
+	s_od_subscriptions* odSubscriptions;
+#endif
+#ifdef CO_ENABLE_PDO_REMAP
+	s_pdo_remap* pdoRemap;
+#endif
+#ifdef CO_ENABLE_CMD_QUEUE
+	s_cmd_queue* cmdQueue;
+#endif
 	
+#ifndef CO_PROFILE_SLAVE
 	/* DCF concise */
     const indextable* dcf_odentry;
 	UNS8* dcf_cursor;
@@ -125,6 +185,9 @@ struct struct_CO_Data {
 	UNS8 dcf_status;
     UNS32 dcf_size;
     UNS8* dcf_data;
+	UNS16 dcf_index;
+	UNS8 dcf_value[4];
+#endif
 	
 	/* EMCY */
 	e_errorState error_state;
@@ -135,6 +198,13 @@ struct struct_CO_Data {
     UNS32* error_cobid;
 	s_errors error_data[EMCY_MAX_ERRORS];
 	post_emcy_t post_emcy;
+#ifdef CO_ENABLE_EMCY_RING
+	UNS8 error_head;                 /* entry of 0x1003 holding the newest error */
+	s_emcy_drain* emcyDrain;
+#endif
+#ifdef CO_ENABLE_HOOK_PROFILE
+	s_hook_profile* hookProfile;
+#endif
 	
 #ifdef CO_ENABLE_LSS
 	/* LSS */
@@ -143,9 +213,88 @@ struct struct_CO_Data {
 #endif	
 };
 
+#ifdef CO_ENABLE_TXTIME
+#define txtime_Initializer 0, 0,
+#else
+#define txtime_Initializer
+#endif
+
+#ifdef CO_ENABLE_SHARED_HEARTBEAT
+#define sharedHeartbeat_Initializer NULL, 0,
+#else
+#define sharedHeartbeat_Initializer
+#endif
+
+#ifdef CO_ENABLE_SDO_DEFER
+#define sdoDefer_Initializer NULL,
+#else
+#define sdoDefer_Initializer
+#endif
+
+#ifdef CO_ENABLE_SDO_BUDGET
+#define sdoBudget_Initializer NULL,
+#else
+#define sdoBudget_Initializer
+#endif
+
+#ifdef CO_ENABLE_SDO_ZIP
+#define sdoZip_Initializer NULL,
+#else
+#define sdoZip_Initializer
+#endif
+
+#ifdef CO_ENABLE_OD_SUBSCRIPTIONS
+#define odSubscriptions_Initializer NULL,
+#else
+#define odSubscriptions_Initializer
+#endif
+
+#ifdef CO_ENABLE_PDO_REMAP
+#define pdoRemap_Initializer NULL,
+#else
+#define pdoRemap_Initializer
+#endif
+
+#ifdef CO_ENABLE_CMD_QUEUE
+#define cmdQueue_Initializer NULL,
+#else
+#define cmdQueue_Initializer
+#endif
+
+#ifdef CO_ENABLE_EMCY_RING
+#define emcyRing_Initializer 0, NULL,
+#else
+#define emcyRing_Initializer
+#endif
+
+#ifdef CO_ENABLE_HOOK_PROFILE
+#define hookProfile_Initializer NULL,
+#else
+#define hookProfile_Initializer
+#endif
+
 #define NMTable_Initializer Unknown_state,
 #define nodeGuardStatus_Initializer 0x00,
 
+/* The slave profile has no state of the other nodes */
+#ifdef CO_PROFILE_SLAVE
+#define NMTable_Field_Initializer
+#define nodeGuardStatus_Field_Initializer
+#define dcf_Initializer
+#else
+#define NMTable_Field_Initializer {REPEAT_NMT_MAX_NODE_ID_TIMES(NMTable_Initializer)},
+#define nodeGuardStatus_Field_Initializer {REPEAT_NMT_MAX_NODE_ID_TIMES(nodeGuardStatus_Initializer)},
+#define dcf_Initializer \
+	NULL,       /* dcf_odentry */\
+	NULL,       /* dcf_cursor */\
+	1,          /* dcf_entries_count */\
+	0,          /* dcf_status */\
+	0,          /* dcf_size */\
+	NULL,       /* dcf_data */\
+	0,          /* dcf_index */\
+	{0},        /* dcf_value */
+#endif
+
 #ifdef SDO_DYNAMIC_BUFFER_ALLOCATION
 #define s_transfer_Initializer {\
 		0,          /* CliServ{REPEAT_NMT_MAX_NODE_ID_TIMES(NMTable_Initializer)},Nbr */\
@@ -167,10 +316,12 @@ struct struct_CO_Data {
 		0,          /* lastblockoffset */\
 		0,          /* seqno */\
 		0,          /* endfield */\
+		0,          /* burst */\
 		RXSTEP_INIT,/* rxstep */\
 		{0},        /* tmpData */\
 		0,          /* dataType */\
 		-1,         /* timer */\
+		-1,         /* paceTimer */\
 		NULL        /* Callback */\
 	  },
 #else
@@ -192,10 +343,12 @@ struct struct_CO_Data {
 		0,          /* lastblockoffset */\
 		0,          /* seqno */\
 		0,          /* endfield */\
+		0,          /* burst */\
 		RXSTEP_INIT,/* rxstep */\
 		{0},        /* tmpData */\
 		0,          /*  */\
 		-1,         /*  */\
+		-1,         /* paceTimer */\
 		NULL        /*  */\
 	  },
 #endif //SDO_DYNAMIC_BUFFER_ALLOCATION
@@ -267,6 +420,9 @@ struct struct_CO_Data {
 	{\
           REPEAT_SDO_MAX_SIMULTANEOUS_TRANSFERS_TIMES(s_transfer_Initializer)\
 	},\
+	sdoDefer_Initializer             /* pre_sdoUpload */\
+	sdoBudget_Initializer            /* sdoBudget */\
+	sdoZip_Initializer               /* sdoZip */\
 	\
 	/* State machine*/\
 	Unknown_state,      /* nodeState */\
@@ -293,9 +449,10 @@ struct struct_CO_Data {
 	NODE_PREFIX ## _heartBeatTimers,           /* ConsumerHeartBeatTimers  */\
 	& NODE_PREFIX ## _obj1017,                 /* ProducerHeartBeatTime */\
 	TIMER_NONE,                                /* ProducerHeartBeatTimer */\
+	sharedHeartbeat_Initializer                /* heartbeatNext, heartbeatDue */\
 	_heartbeatError,           /* heartbeatError */\
 	\
-	{REPEAT_NMT_MAX_NODE_ID_TIMES(NMTable_Initializer)},\
+	NMTable_Field_Initializer\
                                                    /* is  well initialized at "Unknown_state". Is it ok ? (FD)*/\
 	\
 	/* NMT-nodeguarding */\
@@ -304,12 +461,13 @@ struct struct_CO_Data {
 	_nodeguardError,           /* nodeguardError */\
 	& NODE_PREFIX ## _obj100C,                 /* GuardTime */\
 	& NODE_PREFIX ## _obj100D,                 /* LifeTimeFactor */\
-	{REPEAT_NMT_MAX_NODE_ID_TIMES(nodeGuardStatus_Initializer)},\
+	nodeGuardStatus_Field_Initializer        /* nodeGuardStatus */\
 	\
 	/* SYNC */\
 	TIMER_NONE,                                /* syncTimer */\
 	& NODE_PREFIX ## _obj1005,                 /* COB_ID_Sync */\
 	& NODE_PREFIX ## _obj1006,                 /* Sync_Cycle_Period */\
+	txtime_Initializer                         /* syncLaunchTime, txLaunchTime */\
 	/*& NODE_PREFIX ## _obj1007, */            /* Sync_window_length */\
 	_post_sync,                 /* post_sync */\
 	_post_TPDO,                 /* post_TPDO */\
@@ -321,13 +479,11 @@ struct struct_CO_Data {
 	NULL,                   /* canSend */\
 	NODE_PREFIX ## _scanIndexOD,                /* scanIndexOD */\
 	_storeODSubIndex,                /* storeODSubIndex */\
+	odSubscriptions_Initializer      /* odSubscriptions */\
+	pdoRemap_Initializer             /* pdoRemap */\
+	cmdQueue_Initializer             /* cmdQueue */\
     /* DCF concise */\
-    NULL,       /*dcf_odentry*/\
-	NULL,		/*dcf_cursor*/\
-	1,		/*dcf_entries_count*/\
-	0,		/* dcf_status*/\
-    0,      /* dcf_size */\
-    NULL,   /* dcf_data */\
+	dcf_Initializer\
 	\
 	/* EMCY */\
 	Error_free,                      /* error_state */\
@@ -341,6 +497,8 @@ struct struct_CO_Data {
 	REPEAT_EMCY_MAX_ERRORS_TIMES(ERROR_DATA_INITIALIZER)\
 	},\
 	_post_emcy,              /* post_emcy */\
+	emcyRing_Initializer             /* error_head, emcyDrain */\
+	hookProfile_Initializer          /* hookProfile */\
 	/* LSS */\
 	lss_Initializer\
 }
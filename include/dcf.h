@@ -27,6 +27,13 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #define DCF_STATUS_SAVED        3
 #define DCF_STATUS_VERIF_OK     4
 
+/* Set in the number of entries of a concise DCF in compact encoding
+ * (objdictgen --compact-dcf). Each entry is then : index difference with
+ * the previous entry as a zigzag varint, subindex, size as a varint, and
+ * the value as a varint when it is 4 bytes or less, the raw data otherwise.
+ * Varints are little endian groups of 7 bits, bit 7 set if more follow. */
+#define DCF_COMPACT             0x80000000ul
+
 /** 
  * @brief Init the consise dcf in CO_Data for nodeId
  *
@@ -33,11 +33,13 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #define OD_WRITE_NOT_ALLOWED         0x06010002
 #define OD_NO_SUCH_OBJECT            0x06020000
 #define OD_NOT_MAPPABLE              0x06040041
+#define OD_PDO_LENGTH_EXCEEDED       0x06040042
 #define OD_LENGTH_DATA_INVALID       0x06070010
 #define OD_NO_SUCH_SUBINDEX 	     0x06090011
 #define OD_VALUE_RANGE_EXCEEDED      0x06090030 /* Value range test result */
 #define OD_VALUE_TOO_LOW             0x06090031 /* Value range test result */
 #define OD_VALUE_TOO_HIGH            0x06090032 /* Value range test result */
+#define OD_PENDING                   0x00000001 /* Callback result, not an abort code : the SDO response waits for completeSDOtransfer() */
 /* Others SDO abort codes 
  */
 #define SDOABT_TOGGLE_NOT_ALTERNED   0x05030000
@@ -77,6 +79,9 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #define	SDO_UPLOAD_IN_PROGRESS   0x3   
 #define	SDO_BLOCK_DOWNLOAD_IN_PROGRESS 0x4 
 #define	SDO_BLOCK_UPLOAD_IN_PROGRESS   0x5
+#define	SDO_DOWNLOAD_PENDING     0x6      /* Server : data written, response deferred */
+#define	SDO_UPLOAD_PENDING       0x7      /* Server : data not read yet, response deferred */
+#define	SDO_BLOCK_UPLOAD_PENDING 0x8      /* Server : data not read yet, block response deferred */
 
 /** getReadResultNetworkDict may return any of above status value or this one
  */
@@ -0,0 +1,113 @@
+/*
+This file is part of CanFestival, a library implementing CanOpen Stack.
+
+Copyright (C): Edouard TISSERANT and Francis DUPIN
+
+See COPYING file for copyrights details.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/** @defgroup ds401 DS-401 digital I/O
+ * @brief Packed bitmap handling of the DS-401 8 bit digital input and output groups.
+ * The engine works directly on the object dictionary arrays generated for
+ * 0x6000 (Read Inputs), 0x6002 (Polarity Input), 0x6005 (Global Interrupt Enable),
+ * 0x6006-0x6008 (Interrupt Masks), 0x6200 (Write Outputs), 0x6202 (Change Polarity Outputs)
+ * and 0x6208 (Filter Mask Outputs). Only the objects present in the dictionary are used.
+ * After an input update, only the event driven TPDOs mapping a 0x6000 group that raised
+ * an interrupt are triggered.
+ *  @ingroup userapi
+ */
+
+#ifndef __ds401_h__
+#define __ds401_h__
+
+#include <applicfg.h>
+
+typedef struct struct_s_DS401_io s_DS401_io;
+
+#include "data.h"
+
+/* DS-401 digital I/O objects */
+#define DS401_READ_INPUTS_8_BIT         0x6000
+#define DS401_POLARITY_INPUT_8_BIT      0x6002
+#define DS401_GLOBAL_INTERRUPT_ENABLE   0x6005
+#define DS401_INTERRUPT_MASK_ANY_CHANGE 0x6006
+#define DS401_INTERRUPT_MASK_LOW_TO_HIGH 0x6007
+#define DS401_INTERRUPT_MASK_HIGH_TO_LOW 0x6008
+#define DS401_WRITE_OUTPUTS_8_BIT       0x6200
+#define DS401_CHANGE_POLARITY_OUTPUTS_8_BIT 0x6202
+#define DS401_FILTER_MASK_OUTPUTS_8_BIT 0x6208
+
+/* A subindex is coded on 8 bits, subindex 0 being the number of groups */
+#define DS401_MAX_GROUPS 254
+
+/** Bitmaps bound to the object dictionary by DS401_init */
+struct struct_s_DS401_io {
+  UNS8 nbInputs;                /* Number of 8 bit input groups (0x6000) */
+  UNS8 nbOutputs;               /* Number of 8 bit output groups (0x6200) */
+  UNS8 *inputs;                 /* 0x6000 */
+  const UNS8 *inputPolarity;    /* 0x6002, NULL if absent */
+  const UNS8 *interruptEnable;  /* 0x6005, NULL if absent (always enabled) */
+  const UNS8 *maskAnyChange;    /* 0x6006, NULL if absent (all enabled) */
+  const UNS8 *maskLowToHigh;    /* 0x6007, NULL if absent */
+  const UNS8 *maskHighToLow;    /* 0x6008, NULL if absent */
+  const UNS8 *outputs;          /* 0x6200 */
+  const UNS8 *outputPolarity;   /* 0x6202, NULL if absent */
+  const UNS8 *outputFilter;     /* 0x6208, NULL if absent (all enabled) */
+};
+
+#define s_DS401_io_Initializer {0, 0, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL}
+
+/**
+ * @ingroup ds401
+ * @brief Bind the DS-401 bitmaps to the object dictionary
+ * The 0x6000 and 0x6200 arrays are both optional, but the subindexes of each
+ * present array must be stored contiguously (as generated by objdictgen).
+ * @param *d Pointer on a CAN object data structure
+ * @param *io Pointer on the DS-401 I/O structure to fill
+ * @return OD_SUCCESSFUL or an SDO abort code if an object can't be used
+ */
+UNS32 DS401_init(CO_Data* d, s_DS401_io* io);
+
+/**
+ * @ingroup ds401
+ * @brief Update the inputs from a physical sample and trigger the concerned TPDOs
+ * The polarity is applied to the raw sample, the result is stored in 0x6000 and the
+ * interrupt masks are applied to the transitions. Event driven TPDOs (transmission
+ * type 254 or 255) mapping an interrupting group are sent, the others are left
+ * untouched (acyclic synchronous TPDOs are still handled at the next SYNC).
+ * 0x6000 is written without the OD callbacks, but the changed groups are
+ * notified to the OD subscribers.
+ * @param *d Pointer on a CAN object data structure
+ * @param *io Pointer on the DS-401 I/O structure
+ * @param *raw Physical inputs, one bit per channel, nbInputs bytes
+ * @return Number of TPDOs triggered
+ */
+UNS8 DS401_updateInputs(CO_Data* d, s_DS401_io* io, const UNS8* raw);
+
+/**
+ * @ingroup ds401
+ * @brief Compute the physical outputs from 0x6200
+ * Polarity is applied, and channels not enabled in the output filter mask
+ * keep their previous physical value.
+ * @param *d Pointer on a CAN object data structure
+ * @param *io Pointer on the DS-401 I/O structure
+ * @param *physical Physical outputs, nbOutputs bytes, updated in place
+ * @return 1 if at least one physical output changed, 0 otherwise
+ */
+UNS8 DS401_applyOutputs(CO_Data* d, s_DS401_io* io, UNS8* physical);
+
+#endif /* __ds401_h__ */
@@ -0,0 +1,135 @@
+/*
+This file is part of CanFestival, a library implementing CanOpen Stack.
+
+Copyright (C): Edouard TISSERANT and Francis DUPIN
+
+See COPYING file for copyrights details.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/** @defgroup emcyring Error rings
+ * @brief Application threads report errors and their recovery without
+ * taking the stack mutex, each in its own single producer ring. The stack
+ * drains the rings of a node when it runs its command queue, updates
+ * 0x1001 and 0x1003, and sends the EMCY messages. The EMCY of the errors
+ * raised and recovered in the same drain are not sent, and the messages are
+ * spaced by the inhibit time of 0x1015 if the dictionary has it. The
+ * Pre-defined Error Field 0x1003 is kept as a ring: an error is written
+ * over the oldest one, and the subindexes are mapped on the ring when read,
+ * sub 1 being the newest error.
+ *  @ingroup userapi
+ */
+
+#ifndef __emcyring_h__
+#define __emcyring_h__
+
+#include <applicfg.h>
+
+typedef struct struct_s_emcy_post s_emcy_post;
+typedef struct struct_s_emcy_ring s_emcy_ring;
+typedef struct struct_s_emcy_drain s_emcy_drain;
+
+#include "data.h"
+
+/** An error posted. The cells of a ring are provided by the application. */
+struct struct_s_emcy_post {
+  UNS16 errCode;
+  UNS16 addInfo;
+  UNS8 errRegMask;
+  UNS8 recovered;                      /* EMCY_errorRecovered() instead of EMCY_setError() */
+};
+
+/** Bounded single producer / single consumer ring of an application thread */
+struct struct_s_emcy_ring {
+  CO_Data* d;
+  s_emcy_post* cells;
+  UNS32 mask;                          /* ring size - 1, size is a power of 2 */
+  UNS32 head;                          /* next cell to post, producer side */
+  UNS32 tail;                          /* next cell to drain, stack side */
+  UNS32 posted;                        /* errors posted */
+  UNS32 rejected;                      /* errors not posted because the ring was full */
+  s_emcy_ring* next;
+};
+
+/** Rings of a node and EMCY messages waiting for the inhibit time. The
+ * structure is provided by the application. */
+struct struct_s_emcy_drain {
+  s_emcy_ring* rings;
+  UNS16 pending[EMCY_MAX_ERRORS];      /* errors to signal */
+  UNS8 pendingCount;
+  UNS8 signalled;                      /* an error was the last EMCY sent */
+  UNS8 inhibited;                      /* the inhibit time of the last EMCY runs */
+  TIMER_HANDLE inhibitTimer;
+  /* Metrics, read them with the stack mutex held */
+  UNS32 drained;                       /* posts drained */
+  UNS32 coalesced;                     /* EMCY not sent, error already active or recovered before sending */
+  UNS32 sent;                          /* EMCY sent */
+};
+
+/**
+ * @ingroup emcyring
+ * @brief Let the application threads of a node post errors. The node must
+ * have a command queue, see initCommandQueue(). Must be called with the
+ * stack mutex held.
+ * @param *d Pointer on a CAN object data structure
+ * @param *drain Storage provided by the application
+ */
+void initEMCYDrain(CO_Data* d, s_emcy_drain* drain);
+
+/**
+ * @ingroup emcyring
+ * @brief Remove the rings of a node, the errors still posted are dropped.
+ * Must be called with the stack mutex held, once no thread posts.
+ * @param *d Pointer on a CAN object data structure
+ */
+void stopEMCYDrain(CO_Data* d);
+
+/**
+ * @ingroup emcyring
+ * @brief Give a ring to an application thread of the node. Must be called
+ * with the stack mutex held, before the thread posts.
+ * @param *d Pointer on a CAN object data structure
+ * @param *ring Ring storage, provided by the application
+ * @param *cells Errors storage
+ * @param size Number of errors in cells, must be a power of 2
+ * @return 0 if OK, 0xFF if size is invalid or the node has no drain
+ */
+UNS8 addEMCYRing(CO_Data* d, s_emcy_ring* ring, s_emcy_post* cells, UNS32 size);
+
+/**
+ * @ingroup emcyring
+ * @brief Post EMCY_setError(). Lock-free, from the thread of the ring only.
+ * @param *ring Ring of the thread
+ * @param errCode The error code
+ * @param errRegMask The error register mask
+ * @param addInfo The additional information
+ * @return 0 if posted, 0xFF if the ring is full
+ */
+UNS8 postEMCYRingError(s_emcy_ring* ring, UNS16 errCode, UNS8 errRegMask, UNS16 addInfo);
+
+/**
+ * @ingroup emcyring
+ * @brief Post EMCY_errorRecovered(). Lock-free, from the thread of the ring only.
+ * @param *ring Ring of the thread
+ * @param errCode The error code
+ * @return 0 if posted, 0xFF if the ring is full
+ */
+UNS8 postEMCYRingRecovered(s_emcy_ring* ring, UNS16 errCode);
+
+/* Called by the command queue of the node, with the stack mutex held */
+void _drainEMCYRings(CO_Data* d);
+
+#endif /* __emcyring_h__ */
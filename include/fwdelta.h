@@ -0,0 +1,219 @@
+/*
+This file is part of CanFestival, a library implementing CanOpen Stack.
+
+Copyright (C): Edouard TISSERANT and Francis DUPIN
+
+See COPYING file for copyrights details.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/** @defgroup fwdelta Delta firmware update
+ * @brief Firmware update sending only the difference with the image the
+ * node runs. The node reports the CRC-32 of its image in its software
+ * identification (0x1F56 sub 1). The master finds the release with this
+ * CRC among the ones it knows, and downloads by block SDO a delta made of
+ * copies from that release and of new bytes, in the delta domain object
+ * FW_DELTA_INDEX of the node. The node rebuilds the new image into a
+ * staging area and checks it against the CRC-32 of the delta header before
+ * accepting the download. The application then programs the staged image.
+ * If the release of the node is not known, or the delta is not smaller,
+ * the whole image is downloaded in 0x1F50 sub 1 as before.
+ *  @ingroup userapi
+ */
+
+#ifndef __fwdelta_h__
+#define __fwdelta_h__
+
+#include <applicfg.h>
+
+typedef struct struct_s_fw_image s_fw_image;
+typedef struct struct_s_fw_delta s_fw_delta;
+typedef struct struct_s_fw_delta_node s_fw_delta_node;
+
+#include "data.h"
+
+/* Objects of the node */
+#define FW_PROGRAM_INDEX 0x1F50          /* Download program data, domain */
+#define FW_PROGRAM_SUBINDEX 1
+#define FW_DELTA_IDENT_INDEX 0x1F56      /* Program software identification, UNS32 */
+#define FW_DELTA_IDENT_SUBINDEX 1
+#ifndef FW_DELTA_INDEX
+#define FW_DELTA_INDEX 0x5FF1            /* Manufacturer domain receiving the delta */
+#endif
+#define FW_DELTA_SUBINDEX 0
+
+/* Delta : header of 6 UNS32 little endian (magic, delta size, base size,
+   base CRC, image size, image CRC), then operations : FW_DELTA_COPY,
+   offset in the base and length (UNS32), FW_DELTA_ADD, length (UNS32) and
+   the bytes, and FW_DELTA_END. */
+#define FW_DELTA_MAGIC 0x31444643        /* "CFD1" */
+#define FW_DELTA_HEADER 24
+#define FW_DELTA_END 0
+#define FW_DELTA_COPY 1
+#define FW_DELTA_ADD 2
+
+/* Shorter copies cost more than the bytes */
+#define FW_DELTA_MIN_MATCH 16
+
+/* Match finder of the master, 2^FW_DELTA_HASH_BITS entries */
+#ifndef FW_DELTA_HASH_BITS
+#define FW_DELTA_HASH_BITS 14
+#endif
+
+/* SDO abort codes of the node */
+#define FW_DELTA_ABT_BASE 0x06040043     /* not the image of the node */
+#define FW_DELTA_ABT_CORRUPT 0x08000020  /* delta not valid or image CRC error */
+
+/* Update states */
+#define FW_DELTA_IDLE 0
+#define FW_DELTA_IDENT 1                 /* reading the identification */
+#define FW_DELTA_DELTA 2                 /* downloading the delta */
+#define FW_DELTA_FULL 3                  /* downloading the whole image */
+
+/* End of an update, abortCode is 0 if the image is downloaded */
+typedef void (*fwDeltaDone_t)(s_fw_delta* fw, UNS8 nodeId, UNS32 abortCode);
+/* New image staged by the node */
+typedef void (*fwDeltaStaged_t)(CO_Data* d, const UNS8* image, UNS32 size);
+
+/** A firmware release the nodes may run */
+struct struct_s_fw_image {
+  const UNS8* data;
+  UNS32 size;
+  UNS32 crc;                           /* set by initFwDelta() */
+};
+
+/** Update of a node by the master. The structure is provided by the application. */
+struct struct_s_fw_delta {
+  s_fw_image* bases;                   /* releases known */
+  UNS8 basesCount;
+  UNS8* delta;                         /* buffer of the delta */
+  UNS32 deltaMax;
+  UNS32 deltaSize;
+  CO_Data* d;
+  UNS8 nodeId;
+  UNS8 state;                          /* FW_DELTA_... */
+  const UNS8* image;                   /* new image */
+  UNS32 size;
+  fwDeltaDone_t done;
+  s_fw_delta* next;
+  UNS32 hash[1 << FW_DELTA_HASH_BITS]; /* last position + 1 of each hash in the base */
+  /* Metrics */
+  UNS32 deltaUpdates;                  /* updates done with a delta */
+  UNS32 fullUpdates;                   /* updates done with the whole image */
+  UNS32 imageBytes;                    /* bytes of the images downloaded */
+  UNS32 sentBytes;                     /* bytes sent for them */
+};
+
+/** Delta object of a node. The structure is provided by the application. */
+struct struct_s_fw_delta_node {
+  CO_Data* d;
+  const UNS8* image;                   /* image run by the node */
+  UNS32 size;
+  UNS32 crc;
+  UNS8* staging;                       /* area of the new image */
+  UNS32 stagingSize;
+  UNS32 stagedSize;                    /* bytes of the image staged, 0 if none */
+  fwDeltaStaged_t staged;
+  s_fw_delta_node* next;
+};
+
+/**
+ * @ingroup fwdelta
+ * @brief CRC-32 (IEEE 802.3) of a buffer.
+ * @param crc 0, or the CRC of the previous bytes
+ * @param *data
+ * @param size
+ * @return The CRC
+ */
+UNS32 fwDeltaCRC(UNS32 crc, const UNS8* data, UNS32 size);
+
+/**
+ * @ingroup fwdelta
+ * @brief Make the delta turning a base image into a new one.
+ * @param *fw Context, for its match finder
+ * @param *base
+ * @param baseSize
+ * @param *image
+ * @param size
+ * @param *out Buffer of the delta
+ * @param outSize
+ * @return Bytes of the delta, 0 if it does not fit
+ */
+UNS32 fwDeltaEncode(s_fw_delta* fw, const UNS8* base, UNS32 baseSize, const UNS8* image, UNS32 size,
+		UNS8* out, UNS32 outSize);
+
+/**
+ * @ingroup fwdelta
+ * @brief Rebuild an image from its base and a delta, and check it.
+ * @param *base
+ * @param baseSize
+ * @param *delta
+ * @param deltaSize Bytes available, the delta may be shorter
+ * @param *out
+ * @param outSize
+ * @param *size Bytes of the image
+ * @return 0 if OK, FW_DELTA_ABT_BASE, FW_DELTA_ABT_CORRUPT or
+ * SDOABT_OUT_OF_MEMORY
+ */
+UNS32 fwDeltaApply(const UNS8* base, UNS32 baseSize, const UNS8* delta, UNS32 deltaSize,
+		UNS8* out, UNS32 outSize, UNS32* size);
+
+/**
+ * @ingroup fwdelta
+ * @brief Initialize an update context of the master.
+ * @param *fw Context provided by the application
+ * @param *bases Releases the nodes may run, their CRC is computed
+ * @param basesCount
+ * @param *delta Buffer of the delta
+ * @param deltaMax Its size
+ */
+void initFwDelta(s_fw_delta* fw, s_fw_image* bases, UNS8 basesCount, UNS8* delta, UNS32 deltaMax);
+
+/**
+ * @ingroup fwdelta
+ * @brief Download a new image to a node, as a delta if its release is
+ * known. The SDO client of the node is used until done is called. A context
+ * updates one node at a time.
+ * @param *fw Context
+ * @param *d Pointer to a CAN object data structure
+ * @param nodeId Node Id of the slave
+ * @param *image New image, kept until done is called
+ * @param size
+ * @param done Called at the end of the update
+ * @return 0 if started, 0xFF if the context is busy or the read failed
+ */
+UNS8 fwDeltaUpdate(s_fw_delta* fw, CO_Data* d, UNS8 nodeId, const UNS8* image, UNS32 size, fwDeltaDone_t done);
+
+/**
+ * @ingroup fwdelta
+ * @brief Let a node receive deltas of its image. The CRC of the image is
+ * written in its identification (0x1F56 sub 1) if the dictionary has it,
+ * and the delta domain FW_DELTA_INDEX gets the callback rebuilding the
+ * image. The domain and the SDO lines must hold the largest delta. Unlike
+ * the other domains, it accepts a write shorter than its size.
+ * @param *d Pointer to a CAN object data structure
+ * @param *node Context provided by the application
+ * @param *image Image run by the node
+ * @param size
+ * @param *staging Area of the new image
+ * @param stagingSize
+ * @param staged Called when a new image is staged, or NULL
+ * @return 0 if OK, or the error of the callback registration
+ */
+UNS32 initFwDeltaNode(CO_Data* d, s_fw_delta_node* node, const UNS8* image, UNS32 size,
+		UNS8* staging, UNS32 stagingSize, fwDeltaStaged_t staged);
+
+#endif /* __fwdelta_h__ */
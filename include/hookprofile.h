@@ -0,0 +1,146 @@
+/*
+This file is part of CanFestival, a library implementing CanOpen Stack.
+
+Copyright (C): Edouard TISSERANT and Francis DUPIN
+
+See COPYING file for copyrights details.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/** @defgroup hookprofile Hook profiler
+ * @brief Execution time of the application hooks called by the stack: the
+ * state and SYNC hooks, post_emcy, the hooks of the NMT master, the SDO
+ * callbacks and the callbacks of the dictionary. Each call is timed with
+ * the monotonic clock and counted in the histogram of its hook, the SDO
+ * and dictionary callbacks also in the one of their object. A call longer
+ * than the budget of its hook is reported. The time of a hook includes the
+ * hooks it causes, an SDO callback writing an object with a callback for
+ * instance.
+ *  @ingroup userapi
+ */
+
+#ifndef __hookprofile_h__
+#define __hookprofile_h__
+
+#include <applicfg.h>
+
+typedef struct struct_s_hook_stats s_hook_stats;
+typedef struct struct_s_hook_profile s_hook_profile;
+
+#include "data.h"
+
+/* Hooks */
+#define HOOK_INITIALISATION 0
+#define HOOK_PRE_OPERATIONAL 1
+#define HOOK_OPERATIONAL 2
+#define HOOK_STOPPED 3
+#define HOOK_POST_SYNC 4
+#define HOOK_POST_TPDO 5
+#define HOOK_POST_EMCY 6
+#define HOOK_HEARTBEAT_ERROR 7
+#define HOOK_NODEGUARD_ERROR 8
+#define HOOK_POST_SLAVE_BOOTUP 9
+#define HOOK_POST_SLAVE_STATE_CHANGE 10
+#define HOOK_STORE_OD 11
+#define HOOK_SDO 12                      /* SDO callbacks, per object too */
+#define HOOK_OD 13                       /* dictionary callbacks, per object too */
+#define HOOK_COUNT 14
+
+/* Statistics kept, the first HOOK_COUNT are the ones of the hooks */
+#ifndef HOOK_PROFILE_SLOTS
+#define HOOK_PROFILE_SLOTS 48
+#endif
+
+/* Histogram : < 1 us, then [2^(i-1), 2^i[ us, the last one up */
+#define HOOK_PROFILE_BUCKETS 16
+
+/* Call of a hook longer than its budget */
+typedef void (*hookOverrun_t)(CO_Data* d, UNS8 hook, UNS16 index, UNS8 subIndex, UNS32 ns);
+
+/** Statistics of a hook, or of the callbacks of an object */
+struct struct_s_hook_stats {
+  UNS8 hook;                           /* HOOK_... */
+  UNS8 subIndex;
+  UNS16 index;                         /* object of an SDO or dictionary callback */
+  UNS32 calls;
+  UNS32 overruns;                      /* calls longer than the budget */
+  UNS32 worst;                         /* ns */
+  UNS64 total;                         /* ns */
+  UNS32 histogram[HOOK_PROFILE_BUCKETS];
+};
+
+/** Profile of the hooks of a node. The structure is provided by the application. */
+struct struct_s_hook_profile {
+  UNS32 budget[HOOK_COUNT];            /* ns, 0 for none */
+  hookOverrun_t overrun;
+  UNS8 objectsDropped;                 /* objects without statistics, no slot left */
+  UNS8 slotsCount;
+  s_hook_stats slots[HOOK_PROFILE_SLOTS];
+};
+
+/**
+ * @ingroup hookprofile
+ * @brief Time the hooks of a node. Must be called with the stack mutex held.
+ * @param *d Pointer on a CAN object data structure
+ * @param *profile Storage provided by the application, NULL to stop
+ * @param overrun Called when a hook is over its budget, or NULL
+ */
+void initHookProfile(CO_Data* d, s_hook_profile* profile, hookOverrun_t overrun);
+
+/**
+ * @ingroup hookprofile
+ * @brief Set the budget of a hook.
+ * @param *d Pointer on a CAN object data structure
+ * @param hook HOOK_...
+ * @param us Budget in us, 0 for none
+ * @return 0 if OK, 0xFF if the node is not profiled or hook is invalid
+ */
+UNS8 setHookBudget(CO_Data* d, UNS8 hook, UNS32 us);
+
+/**
+ * @ingroup hookprofile
+ * @brief Clear the statistics, the budgets are kept. Must be called with
+ * the stack mutex held.
+ * @param *d Pointer on a CAN object data structure
+ */
+void resetHookProfile(CO_Data* d);
+
+/**
+ * @ingroup hookprofile
+ * @brief Write the statistics of the hooks called, as text. Must be called
+ * with the stack mutex held.
+ * @param *d Pointer on a CAN object data structure
+ * @param *buf
+ * @param size Size of buf, the report is cut to fit
+ * @return Length of the report, 0 if the node is not profiled
+ */
+UNS32 hookProfileReport(CO_Data* d, char* buf, UNS32 size);
+
+/* Called around the hooks, see PROFILE_HOOK */
+UNS32 _hookProfileStart(CO_Data* d);
+void _hookProfileEnd(CO_Data* d, UNS8 hook, UNS16 index, UNS8 subIndex, UNS32 start);
+
+/* The object is read before the call, which may reset an SDO line */
+#define PROFILE_HOOK(d, hook, index, subIndex, call) \
+  do{ \
+    UNS16 _hookIndex = (index); \
+    UNS8 _hookSubIndex = (subIndex); \
+    UNS32 _hookStart = _hookProfileStart(d); \
+    call; \
+    _hookProfileEnd(d, hook, _hookIndex, _hookSubIndex, _hookStart); \
+  }while(0)
+
+#endif /* __hookprofile_h__ */
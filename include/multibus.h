@@ -0,0 +1,158 @@
+/*
+This file is part of CanFestival, a library implementing CanOpen Stack.
+
+Copyright (C): Edouard TISSERANT and Francis DUPIN
+
+See COPYING file for copyrights details.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/** @defgroup multibus Multi-bus master
+ * @brief One logical master managing the nodes of several CAN buses. Each
+ * bus has its own master CO_Data, opened on its own port, with its own NMT
+ * table, heartbeat consumers, SDO lines and alarms. The multi-bus master
+ * addresses the nodes by bus and node-id, and reports their state changes
+ * and heartbeat errors with the bus they are on. The buses share nothing,
+ * so they can be processed by different threads when the timers driver
+ * gives each thread its own timer table (CO_ENABLE_TIMER_CONTEXTS).
+ *  @ingroup userapi
+ */
+
+#ifndef __multibus_h__
+#define __multibus_h__
+
+#include <applicfg.h>
+
+typedef struct struct_s_multibus s_multibus;
+
+#include "data.h"
+
+/* Bus number standing for all the buses */
+#define MULTIBUS_ALL 0xFF
+
+/* Called with the bus number, from the thread processing the bus */
+typedef void (*multiBusStateChange_t)(s_multibus* mb, UNS8 bus, UNS8 nodeId, e_nodeState newNodeState);
+typedef void (*multiBusHeartbeatError_t)(s_multibus* mb, UNS8 bus, UNS8 nodeId);
+
+/** A multi-bus master. The structure is provided by the application. */
+struct struct_s_multibus {
+  CO_Data** buses;                     /* master of each bus */
+  UNS8 count;                          /* number of buses */
+  multiBusStateChange_t stateChange;   /* NULL if unused */
+  multiBusHeartbeatError_t heartbeatError; /* NULL if unused */
+  s_multibus* next;
+};
+
+/**
+ * @ingroup multibus
+ * @brief Gather the masters of several buses. The post_SlaveStateChange and
+ * heartbeatError callbacks of each master are taken over, set stateChange
+ * and heartbeatError of mb instead. The SDO client entries (0x1280...) of the
+ * masters are shared by the nodes of their bus: an entry with no transfer on
+ * use is given to the node addressed when none is set up for it.
+ * @param *mb Multi-bus master, provided by the application
+ * @param **buses Master of each bus, bus numbers are their positions
+ * @param count Number of buses, less than MULTIBUS_ALL
+ * @return 0 if OK, 0xFF if count is invalid
+ */
+UNS8 initMultiBus(s_multibus* mb, CO_Data** buses, UNS8 count);
+
+/**
+ * @ingroup multibus
+ * @brief Give the callbacks of the masters back to the application defaults.
+ * @param *mb Multi-bus master
+ */
+void stopMultiBus(s_multibus* mb);
+
+/**
+ * @ingroup multibus
+ * @brief Bus of a master, for the SDO callbacks.
+ * @param *mb Multi-bus master
+ * @param *d Master of a bus
+ * @return The bus number, MULTIBUS_ALL if d is not a bus of mb
+ */
+UNS8 multiBusIndex(s_multibus* mb, CO_Data* d);
+
+/**
+ * @ingroup multibus
+ * @brief Send a NMT command to a node of a bus.
+ * @param *mb Multi-bus master
+ * @param bus Bus number, MULTIBUS_ALL for all the buses
+ * @param nodeId Id of the slave node, 0 for all the nodes of the bus
+ * @param cs The new state
+ * @return 0 if OK, 0xFF if bus is invalid or a command could not be sent
+ */
+UNS8 multiBusNMT(s_multibus* mb, UNS8 bus, UNS8 nodeId, UNS8 cs);
+
+/**
+ * @ingroup multibus
+ * @brief State of a node in the NMT table of its bus.
+ * @param *mb Multi-bus master
+ * @param bus Bus number
+ * @param nodeId Id of the slave node
+ * @return The state, Unknown_state if bus or nodeId is invalid
+ */
+e_nodeState multiBusNodeState(s_multibus* mb, UNS8 bus, UNS8 nodeId);
+
+/**
+ * @ingroup multibus
+ * @brief Count the nodes in a state.
+ * @param *mb Multi-bus master
+ * @param bus Bus number, MULTIBUS_ALL for all the buses
+ * @param state State of the nodes to count
+ * @return Number of nodes
+ */
+UNS32 multiBusCountNodes(s_multibus* mb, UNS8 bus, e_nodeState state);
+
+/**
+ * @ingroup multibus
+ * @brief writeNetworkDictCallBack() to a node of a bus. The result is read
+ * with the master of the bus, given to Callback.
+ * @param *mb Multi-bus master
+ * @param bus Bus number
+ * @param nodeId Node Id of the slave
+ * @param index At index indicated
+ * @param subIndex At subIndex indicated
+ * @param count Number of bytes to write
+ * @param dataType visible_string for strings, 0 for the other types
+ * @param *data Pointer to data
+ * @param Callback Callback function
+ * @param useBlockMode
+ * @return 0 if OK, 0xFF if bus is invalid, no SDO client is free or the
+ * transfer could not start
+ */
+UNS8 multiBusWriteNetworkDict(s_multibus* mb, UNS8 bus, UNS8 nodeId, UNS16 index, UNS8 subIndex,
+		UNS32 count, UNS8 dataType, void* data, SDOCallback_t Callback, UNS8 useBlockMode);
+
+/**
+ * @ingroup multibus
+ * @brief readNetworkDictCallback() from a node of a bus. The result is read
+ * with getReadResultNetworkDict() and the master of the bus, given to Callback.
+ * @param *mb Multi-bus master
+ * @param bus Bus number
+ * @param nodeId Node Id of the slave
+ * @param index At index indicated
+ * @param subIndex At subIndex indicated
+ * @param dataType visible_string for strings, 0 for the other types
+ * @param Callback Callback function
+ * @param useBlockMode
+ * @return 0 if OK, 0xFF if bus is invalid, no SDO client is free or the
+ * transfer could not start
+ */
+UNS8 multiBusReadNetworkDict(s_multibus* mb, UNS8 bus, UNS8 nodeId, UNS16 index, UNS8 subIndex,
+		UNS8 dataType, SDOCallback_t Callback, UNS8 useBlockMode);
+
+#endif /* __multibus_h__ */
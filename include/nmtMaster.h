@@ -80,7 +80,9 @@ UNS8 masterSendNMTnodeguard (CO_Data* d, UNS8 nodeId);
  * @param *d Pointer to a CAN object data structure
  * @param nodeId Id of the slave node
  */
+#ifndef CO_PROFILE_SLAVE
 UNS8 masterRequestNodeState (CO_Data* d, UNS8 nodeId);
+#endif
 
 
 #endif /* __nmtMaster_h__ */
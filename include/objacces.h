@@ -165,6 +165,11 @@ loop if it fails. */
 		accessDictionaryError(wIndex, bSubindex, 0, 0, OD_NO_SUCH_SUBINDEX);
 		return OD_NO_SUCH_SUBINDEX;
 	}
+#ifdef CO_ENABLE_EMCY_RING
+	/* 0x1003 is a ring, sub 1 gives the newest error */
+	if (wIndex == 0x1003 && bSubindex && bSubindex <= d->error_history_size)
+		bSubindex = (UNS8)(1 + (d->error_head + d->error_history_size - (bSubindex - 1)) % d->error_history_size);
+#endif
 	*result = &ptrTable->pSubindex[bSubindex];
 	return OD_SUCCESSFUL;
 }
@@ -172,7 +177,7 @@ loop if it fails. */
 static inline uint8_t _checkODentryAccess(const CO_Data* d,
 	const subindex *ptrTable, UNS16 wIndex, UNS8 bSubindex) {
 	if (ptrTable->bAccessType & WO) {
-		MSG_WAR(0x2B30, "Access Type : ", ptrTable->pSubindex[bSubindex].bAccessType);
+		MSG_WAR(0x2B30, "Access Type : ", ptrTable->bAccessType);
 		accessDictionaryError(wIndex, bSubindex, 0, 0, OD_READ_NOT_ALLOWED);
 		return TRUE;
 	}
@@ -270,7 +275,7 @@ static inline UNS32 getODentry(CO_Data* OD, UNS16 wIndex, UNS8 bSubindex, void*
 	if (err != OD_SUCCESSFUL)
 		return err;
 	if (checkAccess)
-		if (!_checkODentryAccess(OD, ptrTable, wIndex, bSubindex))
+		if (_checkODentryAccess(OD, ptrTable, wIndex, bSubindex))
 			return OD_READ_NOT_ALLOWED;
 	
 	*pDataType = ptrTable->bDataType;
@@ -360,6 +365,8 @@ UNS32 _setODentry( CO_Data* d,
  * @return 
  * - OD_SUCCESSFUL is returned upon success. 
  * - SDO abort code is returned if error occurs . (See file def.h)
+ * - OD_PENDING is returned if the value is written and the callback of the
+ *   entry defers the SDO response, see completeSDOtransfer()
  */
 #define setODentry( d, wIndex, bSubindex, pSourceData, pExpectedSize, \
                   checkAccess) \
@@ -385,6 +392,8 @@ UNS32 _setODentry( CO_Data* d,
  * @return 
  * - OD_SUCCESSFUL is returned upon success. 
  * - SDO abort code is returned if error occurs . (See file def.h)
+ * - OD_PENDING is returned if the value is written and the callback of the
+ *   entry defers the SDO response, see completeSDOtransfer()
  * \n\n
  * @code
  * // Example usage:
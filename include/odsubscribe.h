@@ -0,0 +1,139 @@
+/*
+This file is part of CanFestival, a library implementing CanOpen Stack.
+
+Copyright (C): Edouard TISSERANT and Francis DUPIN
+
+See COPYING file for copyrights details.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/** @defgroup odsubscribe Object Dictionary change subscriptions
+ * @brief Any number of subscribers can follow the changes of a range of entries.
+ * Each change made through setODentry (SDO, RPDO or application) is appended to
+ * the single producer / single consumer ring of every matching subscriber.
+ * Changes of the same entry made while processing one CAN message are coalesced,
+ * and published at once when the message is processed. The application thread
+ * reads them in batches with readODChanges(), without taking the stack mutex.
+ *  @ingroup od
+ */
+
+#ifndef __odsubscribe_h__
+#define __odsubscribe_h__
+
+#include <applicfg.h>
+
+typedef struct struct_s_od_change s_od_change;
+typedef struct struct_s_od_subscriber s_od_subscriber;
+typedef struct struct_s_od_subscriptions s_od_subscriptions;
+
+#include "data.h"
+
+/* Subscribe to all the subindexes of the index range */
+#define OD_SUBSCRIBE_ALL_SUBINDEXES 0xFF
+
+/* Bytes of the new value stored in a change, larger entries are truncated */
+#define OD_CHANGE_VALUE_SIZE 8
+
+/** A change of an object dictionary entry */
+struct struct_s_od_change {
+  UNS16 index;
+  UNS8 subIndex;
+  UNS8 count;                          /* changes coalesced in this one */
+  UNS32 size;                          /* size of the entry */
+  UNS8 value[OD_CHANGE_VALUE_SIZE];    /* first bytes of the new value */
+  TIMEVAL timestamp;
+};
+
+/* Optional filter, called with the stack mutex held : return 0 to drop the change */
+typedef UNS8 (*ODChangeFilter_t)(void* context, UNS16 index, UNS8 subIndex, const void* value, UNS32 size);
+/* Clock used to timestamp the changes */
+typedef TIMEVAL (*ODChangeClock_t)(void);
+
+/** A subscriber. Its ring buffer is provided by the application. */
+struct struct_s_od_subscriber {
+  UNS16 firstIndex;
+  UNS16 lastIndex;
+  UNS8 subIndex;                       /* or OD_SUBSCRIBE_ALL_SUBINDEXES */
+  ODChangeFilter_t filter;             /* NULL to keep every change */
+  void* context;                       /* passed to filter */
+  s_od_change* ring;
+  UNS16 ringMask;                      /* ring size - 1, size is a power of 2 */
+  UNS16 head;                          /* next change to read, consumer side */
+  UNS16 published;                     /* end of the changes visible to the consumer */
+  UNS16 tail;                          /* next change to write, producer side */
+  UNS32 overruns;                      /* changes dropped because the ring was full */
+  s_od_subscriber* next;
+};
+
+/** Subscriptions of a node */
+struct struct_s_od_subscriptions {
+  s_od_subscriber* first;
+  ODChangeClock_t clock;               /* NULL : changes are stamped with the pass number */
+  TIMEVAL pass;                        /* number of dispatch passes */
+  UNS8 inPass;                         /* processing a CAN message */
+};
+
+/**
+ * @ingroup odsubscribe
+ * @brief Enable the subscriptions for a node
+ * @param *d Pointer on a CAN object data structure
+ * @param *subs Subscriptions storage, provided by the application
+ * @param clock Function returning the timestamp of the changes, or NULL
+ */
+void initODSubscriptions(CO_Data* d, s_od_subscriptions* subs, ODChangeClock_t clock);
+
+/**
+ * @ingroup odsubscribe
+ * @brief Subscribe to the changes of the entries firstIndex..lastIndex
+ * Must be called with the stack mutex held, like the other services.
+ * @param *d Pointer on a CAN object data structure
+ * @param *s Subscriber storage, provided by the application
+ * @param firstIndex First index of the range
+ * @param lastIndex Last index of the range
+ * @param subIndex Subindex, or OD_SUBSCRIBE_ALL_SUBINDEXES
+ * @param filter Optional filter, or NULL
+ * @param *context Passed to filter
+ * @param *ring Ring buffer storage
+ * @param ringSize Number of changes in ring, must be a power of 2
+ * @return 0 if OK, 0xFF if subscriptions are not enabled or ringSize is invalid
+ */
+UNS8 subscribeODChanges(CO_Data* d, s_od_subscriber* s, UNS16 firstIndex, UNS16 lastIndex,
+		UNS8 subIndex, ODChangeFilter_t filter, void* context, s_od_change* ring, UNS16 ringSize);
+
+/**
+ * @ingroup odsubscribe
+ * @brief Remove a subscriber. Must be called with the stack mutex held.
+ * @param *d Pointer on a CAN object data structure
+ * @param *s Subscriber
+ */
+void unsubscribeODChanges(CO_Data* d, s_od_subscriber* s);
+
+/**
+ * @ingroup odsubscribe
+ * @brief Read a batch of changes. Lock-free : only one thread may read a given subscriber.
+ * @param *s Subscriber
+ * @param *batch Destination of the changes
+ * @param max Maximum number of changes to read
+ * @return number of changes read
+ */
+UNS16 readODChanges(s_od_subscriber* s, s_od_change* batch, UNS16 max);
+
+/* Internal, called by the stack */
+void _notifyODChange(CO_Data* d, UNS16 index, UNS8 subIndex, const void* value, UNS32 size);
+void _beginODChangePass(CO_Data* d);
+void _endODChangePass(CO_Data* d);
+
+#endif /* __odsubscribe_h__ */
@@ -0,0 +1,116 @@
+/*
+This file is part of CanFestival, a library implementing CanOpen Stack.
+
+Copyright (C): Edouard TISSERANT and Francis DUPIN
+
+See COPYING file for copyrights details.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+/** @defgroup pdoremap PDO mapping swap
+ * @brief New PDO mappings are staged off to the side while the PDOs keep
+ * running with their current mapping. All the staged mappings are written
+ * to the mapping parameters (0x1600.. and 0x1A00..) at once, at the next
+ * SYNC before the synchronous TPDOs are built, or when the application
+ * commits them. They are staged with stagePDOMapping(), or from a
+ * manufacturer domain object written by SDO (block SDO for large sets).
+ *  @ingroup pdo
+ */
+
+#ifndef __pdoremap_h__
+#define __pdoremap_h__
+
+#include <applicfg.h>
+
+typedef struct struct_s_pdo_mapping s_pdo_mapping;
+typedef struct struct_s_pdo_remap s_pdo_remap;
+
+#include "data.h"
+
+/* Mapped objects of a PDO: 64 bits of 1 bit objects */
+#define PDO_MAX_MAPPED 64
+
+/** A staged mapping */
+struct struct_s_pdo_mapping {
+  UNS16 mapIndex;                      /* 0x1600.. or 0x1A00.., 0 if the slot is free */
+  UNS8 count;                          /* number of mapped objects */
+  UNS32 entries[PDO_MAX_MAPPED];       /* index << 16 | subindex << 8 | size in bits */
+};
+
+/** Staged mappings of a node. The slots are provided by the application. */
+struct struct_s_pdo_remap {
+  s_pdo_mapping* slots;
+  UNS8 slotsCount;
+  UNS8 staged;                         /* slots in use */
+  UNS32 swaps;                         /* swaps done, for the application */
+};
+
+/**
+ * @ingroup pdoremap
+ * @brief Enable the mapping swaps for a node
+ * @param *d Pointer on a CAN object data structure
+ * @param *remap Staging storage, provided by the application
+ * @param *slots Staged mappings storage, one per PDO changed in a swap
+ * @param slotsCount Number of slots
+ */
+void initPDORemap(CO_Data* d, s_pdo_remap* remap, s_pdo_mapping* slots, UNS8 slotsCount);
+
+/**
+ * @ingroup pdoremap
+ * @brief Stage a new mapping of a PDO, replacing the one already staged for it.
+ * The mapped objects must exist and fit in 64 bits, and the mapping
+ * parameter must have enough subindexes.
+ * Must be called with the stack mutex held, like the other services.
+ * @param *d Pointer on a CAN object data structure
+ * @param mapIndex Mapping parameter index, 0x1600.. (RPDO) or 0x1A00.. (TPDO)
+ * @param count Number of mapped objects
+ * @param *entries Mapped objects, index << 16 | subindex << 8 | size in bits
+ * @return OD_SUCCESSFUL, or the SDO abort code of the error
+ */
+UNS32 stagePDOMapping(CO_Data* d, UNS16 mapIndex, UNS8 count, const UNS32* entries);
+
+/**
+ * @ingroup pdoremap
+ * @brief Drop the staged mappings
+ * @param *d Pointer on a CAN object data structure
+ */
+void cancelPDOMappings(CO_Data* d);
+
+/**
+ * @ingroup pdoremap
+ * @brief Write the staged mappings now, for the nodes without SYNC.
+ * The TPDOs whose mapping changed are sent again at their next event.
+ * @param *d Pointer on a CAN object data structure
+ * @return Number of PDOs whose mapping changed
+ */
+UNS8 commitPDOMappings(CO_Data* d);
+
+/**
+ * @ingroup pdoremap
+ * @brief Callback to register on a manufacturer domain object, with
+ * RegisterSetODentryCallBack(). The domain holds mapping records, in
+ * little endian: mapIndex (UNS16), count (UNS8), then count entries (UNS32).
+ * A record with mapIndex 0, or the end of the domain, ends the list.
+ * All the records are staged, or none if one is invalid.
+ * @param *d Pointer on a CAN object data structure
+ * @param *OD_entry Domain object
+ * @param bSubindex Domain subindex
+ * @return OD_SUCCESSFUL, or the SDO abort code of the error
+ */
+UNS32 PDORemapObjectCallback(CO_Data* d, const indextable* OD_entry, UNS8 bSubindex);
+
+#endif /* __pdoremap_h__ */
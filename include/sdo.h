@@ -46,6 +46,43 @@ typedef enum {RXSTEP_INIT, RXSTEP_STARTED, RXSTEP_END } rxStep_t;
 
 typedef void (*SDOCallback_t)(CO_Data* d, UNS8 nodeId);
 
+/* Called by the SDO server before reading an entry for an upload. Returns
+ * OD_SUCCESSFUL to read it at once, OD_PENDING to defer the response until
+ * completeSDOtransfer(), or an SDO abort code. */
+typedef UNS32 (*pre_sdoUpload_t)(CO_Data* d, UNS16 index, UNS8 subIndex);
+
+#ifdef CO_ENABLE_SDO_BUDGET
+/* SDO frames of a budget waiting for tokens, the others are sent over budget */
+#ifndef SDO_BUDGET_QUEUE
+#define SDO_BUDGET_QUEUE (2 * SDO_MAX_SIMULTANEOUS_TRANSFERS)
+#endif
+
+/* Bits of an SDO frame on the bus, with the frame overhead and the worst bit stuffing */
+#define SDO_FRAME_BITS (47 + 64 + (34 + 64 - 1) / 4)
+
+/* Bus-load budget of the SDO frames sent on a CAN port, shared by the nodes
+ * opened on it. Token bucket in bits, see initSDObudget(). */
+typedef struct struct_s_sdo_budget {
+  UNS32 rate;                          /* bits/s */
+  UNS32 depth;                         /* bucket size, bits */
+  INTEGER32 tokens;                    /* bits that can be sent now */
+  UNS32 remainder;                     /* refill fraction of a bit, in millionths */
+  UNS32 tick;                          /* refill period, us */
+  TIMER_HANDLE timer;                  /* refill, armed while the bucket is not full */
+  CO_Data* timerData;                  /* node of the refill alarm */
+  CO_Data* nodes[SDO_BUDGET_QUEUE];    /* sender of each queued frame */
+  Message queue[SDO_BUDGET_QUEUE];     /* frames waiting for tokens */
+  UNS8 first;
+  UNS8 count;
+  /* Metrics, read them with the stack mutex held */
+  UNS32 frames;                        /* SDO frames sent */
+  UNS32 bits;                          /* SDO bits sent, SDO_FRAME_BITS per frame */
+  UNS32 queued;                        /* frames that waited for tokens */
+  UNS32 overflows;                     /* frames sent over budget, the queue being full */
+  UNS32 paced;                         /* times block segments waited for tokens */
+} s_sdo_budget;
+#endif
+
 /* The Transfer structure
 Used to store the different segments of
  - a SDO received before writing in the dictionary
@@ -81,9 +118,10 @@ struct struct_s_transfer {
   UNS8           blksize;           /**< Number of segments per block with 0 < blksize < 128 */
   UNS8           ackseq;            /**< sequence number of last segment that was received successfully */
   UNS32          objsize;           /**< Size in bytes of the object provided by data producer */
-  UNS8           lastblockoffset;   /**< Value of offset before last block */
+  UNS32          lastblockoffset;   /**< Value of offset before last block */
   UNS8           seqno;             /**< Last sequence number received OK or transmitted */   
   UNS8           endfield;          /**< nbr of bytes in last segment of last block that do not contain data */
+  UNS8           burst;             /**< data producer : segments sent at once, adapted to the acknowledges */
   rxStep_t       rxstep;            /**< data consumer receive step - set to true when last segment of a block received */
   UNS8           tmpData[8];        /**< temporary segment storage */
 
@@ -97,6 +135,7 @@ struct struct_s_transfer {
                               * SDO_UPLOAD_IN_PROGRESS, and reseted to 0
                               * when the response SDO have been received.
                               */
+  TIMER_HANDLE   paceTimer;  /**< data producer : sends the rest of the block */
   SDOCallback_t Callback;   /**< The user callback func to be called at SDO transaction end */
 };
 typedef struct struct_s_transfer s_transfer;
@@ -465,4 +504,50 @@ UNS8 getReadResultNetworkDict (CO_Data* d, UNS8 nodeId, void* data, UNS32 *size,
 */
 UNS8 getWriteResultNetworkDict (CO_Data* d, UNS8 nodeId, UNS32 * abortCode);
 
+#ifdef CO_ENABLE_SDO_DEFER
+/**
+ * @ingroup sdo
+ * @brief Send the deferred response of the SDO server for an entry.
+ * @details A callback of the entry returning OD_PENDING, or the pre_sdoUpload
+ * hook of the node, defers the response of the server. The line is kept
+ * until this function is called, with the stack mutex held, or until
+ * SDO_TIMEOUT_MS elapses and the client gets an SDOABT_TIMED_OUT abort.
+ * A pending upload reads the entry when it is completed.
+ * @param *d Pointer to a CAN object data structure
+ * @param index Index of the entry
+ * @param subIndex Subindex of the entry
+ * @param abortCode 0 to send the response, or the SDO abort code to send instead
+ * @return 0 if a pending transfer has been completed, 0xFF if none was found
+*/
+UNS8 completeSDOtransfer (CO_Data* d, UNS16 index, UNS8 subIndex, UNS32 abortCode);
+#endif
+
+#ifdef CO_ENABLE_SDO_BUDGET
+/**
+ * @ingroup sdo
+ * @brief Initialize the bus-load budget of the SDO frames of a CAN port.
+ * @details The SDO frames sent by the nodes of the budget, client and server,
+ * block segments included, each take SDO_FRAME_BITS tokens. The tokens are
+ * refilled at rate, a frame of them per tick, up to depth. A frame without
+ * tokens waits in the queue of the budget, and block segments wait in their
+ * line, so that the cyclic traffic keeps the rest of the bus. Must be called
+ * with the stack mutex held, while no node has the budget.
+ * @param *budget Budget of the port, provided by the application
+ * @param rate Bits per second given to the SDO frames, 1000 to 1000000
+ * @param depth Bits that can be sent at once after an idle time, at least SDO_FRAME_BITS
+ * @return 0 if OK, 0xFF if rate or depth is invalid
+ */
+UNS8 initSDObudget (s_sdo_budget* budget, UNS32 rate, UNS32 depth);
+
+/**
+ * @ingroup sdo
+ * @brief Meter the SDO frames sent by a node with a budget. The nodes
+ * opened on the same port share its budget, and must be processed by the
+ * same thread. Must be called with the stack mutex held.
+ * @param *d Pointer to a CAN object data structure
+ * @param *budget Budget of the port of the node, NULL to stop metering
+ */
+void setSDObudget (CO_Data* d, s_sdo_budget* budget);
+#endif
+
 #endif
@@ -0,0 +1,171 @@
+/*
+This file is part of CanFestival, a library implementing CanOpen Stack.
+
+Copyright (C): Edouard TISSERANT and Francis DUPIN
+
+See COPYING file for copyrights details.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/** @defgroup sdozip Compressed block transfers
+ * @brief Block SDO transfers between CanFestival nodes compressed on the
+ * fly. A node advertises the compression with the capability object
+ * SDO_ZIP_CAPABILITY_INDEX of its dictionary, which the client reads once
+ * with probeSDOzip(). The client then asks for a compressed transfer with
+ * the reserved bit SDO_ZIP_FLAG of the block initiate request, and the
+ * server confirms it in its initiate response: the segments then carry a
+ * compressed stream of the object, the size indicated being the one of the
+ * object. A server without compression answers without the bit, and the
+ * transfer goes on uncompressed. The stream is produced segment by segment
+ * from the data of the line, and decoded into the data of the line, so no
+ * other buffer is needed. A node compresses or decodes one transfer at a
+ * time, the others go uncompressed.
+ *  @ingroup userapi
+ */
+
+#ifndef __sdozip_h__
+#define __sdozip_h__
+
+#include <applicfg.h>
+
+typedef struct struct_s_sdo_zip s_sdo_zip;
+
+#include "data.h"
+
+/* Manufacturer object of the SDO capabilities of a CanFestival node, UNS32 */
+#ifndef SDO_ZIP_CAPABILITY_INDEX
+#define SDO_ZIP_CAPABILITY_INDEX 0x5FF0
+#endif
+#define SDO_ZIP_CAPABILITY_LZ 0x00000001
+
+/* Reserved bit of the block initiate request and response */
+#define SDO_ZIP_FLAG 0x08
+
+/* Smaller downloads are not worth it */
+#ifndef SDO_ZIP_MIN_SIZE
+#define SDO_ZIP_MIN_SIZE 64
+#endif
+
+/* Distance of the matches, at most 65536 */
+#ifndef SDO_ZIP_WINDOW
+#define SDO_ZIP_WINDOW 4096
+#endif
+
+/* Match finder, 2^SDO_ZIP_HASH_BITS entries */
+#ifndef SDO_ZIP_HASH_BITS
+#define SDO_ZIP_HASH_BITS 10
+#endif
+
+/* Stream : tokens of literals (0x00-0x7F, 1 to 128 bytes follow), of
+   matches (0x80-0xFE, 3 to 129 bytes, distance - 1 follows on 16 bits
+   little endian) and the end (0xFF). */
+#define SDO_ZIP_LITERAL_MAX 128
+#define SDO_ZIP_MATCH_MIN 3
+#define SDO_ZIP_MATCH_MAX 129
+#define SDO_ZIP_END 0xFF
+
+/* Use of the context */
+#define SDO_ZIP_FREE 0
+#define SDO_ZIP_REQUESTED 1   /* asked for, not confirmed yet */
+#define SDO_ZIP_ENCODE 2
+#define SDO_ZIP_DECODE 3
+
+/* Peer capability */
+#define SDO_ZIP_PEER_UNKNOWN 0xFF
+
+/** Compression context of a node. The structure is provided by the application. */
+struct struct_s_sdo_zip {
+  UNS8 mode;                           /* SDO_ZIP_... */
+  UNS8 line;                           /* line of the transfer */
+  UNS8 end;                            /* end token produced or received */
+  UNS32 size;                          /* bytes of the object */
+  UNS32 rawPos;                        /* encoder : start of the next token, decoder : bytes decoded */
+  /* Encoder */
+  UNS32 hashPos;                       /* next position to enter in hash */
+  UNS32 tokenRaw;                      /* object position of the token in buf */
+  UNS32 tokenWire;                     /* stream position of buf[0], decoder : bytes received */
+  UNS32 markRaw;                       /* token of the first segment of the block */
+  UNS32 markWire;
+  UNS8 buf[1 + SDO_ZIP_LITERAL_MAX];   /* current token */
+  UNS8 bufLen;
+  UNS8 bufPos;
+  UNS8 seg[7];                         /* segment not sent yet */
+  UNS8 segLen;
+  UNS8 segLast;                        /* it is the last one */
+  UNS32 segRaw;                        /* token of its first byte */
+  UNS32 segWire;
+  UNS32 hash[1 << SDO_ZIP_HASH_BITS];  /* last position + 1 of each hash, 0 if none */
+  /* Decoder */
+  UNS8 state;
+  UNS8 run;
+  UNS8 distLow;
+  /* Capability of the peers, by node-id */
+  UNS8 known[16];
+  UNS8 capable[16];
+  /* Metrics, read them with the stack mutex held */
+  UNS32 transfers;                     /* compressed transfers completed */
+  UNS32 rawBytes;                      /* object bytes of these transfers */
+  UNS32 wireBytes;                     /* stream bytes of these transfers */
+  UNS32 fallbacks;                     /* asked for and refused */
+};
+
+/**
+ * @ingroup sdozip
+ * @brief Initialize a compression context, no peer known.
+ * @param *zip Context provided by the application
+ */
+void initSDOzip(s_sdo_zip* zip);
+
+/**
+ * @ingroup sdozip
+ * @brief Give a node a compression context. The block transfers of its
+ * SDO server are compressed when the client asks for it, and the ones of
+ * its SDO clients when the peer has the capability. Must be called with
+ * the stack mutex held, with no block transfer on use.
+ * @param *d Pointer to a CAN object data structure
+ * @param *zip Context, NULL to stop compressing
+ */
+void setSDOzip(CO_Data* d, s_sdo_zip* zip);
+
+/**
+ * @ingroup sdozip
+ * @brief Read the capability object of a node, to know whether its block
+ * transfers can be compressed. The result is kept by the context.
+ * @param *d Pointer to a CAN object data structure
+ * @param nodeId Node Id of the slave
+ * @return 0 if the read is started, 0xFF otherwise
+ */
+UNS8 probeSDOzip(CO_Data* d, UNS8 nodeId);
+
+/**
+ * @ingroup sdozip
+ * @brief Capability of a node.
+ * @param *d Pointer to a CAN object data structure
+ * @param nodeId Node Id of the slave
+ * @return 1 if capable, 0 if not, SDO_ZIP_PEER_UNKNOWN if not probed yet
+ */
+UNS8 getSDOzipPeer(CO_Data* d, UNS8 nodeId);
+
+/* Stream coding, used by sdo.c */
+void startSDOzip(s_sdo_zip* zip, UNS8 line, UNS8 mode, UNS32 size);
+UNS8 zipSDOsegment(s_sdo_zip* zip, const UNS8* raw);
+void zipSDOsent(s_sdo_zip* zip);
+void zipSDOmark(s_sdo_zip* zip);
+void zipSDOrewind(s_sdo_zip* zip, const UNS8* raw, UNS32 wire);
+UNS32 zipSDOwire(s_sdo_zip* zip);
+UNS8 unzipSDO(s_sdo_zip* zip, UNS8* raw, const UNS8* data, UNS8 nbBytes);
+
+#endif /* __sdozip_h__ */
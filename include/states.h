@@ -108,6 +108,17 @@ void _stopped(CO_Data* d);
  */
 void canDispatch(CO_Data* d, Message *m);
 
+/** 
+ * @brief Called by driver/app with several pending messages
+ * The messages are dispatched by priority class: NMT, SYNC, EMCY, TIME,
+ * PDO, SDO and LSS, then heartbeat and node guarding. The messages of
+ * a COB-ID keep their order.
+ * @param *d Pointer on a CAN object data structure
+ * @param *m Pointer on the CAN messages, in arrival order
+ * @param count Number of messages
+ */
+void canDispatchBatch(CO_Data* d, Message *m, UNS16 count);
+
 /** 
  * @ingroup statemachine
  * @brief Returns the state of the node
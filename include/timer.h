@@ -47,10 +47,61 @@ struct struct_s_timer_entry {
 	UNS32 id; /* The callback func. */
 	TIMEVAL val;
 	TIMEVAL interval; /* Periodicity */
+	TIMEVAL slack; /* Max delay to trig it with other alarms */
 };
 
 typedef struct struct_s_timer_entry s_timer_entry;
 
+/* Counters of TimeDispatch calls, kept since the start */
+struct struct_s_timer_stats {
+	UNS32 wakeups; /* TimeDispatch calls */
+	UNS32 alarms; /* Alarms trigged */
+	UNS32 idle; /* Wake-ups without any alarm to trig */
+};
+
+typedef struct struct_s_timer_stats s_timer_stats;
+
+/* A timer table, with the state of its wake-up */
+struct struct_s_timer_context {
+	s_timer_entry timers[MAX_NB_TIMER];
+	TIMEVAL total_sleep_time; /* Time of the next wake-up, since the last one */
+	TIMER_HANDLE last_timer_raw; /* Highest row in use */
+	s_timer_stats stats;
+};
+
+typedef struct struct_s_timer_context s_timer_context;
+
+#define TIMER_CONTEXT_INITIALIZER {{{TIMER_FREE, NULL, NULL, 0, 0, 0, 0},}, TIMEVAL_MAX, -1, {0, 0, 0}}
+
+#ifdef CO_ENABLE_TIMER_CONTEXTS
+/**
+ * @ingroup timer
+ * @brief Timer table of the calling thread, given by the timers driver.
+ * 
+ * With CO_ENABLE_TIMER_CONTEXTS, SetAlarm, DelAlarm and TimeDispatch use
+ * the table returned by the driver instead of a single global one. Threads
+ * that run different nodes at the same time then each use their own table,
+ * with their own setTimer and getElapsedTime time base.
+ * @return The timer table to use
+ */
+s_timer_context* getTimerContext(void);
+
+/* Wake-up counters, read them with the mutex held */
+#define timer_stats (getTimerContext()->stats)
+#else
+extern s_timer_context timer_context;
+
+/* Wake-up counters, read them with the mutex held */
+#define timer_stats (timer_context.stats)
+#endif
+
+/* Slack of the alarms that tolerate it, TIMER_SLACK_PERCENT of their value */
+#ifdef TIMER_SLACK_PERCENT
+#define TIMER_SLACK(value) ((value) / 100 * TIMER_SLACK_PERCENT)
+#else
+#define TIMER_SLACK(value) 0
+#endif
+
 /* ---------  prototypes --------- */
 /*#define SetAlarm(d, id, callback, value, period) printf("%s, %d, SetAlarm(%s, %s, %s, %s, %s)\n",__FILE__, __LINE__, #d, #id, #callback, #value, #period); _SetAlarm(d, id, callback, value, period)*/
 /**
@@ -65,6 +116,23 @@ typedef struct struct_s_timer_entry s_timer_entry;
  */
 TIMER_HANDLE SetAlarm(CO_Data* d, UNS32 id, TimerCallback_t callback, TIMEVAL value, TIMEVAL period);
 
+/**
+ * @ingroup timer
+ * @brief Set an alarm that can be trigged later, together with other alarms.
+ * 
+ * The alarm is trigged at most slack after value, so that the alarms due
+ * within their slack are serviced by a single wake-up. A periodic alarm can
+ * also be trigged up to slack before its time, without drift of its period.
+ * @param *d Pointer to a CAN object data structure
+ * @param id The alarm Id
+ * @param callback A callback function
+ * @param value Call the callback function at current time + value
+ * @param period Call periodically the callback function
+ * @param slack Max delay, or advance for a periodic alarm
+ * @return handle The timer handle
+ */
+TIMER_HANDLE SetAlarmWithSlack(CO_Data* d, UNS32 id, TimerCallback_t callback, TIMEVAL value, TIMEVAL period, TIMEVAL slack);
+
 /**
  * @ingroup timer
  * @brief Delete an alarm before expiring.
@@ -81,4 +81,13 @@ void StopTimerLoop(TimerCallback_t Callback);
  */
 void CreateReceiveTask(CAN_PORT port, TASK_HANDLE* handle, void* ReceiveLoopPtr);
 
+#ifdef CO_ENABLE_CMD_QUEUE
+/**
+ * @ingroup timer
+ * @brief Run the posted commands as soon as possible. Called without the
+ * mutex, from any thread.
+ */
+void TimerKick(void);
+#endif
+
 #endif
@@ -50,6 +50,64 @@ LIB_HANDLE LoadCanDriver(const char* driver_name);
  */
 UNS8 canSend(CAN_PORT port, Message *m);
 
+#ifdef CO_ENABLE_RX_QUEUE
+/** Receive queue counters of a CAN port */
+typedef struct {
+	UNS32 received; /**< Frames read from the driver */
+	UNS32 dropped; /**< Frames lost because their queue was full */
+	UNS32 high_water; /**< Most frames waiting in a queue */
+	UNS32 max_latency_us; /**< Longest time from reception to dispatch */
+} s_rx_queue_stats;
+
+/**
+ * @ingroup can
+ * @brief Receive queue counters of a CAN port
+ * The receive thread of the port only queues the frames. They are
+ * dispatched by a single thread, NMT, SYNC, EMCY and error control frames
+ * first, then the PDOs, then the SDOs.
+ * @param port CanFestival file descriptor
+ * @param *stats Filled with the counters since the port was opened
+ */
+void canRxQueueStats(CAN_PORT port, s_rx_queue_stats *stats);
+#endif
+
+#ifdef CO_ENABLE_SHARED_HEARTBEAT
+/**
+ * @ingroup can
+ * @brief Send several CAN messages in one call to the driver
+ * Drivers without a batch entry point get the messages one by one.
+ * @param port CanFestival file descriptor
+ * @param *m The CAN messages to send, in order
+ * @param count Number of messages
+ * @return Number of messages sent, the first failure stops the batch
+ */
+UNS16 canSendBatch(CAN_PORT port, Message *m, UNS16 count);
+#endif
+
+#ifdef CO_ENABLE_TXTIME
+/**
+ * @ingroup can
+ * @brief Queue a CAN message to be sent at a given instant
+ * The message is handed to the driver ahead of time and released by the
+ * kernel (socketcan SO_TXTIME and ETF qdisc) at launchTime.
+ * @param port CanFestival file descriptor
+ * @param *m The CAN message to send
+ * @param launchTime Launch time in ns, on the canTxTime() clock
+ * @return
+ *       - 0 is returned upon success.
+ *       - CAN_TXTIME_UNSUPPORTED if the driver can't schedule the message. Nothing is sent.
+ *       - other value if the driver failed to send the message.
+ */
+UNS8 canSendAt(CAN_PORT port, Message *m, UNS64 launchTime);
+
+/**
+ * @ingroup can
+ * @brief Current time of the clock used for launch times (CLOCK_TAI)
+ * @return time in ns
+ */
+UNS64 canTxTime(void);
+#endif
+
 /**
  * @ingroup can
  * @brief Open a CANOpen device
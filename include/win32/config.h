@@ -30,6 +30,8 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #define SDO_MAX_LENGTH_TRANSFER 32
 #define SDO_MAX_SIMULTANEOUS_TRANSFERS 32
 #define SDO_BLOCK_SIZE 16
+/* SDO_BLOCK_BURST is not defined */
+#define SDO_BLOCK_PACING_US 1000
 #define NMT_MAX_NODE_ID 128
 #define SDO_TIMEOUT_MS 3000
 #define MAX_NB_TIMER 32
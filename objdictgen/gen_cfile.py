@@ -99,6 +99,75 @@ def ComputeValue(type, value):
     else:
         return "0x%X"%value, "\t/* %s */"%str(value)
 
+# Concise DCF compact encoding, decoded by get_next_DCF_data (DCF_COMPACT in dcf.h)
+DCF_COMPACT = 0x80000000
+
+def EncodeVarInt(value):
+    result = ""
+    while value > 0x7F:
+        result += chr(0x80 | (value & 0x7F))
+        value >>= 7
+    return result + chr(value)
+
+def CompactDCF(value):
+    """
+    Encode a concise DCF : number of entries ORed with DCF_COMPACT, then for
+    each entry the index difference with the previous entry (zigzag varint),
+    the subindex, the size (varint), and the value as a varint when it is
+    4 bytes or less, the raw data otherwise.
+    """
+    if value == "":
+        return value
+    nb_params = BE_to_LE(value[:4])
+    result = LE_to_BE(DCF_COMPACT | nb_params, 4)
+    data = value[4:]
+    previous = 0
+    i = 0
+    while i + 7 <= len(data):
+        index = BE_to_LE(data[i:i+2])
+        size = BE_to_LE(data[i+3:i+7])
+        delta = index - previous
+        if delta >= 0:
+            result += EncodeVarInt(delta << 1)
+        else:
+            result += EncodeVarInt(((-delta) << 1) - 1)
+        result += data[i+2] + EncodeVarInt(size)
+        if size == 0:
+            result += EncodeVarInt(0)
+        elif size <= 4:
+            result += EncodeVarInt(BE_to_LE(data[i+7:i+7+size]))
+        else:
+            result += data[i+7:i+7+size]
+        previous = index
+        i += 7 + size
+    return result
+
+def GetDCFValues(Node, compact_dcf = False):
+    values = Node.GetEntry(0x1F22)
+    if compact_dcf:
+        values = [values[0]] + [CompactDCF(value) for value in values[1:]]
+    return values
+
+def GetDCFReport(Node, compact_dcf = False):
+    """
+    Memory used by the concise DCF of the nodes (0x1F22), without and with
+    the sharing of identical configurations and the compact encoding.
+    """
+    if not Node.IsEntry(0x1F22):
+        return None
+    values = [value for value in Node.GetEntry(0x1F22)[1:] if value != ""]
+    if not values:
+        return None
+    # Generated as NUL terminated strings
+    before = sum([len(value) + 1 for value in values])
+    blobs = {}
+    for value in GetDCFValues(Node, compact_dcf)[1:]:
+        if value != "":
+            blobs[value] = True
+    after = sum([len(value) + 1 for value in blobs.keys()])
+    return "Concise DCF : %d node(s), %d distinct configuration(s), %d bytes instead of %d (%d%% saved)"%(
+        len(values), len(blobs), after, before, 100 * (before - after) / before)
+
 def WriteFile(filepath, content):
     cfile = open(filepath,"w")
     cfile.write(content)
@@ -110,7 +179,7 @@ def GetTypeName(Node, typenumber):
         raise ValueError, _("""!!! Datatype with value "0x%4.4X" isn't defined in CanFestival.""")%typenumber
     return typename
 
-def GenerateFileContent(Node, headerfilepath, pointers_dict = {}):
+def GenerateFileContent(Node, headerfilepath, pointers_dict = {}, compact_dcf = False):
     """
     pointers_dict = {(Idx,Sidx):"VariableName",...}
     """
@@ -190,7 +259,10 @@ def GenerateFileContent(Node, headerfilepath, pointers_dict = {}):
         strIndex = ""
         entry_infos = Node.GetEntryInfos(index)
         texts["EntryName"] = entry_infos["name"].encode('ascii','replace')
-        values = Node.GetEntry(index)
+        if index == 0x1F22:
+            values = GetDCFValues(Node, compact_dcf)
+        else:
+            values = Node.GetEntry(index)
         callbacks = Node.HasEntryCallbacks(index)
         if index in variablelist:
             strIndex += "\n/* index 0x%(index)04X :   Mapped variable %(EntryName)s */\n"%texts
@@ -257,6 +329,25 @@ def GenerateFileContent(Node, headerfilepath, pointers_dict = {}):
                                 raise ValueError("\nDomain variable not initialized\nindex : 0x%04X\nsubindex : 0x%02X"%(index, subIndex))
                             mappedVariableContent += "    %s%s%s\n"%(value, sep, comment)
                     mappedVariableContent += "  };\n"
+                elif index == 0x1F22:
+                    # Nodes with the same configuration share one concise DCF
+                    blobs = {}
+                    for value in values[1:]:
+                        if value != "" and value not in blobs:
+                            blobs[value] = "%s_obj%04X_DCF%d"%(texts["NodeName"], index, len(blobs))
+                            strIndex += "                    static const UNS8 %s[] = %s;\n"%(blobs[value], ComputeValue(typeinfos[2], value)[0])
+                    strIndex += "                    %(subIndexType)s%(type_suffixe)s %(NodeName)s_obj%(index)04X[] = \n                    {\n"%texts
+                    for subIndex, value in enumerate(values):
+                        sep = ","
+                        if subIndex > 0:
+                            if subIndex == len(values)-1:
+                                sep = ""
+                            if value in blobs:
+                                value = "(UNS8*)%s"%blobs[value]
+                            else:
+                                value = ComputeValue(typeinfos[2], value)[0]
+                            strIndex += "                      %s%s\n"%(value, sep)
+                    strIndex += "                    };\n"
                 else:
                     strIndex += "                    %(subIndexType)s%(type_suffixe)s %(NodeName)s_obj%(index)04X[] = \n                    {\n"%texts
                     for subIndex, value in enumerate(values):
@@ -593,10 +684,10 @@ extern CO_Data %(NodeName)s_Data;
 #                             Main Function
 #-------------------------------------------------------------------------------
 
-def GenerateFile(filepath, node, pointers_dict = {}):
+def GenerateFile(filepath, node, pointers_dict = {}, compact_dcf = False):
     try:
         headerfilepath = os.path.splitext(filepath)[0]+".h"
-        content, header = GenerateFileContent(node, os.path.split(headerfilepath)[1], pointers_dict)
+        content, header = GenerateFileContent(node, os.path.split(headerfilepath)[1], pointers_dict, compact_dcf)
         WriteFile(filepath, content)
         WriteFile(headerfilepath, header)
         return None
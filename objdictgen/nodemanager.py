@@ -351,9 +351,9 @@ class NodeManager:
     """
     Build the C definition of Object Dictionary for current node 
     """
-    def ExportCurrentToCFile(self, filepath):
+    def ExportCurrentToCFile(self, filepath, compact_dcf = False):
         if self.CurrentNode:
-            return gen_cfile.GenerateFile(filepath, self.CurrentNode)
+            return gen_cfile.GenerateFile(filepath, self.CurrentNode, compact_dcf = compact_dcf)
 
 #-------------------------------------------------------------------------------
 #                        Add Entries to Current Functions
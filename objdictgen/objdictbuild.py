@@ -0,0 +1,311 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+#This file is part of CanFestival, a library implementing CanOpen Stack.
+#
+#Copyright (C): Edouard TISSERANT, Francis DUPIN and Laurent BESSARD
+#
+#See COPYING file for copyrights details.
+#
+#This library is free software; you can redistribute it and/or
+#modify it under the terms of the GNU Lesser General Public
+#License as published by the Free Software Foundation; either
+#version 2.1 of the License, or (at your option) any later version.
+#
+#This library is distributed in the hope that it will be useful,
+#but WITHOUT ANY WARRANTY; without even the implied warranty of
+#MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+#Lesser General Public License for more details.
+#
+#You should have received a copy of the GNU Lesser General Public
+#License along with this library; if not, write to the Free Software
+#Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+"""
+Headless object dictionary compiler for large projects.
+
+Compiles many .od, .eds and network project (nodelist.cpj) inputs in
+parallel worker processes. Parsed models are cached by content hash, and
+outputs whose inputs and generator did not change are not regenerated.
+"""
+
+import getopt, sys, os, time
+import cPickle, hashlib, multiprocessing
+import __builtin__
+
+if "_" not in __builtin__.__dict__:
+    __builtin__.__dict__["_"] = lambda x: x
+
+from nodemanager import *
+import eds_utils, gen_cfile
+
+# Change it when the cached models or the generated files change format
+CACHE_VERSION = "1"
+
+# Sources of the generator: a change invalidates the cache and the outputs
+GENERATOR_FILES = ["node.py", "eds_utils.py", "gen_cfile.py", "nodemanager.py", "objdictbuild.py"]
+
+def usage():
+    print _("\nUsage of objdictbuild.py :")
+    print "\n   %s [options] Input [Input...]\n"%sys.argv[0]
+    print _("Input is a .od or .eds file, a nodelist.cpj file or a network project folder\n")
+    print _("   -o, --output=DIR   Folder of the generated files (default: next to the input)")
+    print _("   -c, --cache=DIR    Cache folder (default: .objdictgen_cache)")
+    print _("   -j, --jobs=N       Number of worker processes (default: number of CPUs)")
+    print _("   -f, --force        Regenerate even if the inputs did not change")
+    print _("   --compact-dcf      Encode the concise DCF (0x1F22) in compact form")
+    print _("   -q, --quiet        Only print errors")
+    print _("   -h, --help         This help\n")
+
+def FileHash(filepath):
+    return hashlib.sha1(open(filepath, "rb").read()).hexdigest()
+
+def GeneratorHash():
+    folder = os.path.split(os.path.abspath(__file__))[0]
+    sha = hashlib.sha1(CACHE_VERSION)
+    for name in GENERATOR_FILES:
+        sha.update(open(os.path.join(folder, name), "rb").read())
+    return sha.hexdigest()
+
+def WriteAtomic(filepath, content):
+    # Workers may write the same cache entry concurrently
+    tmppath = "%s.%d"%(filepath, os.getpid())
+    file = open(tmppath, "wb")
+    file.write(content)
+    file.close()
+    os.rename(tmppath, filepath)
+
+class BuildCache:
+    """
+    Content addressed cache of the parsed models, and stamps of the generated
+    files. Safe to share between processes: entries are written atomically.
+    """
+    def __init__(self, folder, generator):
+        self.Folder = folder
+        self.Generator = generator
+        for subfolder in ["models", "stamps"]:
+            path = os.path.join(folder, subfolder)
+            if not os.path.isdir(path):
+                try:
+                    os.makedirs(path)
+                except OSError:
+                    pass
+        self.Hits = 0
+        self.Misses = 0
+
+    def GetKey(self, filepath):
+        return hashlib.sha1(self.Generator + FileHash(filepath)).hexdigest()
+
+    def HasModel(self, filepath):
+        return os.path.isfile(os.path.join(self.Folder, "models", self.GetKey(filepath)))
+
+    def LoadModel(self, filepath, parser):
+        key = self.GetKey(filepath)
+        modelpath = os.path.join(self.Folder, "models", key)
+        if os.path.isfile(modelpath):
+            try:
+                node = cPickle.loads(open(modelpath, "rb").read())
+                self.Hits += 1
+                return node
+            except:
+                pass
+        self.Misses += 1
+        node = parser(filepath)
+        if isinstance(node, Node):
+            WriteAtomic(modelpath, cPickle.dumps(node, cPickle.HIGHEST_PROTOCOL))
+        return node
+
+    def GetStampPath(self, outputpath):
+        return os.path.join(self.Folder, "stamps", hashlib.sha1(os.path.abspath(outputpath)).hexdigest())
+
+    def IsUpToDate(self, outputpath, key):
+        stamppath = self.GetStampPath(outputpath)
+        headerpath = os.path.splitext(outputpath)[0] + ".h"
+        return os.path.isfile(outputpath) and os.path.isfile(headerpath) and \
+            os.path.isfile(stamppath) and open(stamppath, "rb").read() == key
+
+    def SetUpToDate(self, outputpath, key):
+        WriteAtomic(self.GetStampPath(outputpath), key)
+
+def ParseODFile(filepath):
+    try:
+        file = open(filepath, "r")
+        node = load(file)
+        file.close()
+        # As objdictgen does
+        node.SetNodeID(0)
+        return node
+    except:
+        return _("Unable to load file \"%s\"!")%filepath
+
+def ParseEDSFile(filepath):
+    return eds_utils.GenerateNode(filepath)
+
+PARSERS = {".od" : ParseODFile, ".eds" : ParseEDSFile}
+
+def RunTask(task):
+    """
+    Task run by a worker: (input, output or None, cache folder, generator, force, compact dcf)
+    Returns (input, result, message, cache hits, seconds).
+    """
+    inputpath, outputpath, cachefolder, generator, force, compact_dcf = task
+    start = time.time()
+    cache = BuildCache(cachefolder, generator)
+    try:
+        parser = PARSERS[os.path.splitext(inputpath)[1].lower()]
+        if outputpath is None:
+            # Only checked, already done if the model is in the cache
+            if not force and cache.HasModel(inputpath):
+                return inputpath, "skipped", None, 0, time.time() - start
+        else:
+            key = cache.GetKey(inputpath)
+            if compact_dcf:
+                key += ":compact-dcf"
+            if not force and cache.IsUpToDate(outputpath, key):
+                return inputpath, "skipped", None, 0, time.time() - start
+        node = cache.LoadModel(inputpath, parser)
+        if not isinstance(node, Node):
+            return inputpath, "error", node, cache.Hits, time.time() - start
+        if outputpath is None:
+            return inputpath, "parsed", None, cache.Hits, time.time() - start
+        result = gen_cfile.GenerateFile(outputpath, node, compact_dcf = compact_dcf)
+        if result is not None:
+            return inputpath, "error", result, cache.Hits, time.time() - start
+        cache.SetUpToDate(outputpath, key)
+        return inputpath, "generated", gen_cfile.GetDCFReport(node, compact_dcf), cache.Hits, time.time() - start
+    except Exception, message:
+        return inputpath, "error", str(message), cache.Hits, time.time() - start
+
+def GetOutputPath(inputpath, outputfolder, name = None):
+    if name is None:
+        name = os.path.splitext(os.path.basename(inputpath))[0]
+    if outputfolder is None:
+        outputfolder = os.path.split(inputpath)[0]
+    return os.path.join(outputfolder, name + ".c")
+
+def ExpandProject(root, outputfolder):
+    """
+    A network project is its master node(s), and the EDS files of its
+    slaves which are only parsed and checked against the node list.
+    Returns the list of (input, output) and the list of errors.
+    """
+    tasks = []
+    errors = []
+    projectname = os.path.basename(os.path.normpath(root))
+    eds_folder = os.path.join(root, "eds")
+    eds_files = []
+    if os.path.isdir(eds_folder):
+        eds_files = [file for file in os.listdir(eds_folder) if os.path.splitext(file)[1] == ".eds"]
+    for file in eds_files:
+        tasks.append((os.path.join(eds_folder, file), None))
+    cpjpath = os.path.join(root, "nodelist.cpj")
+    networks = []
+    if os.path.isfile(cpjpath):
+        try:
+            networks = eds_utils.ParseCPJFile(cpjpath)
+        except SyntaxError, message:
+            errors.append((cpjpath, _("Unable to load CPJ file\n%s")%message))
+    for network in networks:
+        for nodeid, node in network["Nodes"].items():
+            if node["Present"] == 1 and node["DCFName"] not in eds_files:
+                errors.append((cpjpath, _("\"%s\" EDS file is not available")%node["DCFName"]))
+    masters = [(name, os.path.join(root, "%s_master.od"%name)) for name in [network["Name"] for network in networks] if name]
+    masters = [(name, path) for name, path in masters if os.path.isfile(path)]
+    if not masters and os.path.isfile(os.path.join(root, "master.od")):
+        masters = [(projectname, os.path.join(root, "master.od"))]
+    for name, path in masters:
+        tasks.append((path, GetOutputPath(path, outputfolder, "%s_master"%name)))
+    return tasks, errors
+
+def ExpandInputs(inputs, outputfolder):
+    tasks = []
+    errors = []
+    for inputpath in inputs:
+        if os.path.isdir(inputpath):
+            projecttasks, projecterrors = ExpandProject(inputpath, outputfolder)
+            tasks.extend(projecttasks)
+            errors.extend(projecterrors)
+        elif os.path.basename(inputpath).lower().endswith(".cpj"):
+            projecttasks, projecterrors = ExpandProject(os.path.split(os.path.abspath(inputpath))[0], outputfolder)
+            tasks.extend(projecttasks)
+            errors.extend(projecterrors)
+        elif os.path.splitext(inputpath)[1].lower() in PARSERS and os.path.isfile(inputpath):
+            tasks.append((inputpath, GetOutputPath(inputpath, outputfolder)))
+        else:
+            errors.append((inputpath, _("%s is not a valid file!")%inputpath))
+    # The same EDS may be shared by several projects
+    unique = []
+    seen = {}
+    for task in tasks:
+        if task not in seen:
+            seen[task] = True
+            unique.append(task)
+    return unique, errors
+
+if __name__ == '__main__':
+    try:
+        opts, args = getopt.gnu_getopt(sys.argv[1:], "ho:c:j:fq", ["help", "output=", "cache=", "jobs=", "force", "quiet", "compact-dcf"])
+    except getopt.GetoptError:
+        usage()
+        sys.exit(2)
+
+    outputfolder = None
+    cachefolder = ".objdictgen_cache"
+    jobs = multiprocessing.cpu_count()
+    force = False
+    quiet = False
+    compact_dcf = False
+    for o, a in opts:
+        if o in ("-h", "--help"):
+            usage()
+            sys.exit()
+        elif o in ("-o", "--output"):
+            outputfolder = a
+        elif o in ("-c", "--cache"):
+            cachefolder = a
+        elif o in ("-j", "--jobs"):
+            jobs = max(1, int(a))
+        elif o in ("-f", "--force"):
+            force = True
+        elif o in ("-q", "--quiet"):
+            quiet = True
+        elif o == "--compact-dcf":
+            compact_dcf = True
+    if len(args) == 0:
+        usage()
+        sys.exit(2)
+    if outputfolder is not None and not os.path.isdir(outputfolder):
+        os.makedirs(outputfolder)
+
+    start = time.time()
+    generator = GeneratorHash()
+    BuildCache(cachefolder, generator)
+    tasks, errors = ExpandInputs(args, outputfolder)
+    tasks = [(inputpath, outputpath, cachefolder, generator, force, compact_dcf) for inputpath, outputpath in tasks]
+
+    if jobs > 1 and len(tasks) > 1:
+        pool = multiprocessing.Pool(min(jobs, len(tasks)))
+        results = pool.map(RunTask, tasks, 1)
+        pool.close()
+        pool.join()
+    else:
+        results = map(RunTask, tasks)
+
+    counts = {"generated" : 0, "skipped" : 0, "parsed" : 0, "error" : 0}
+    hits = 0
+    for inputpath, result, message, taskhits, seconds in results:
+        counts[result] += 1
+        hits += taskhits
+        if result == "error":
+            errors.append((inputpath, message))
+        elif not quiet and result == "generated":
+            print _("%s : generated in %.2fs")%(inputpath, seconds)
+            if message is not None:
+                print "  %s"%message
+    for inputpath, message in errors:
+        print >> sys.stderr, "%s : %s"%(inputpath, message)
+    if not quiet:
+        print _("%d generated, %d up to date, %d parsed only, %d models from cache, %d error(s) in %.2fs")%(
+            counts["generated"], counts["skipped"], counts["parsed"], hits, len(errors), time.time() - start)
+    if errors:
+        sys.exit(1)
@@ -30,19 +30,23 @@ _ = lambda x: x
 
 def usage():
     print _("\nUsage of objdictgen.py :")
-    print "\n   %s XMLFilePath CFilePath\n"%sys.argv[0]
+    print "\n   %s [--compact-dcf] XMLFilePath CFilePath\n"%sys.argv[0]
+    print _("   --compact-dcf  Encode the concise DCF (0x1F22) in compact form\n")
 
 try:
-    opts, args = getopt.getopt(sys.argv[1:], "h", ["help"])
+    opts, args = getopt.getopt(sys.argv[1:], "h", ["help", "compact-dcf"])
 except getopt.GetoptError:
     # print help information and exit:
     usage()
     sys.exit(2)
 
+compact_dcf = False
 for o, a in opts:
     if o in ("-h", "--help"):
         usage()
         sys.exit()
+    elif o == "--compact-dcf":
+        compact_dcf = True
 
 fileIn = ""
 fileOut = ""        
@@ -68,9 +72,12 @@ if __name__ == '__main__':
             print _("%s is not a valid file!")%fileIn
             sys.exit(-1)
         print _("Writing output file")
-        result = manager.ExportCurrentToCFile(fileOut)
+        result = manager.ExportCurrentToCFile(fileOut, compact_dcf)
         if isinstance(result, (UnicodeType, StringType)):
             print result
             sys.exit(-1)
+        report = gen_cfile.GetDCFReport(manager.CurrentNode, compact_dcf)
+        if report is not None:
+            print report
         print _("All done")
     
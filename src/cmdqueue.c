@@ -0,0 +1,437 @@
+/*
+This file is part of CanFestival, a library implementing CanOpen Stack.
+
+Copyright (C): Edouard TISSERANT and Francis DUPIN
+
+See COPYING file for copyrights details.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+USA
+*/
+
+/*!
+** @file   cmdqueue.c
+** @author Edouard TISSERANT and Francis DUPIN
+**
+** @brief Command submission queue
+**
+** Bounded multiple producers / single consumer queue. Each cell holds a
+** sequence number: a producer claims the cell of the enqueue position whose
+** sequence equals it, with a compare and swap on the position, fills it and
+** publishes it by setting the sequence to position + 1. The stack is the
+** single consumer: it always runs the commands with the stack mutex held,
+** and gives the cell back to the producers with position + queue size.
+*/
+
+#include <string.h>
+
+#include "data.h"
+#include "timers_driver.h"
+#include "cmdqueue.h"
+
+#ifdef CO_ENABLE_CMD_QUEUE
+
+#define CMD_LOAD_RELAXED(v)     __atomic_load_n(&(v), __ATOMIC_RELAXED)
+#define CMD_LOAD_ACQUIRE(v)     __atomic_load_n(&(v), __ATOMIC_ACQUIRE)
+#define CMD_STORE_RELEASE(v, x) __atomic_store_n(&(v), (x), __ATOMIC_RELEASE)
+#define CMD_CLAIM(v, pos)       __atomic_compare_exchange_n(&(v), &(pos), (pos) + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)
+#define CMD_EXCHANGE(v, x)      __atomic_exchange_n(&(v), (x), __ATOMIC_SEQ_CST)
+#define CMD_INCREMENT(v)        __atomic_fetch_add(&(v), 1, __ATOMIC_RELAXED)
+
+/* Queues of all the nodes, run by the timer passes */
+static s_cmd_queue* queues = NULL;
+
+/*!
+**
+**
+** @param d
+** @param q
+** @param cells
+** @param size
+**
+** @return
+**/
+UNS8 initCommandQueue(CO_Data* d, s_cmd_queue* q, s_co_command* cells, UNS32 size)
+{
+  UNS32 i;
+
+  if(!size || (size & (size - 1))){
+    MSG_ERR(0x1F01, "Command queue size must be a power of 2 : ", size);
+    return 0xFF;
+  }
+  stopCommandQueue(d);
+  for(i = 0; i < size; i++)
+    cells[i].sequence = i;
+  q->d = d;
+  q->cells = cells;
+  q->mask = size - 1;
+  q->enqueue = 0;
+  q->dequeue = 0;
+  q->kicked = 0;
+  q->posted = 0;
+  q->rejected = 0;
+  q->failed = 0;
+  q->next = queues;
+  queues = q;
+  d->cmdQueue = q;
+  return 0;
+}
+
+/*!
+**
+**
+** @param d
+**/
+void stopCommandQueue(CO_Data* d)
+{
+  s_cmd_queue** q;
+
+  if(!d->cmdQueue)
+    return;
+  for(q = &queues; *q; q = &(*q)->next)
+    if(*q == d->cmdQueue){
+      *q = d->cmdQueue->next;
+      break;
+    }
+  d->cmdQueue = NULL;
+}
+
+/*!
+** Copy a command in a free cell of the queue of the node, and publish it.
+**
+** @param d
+** @param c
+**
+** @return 0 if posted, 0xFF if the queue is full or not enabled
+**/
+static UNS8 postToQueue(CO_Data* d, const s_co_command* c)
+{
+  s_cmd_queue* q = d->cmdQueue;
+  s_co_command* cell;
+  UNS32 pos;
+  UNS32 sequence;
+
+  if(!q)
+    return 0xFF;
+
+  pos = CMD_LOAD_RELAXED(q->enqueue);
+  for(;;){
+    cell = &q->cells[pos & q->mask];
+    sequence = CMD_LOAD_ACQUIRE(cell->sequence);
+    if(sequence == pos){
+      /* pos is reloaded if another producer claimed it first */
+      if(CMD_CLAIM(q->enqueue, pos))
+        break;
+    }
+    else if((INTEGER32)(sequence - pos) < 0){
+      /* The cell of this turn is not run yet */
+      CMD_INCREMENT(q->rejected);
+      MSG_WAR(0x2F02, "Command queue full, command dropped : ", c->type);
+      return 0xFF;
+    }
+    else
+      pos = CMD_LOAD_RELAXED(q->enqueue);
+  }
+
+  /* The cell is ours until the sequence is published */
+  cell->type = c->type;
+  cell->nodeId = c->nodeId;
+  cell->value = c->value;
+  cell->subIndex = c->subIndex;
+  cell->index = c->index;
+  cell->addInfo = c->addInfo;
+  cell->count = c->count;
+  cell->useBlockMode = c->useBlockMode;
+  cell->callback = c->callback;
+  cell->function = c->function;
+  cell->data = c->data;
+  memcpy(cell->buffer, c->buffer, CO_COMMAND_DATA_SIZE);
+  CMD_STORE_RELEASE(cell->sequence, pos + 1);
+  CMD_INCREMENT(q->posted);
+
+  /* Only the first command posted since the last run kicks the driver */
+  if(!CMD_EXCHANGE(q->kicked, 1))
+    TimerKick();
+  return 0;
+}
+
+/*!
+**
+**
+** @param d
+** @param nodeId
+** @param cs
+**
+** @return
+**/
+UNS8 postNMTStateChange(CO_Data* d, UNS8 nodeId, UNS8 cs)
+{
+  s_co_command c;
+
+  memset(&c, 0, sizeof(c));
+  c.type = CO_CMD_NMT;
+  c.nodeId = nodeId;
+  c.value = cs;
+  return postToQueue(d, &c);
+}
+
+/*!
+**
+**
+** @param d
+** @param newState
+**
+** @return
+**/
+UNS8 postSetState(CO_Data* d, e_nodeState newState)
+{
+  s_co_command c;
+
+  memset(&c, 0, sizeof(c));
+  c.type = CO_CMD_STATE;
+  c.value = (UNS8)newState;
+  return postToQueue(d, &c);
+}
+
+/*!
+**
+**
+** @param d
+**
+** @return
+**/
+UNS8 postPDOEvent(CO_Data* d)
+{
+  s_co_command c;
+
+  memset(&c, 0, sizeof(c));
+  c.type = CO_CMD_PDO_EVENT;
+  return postToQueue(d, &c);
+}
+
+/*!
+**
+**
+** @param d
+** @param errCode
+** @param errRegMask
+** @param addInfo
+**
+** @return
+**/
+UNS8 postEMCYError(CO_Data* d, UNS16 errCode, UNS8 errRegMask, UNS16 addInfo)
+{
+  s_co_command c;
+
+  memset(&c, 0, sizeof(c));
+  c.type = CO_CMD_EMCY_ERROR;
+  c.index = errCode;
+  c.value = errRegMask;
+  c.addInfo = addInfo;
+  return postToQueue(d, &c);
+}
+
+/*!
+**
+**
+** @param d
+** @param errCode
+**
+** @return
+**/
+UNS8 postEMCYRecovered(CO_Data* d, UNS16 errCode)
+{
+  s_co_command c;
+
+  memset(&c, 0, sizeof(c));
+  c.type = CO_CMD_EMCY_RECOVER;
+  c.index = errCode;
+  return postToQueue(d, &c);
+}
+
+/*!
+**
+**
+** @param d
+** @param nodeId
+** @param index
+** @param subIndex
+** @param count
+** @param dataType
+** @param data
+** @param Callback
+** @param useBlockMode
+**
+** @return
+**/
+UNS8 postWriteNetworkDict(CO_Data* d, UNS8 nodeId, UNS16 index, UNS8 subIndex,
+		UNS32 count, UNS8 dataType, void* data, SDOCallback_t Callback, UNS8 useBlockMode)
+{
+  s_co_command c;
+
+  memset(&c, 0, sizeof(c));
+  c.type = CO_CMD_SDO_WRITE;
+  c.nodeId = nodeId;
+  c.index = index;
+  c.subIndex = subIndex;
+  c.count = count;
+  c.value = dataType;
+  c.callback = Callback;
+  c.useBlockMode = useBlockMode;
+  if(count <= CO_COMMAND_DATA_SIZE)
+    memcpy(c.buffer, data, count);
+  else
+    c.data = data;
+  return postToQueue(d, &c);
+}
+
+/*!
+**
+**
+** @param d
+** @param nodeId
+** @param index
+** @param subIndex
+** @param dataType
+** @param Callback
+** @param useBlockMode
+**
+** @return
+**/
+UNS8 postReadNetworkDict(CO_Data* d, UNS8 nodeId, UNS16 index, UNS8 subIndex,
+		UNS8 dataType, SDOCallback_t Callback, UNS8 useBlockMode)
+{
+  s_co_command c;
+
+  memset(&c, 0, sizeof(c));
+  c.type = CO_CMD_SDO_READ;
+  c.nodeId = nodeId;
+  c.index = index;
+  c.subIndex = subIndex;
+  c.value = dataType;
+  c.callback = Callback;
+  c.useBlockMode = useBlockMode;
+  return postToQueue(d, &c);
+}
+
+/*!
+**
+**
+** @param d
+** @param function
+** @param context
+**
+** @return
+**/
+UNS8 postCommand(CO_Data* d, CommandFunction_t function, void* context)
+{
+  s_co_command c;
+
+  memset(&c, 0, sizeof(c));
+  c.type = CO_CMD_CALL;
+  c.function = function;
+  c.data = context;
+  return postToQueue(d, &c);
+}
+
+/*!
+** Run a command with the stack mutex held.
+**
+** @param d
+** @param c
+**
+** @return 0 if OK, an error otherwise
+**/
+static UNS8 runCommand(CO_Data* d, s_co_command* c)
+{
+  switch(c->type){
+    case CO_CMD_NMT:
+      return masterSendNMTstateChange(d, c->nodeId, c->value);
+    case CO_CMD_STATE:
+      return setState(d, (e_nodeState)c->value) != c->value;
+    case CO_CMD_PDO_EVENT:
+      return sendAsyncPDOevent(d);
+    case CO_CMD_EMCY_ERROR:
+      return EMCY_setError(d, c->index, c->value, c->addInfo);
+    case CO_CMD_EMCY_RECOVER:
+      EMCY_errorRecovered(d, c->index);
+      return 0;
+    case CO_CMD_SDO_WRITE:
+      return writeNetworkDictCallBack(d, c->nodeId, c->index, c->subIndex, c->count, c->value,
+          c->count <= CO_COMMAND_DATA_SIZE ? (void*)c->buffer : c->data, c->callback, c->useBlockMode);
+    case CO_CMD_SDO_READ:
+      return readNetworkDictCallback(d, c->nodeId, c->index, c->subIndex, c->value,
+          c->callback, c->useBlockMode);
+    case CO_CMD_CALL:
+      (*c->function)(d, c->data);
+      return 0;
+  }
+  return 0xFF;
+}
+
+/*!
+** Run the commands posted to the node, at most one turn of its queue so
+** that busy producers cannot hold the stack.
+**
+** @param d
+**/
+void _runCommands(CO_Data* d)
+{
+  s_cmd_queue* q = d->cmdQueue;
+  s_co_command* cell;
+  s_co_command c;
+  UNS32 n;
+
+  if(!q)
+    return;
+
+  /* The commands posted from now on kick the driver again */
+  CMD_EXCHANGE(q->kicked, 0);
+  for(n = 0; n <= q->mask; n++){
+    cell = &q->cells[q->dequeue & q->mask];
+    if(CMD_LOAD_ACQUIRE(cell->sequence) != q->dequeue + 1)
+      break;
+    c = *cell;
+    /* Give the cell back before running, the command may post */
+    CMD_STORE_RELEASE(cell->sequence, q->dequeue + q->mask + 1);
+    q->dequeue++;
+    if(runCommand(d, &c)){
+      q->failed++;
+      MSG_ERR(0x1F03, "Posted command failed : ", c.type);
+    }
+  }
+#ifdef CO_ENABLE_EMCY_RING
+  /* Errors posted by the application threads */
+  if(d->emcyDrain)
+    _drainEMCYRings(d);
+#endif
+}
+
+/*!
+** Run the commands posted to all the nodes.
+**/
+void _runCommandQueues(void)
+{
+  s_cmd_queue* q;
+  s_cmd_queue* next;
+
+  for(q = queues; q; q = next){
+    /* A command may stop the queue of its node */
+    next = q->next;
+    _runCommands(q->d);
+  }
+}
+
+#endif /* CO_ENABLE_CMD_QUEUE */
@@ -0,0 +1,620 @@
+/*
+This file is part of CanFestival, a library implementing CanOpen Stack.
+
+Copyright (C): Edouard TISSERANT and Francis DUPIN
+
+See COPYING file for copyrights details.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+USA
+*/
+
+/*!
+** @file   confbackup.c
+** @author Edouard TISSERANT and Francis DUPIN
+**
+** @brief Configuration backup and restore
+**
+** Each node being transferred holds an SDO client entry of the master, and
+** its objects are transferred one after the other, the next one being
+** started from the callback of the previous one. The DCF engine of dcf.c
+** holds a single cursor in CO_Data, so the restore walks the concise DCF of
+** each node itself, with the same entry format.
+*/
+
+#include <string.h>
+#include "data.h"
+#include "sdo.h"
+#include "objacces.h"
+#include "confbackup.h"
+
+#ifdef CO_ENABLE_CONF_BACKUP
+
+/* Internal, sdo.c */
+UNS8 GetSDOClientFromNodeId(CO_Data* d, UNS8 nodeId);
+
+static s_conf_backup* confBackups = NULL;
+
+/* Objects with side effects when written, never saved */
+static const UNS16 confBackupSkipped[][2] = {
+  {0x1003, 0x1003},                    /* Pre-defined error field */
+  {0x1010, 0x1011},                    /* Store and restore parameters */
+  {0x1F50, 0x1F57},                    /* Program download */
+};
+
+static void confBackupStart(s_conf_backup* cb);
+static void confBackupNext(s_conf_backup* cb, s_conf_line* line);
+
+static UNS32 confBackupGet(const UNS8* p)
+{
+  return (UNS32)p[0] | (UNS32)p[1] << 8 | (UNS32)p[2] << 16 | (UNS32)p[3] << 24;
+}
+
+static void confBackupPut(UNS8* p, UNS32 v)
+{
+  p[0] = (UNS8)v;
+  p[1] = (UNS8)(v >> 8);
+  p[2] = (UNS8)(v >> 16);
+  p[3] = (UNS8)(v >> 24);
+}
+
+/*!
+**
+**
+** @param index
+**
+** @return 1 if a PDO mapping parameter
+**/
+static UNS8 isPDOMapping(UNS16 index)
+{
+  return (index >= 0x1600 && index <= 0x17FF) || (index >= 0x1A00 && index <= 0x1BFF);
+}
+
+/*!
+**
+**
+** @param objects
+** @param count
+** @param max
+** @param index
+** @param subIndex
+** @param flags
+** @param size
+**
+** @return 0 if the list is full
+**/
+static UNS8 confBackupAddObject(s_conf_object* objects, UNS16* count, UNS16 max,
+		UNS16 index, UNS8 subIndex, UNS8 flags, UNS32 size)
+{
+  if(*count >= max)
+    return 0;
+  objects[*count].index = index;
+  objects[*count].subIndex = subIndex;
+  objects[*count].flags = flags | (size >= CONF_BACKUP_BLOCK_MIN ? CONF_OBJECT_BLOCK : 0);
+  objects[*count].size = size;
+  (*count)++;
+  return 1;
+}
+
+/*!
+**
+**
+** @param model
+** @param objects
+** @param max
+**
+** @return
+**/
+UNS16 confBackupObjects(CO_Data* model, s_conf_object* objects, UNS16 max)
+{
+  const indextable* od;
+  const subindex* s;
+  UNS16 i, count = 0;
+  UNS8 j, k, first, mapping;
+
+  for(i = 0; i < *model->ObjdictSize; i++){
+    od = &model->objdict[i];
+    for(k = 0; k < sizeof(confBackupSkipped) / sizeof(confBackupSkipped[0]); k++)
+      if(od->index >= confBackupSkipped[k][0] && od->index <= confBackupSkipped[k][1])
+        break;
+    if(k < sizeof(confBackupSkipped) / sizeof(confBackupSkipped[0]))
+      continue;
+    /* Mapping cleared, entries, then number of entries */
+    mapping = isPDOMapping(od->index) && od->bSubCount > 1 && (od->pSubindex[0].bAccessType & (WO | RO)) == RW;
+    if(mapping && !confBackupAddObject(objects, &count, max, od->index, 0, CONF_OBJECT_CLEAR, 1))
+      goto full;
+    first = mapping ? 1 : 0;
+    for(j = first; j < od->bSubCount; j++){
+      s = &od->pSubindex[j];
+      if((s->bAccessType & (WO | RO)) != RW || !s->size)
+        continue;
+      if(!confBackupAddObject(objects, &count, max, od->index, j, 0, s->size))
+        goto full;
+    }
+    if(mapping && !confBackupAddObject(objects, &count, max, od->index, 0, 0, od->pSubindex[0].size))
+      goto full;
+  }
+  return count;
+full:
+  MSG_ERR(0x1F60, "Too many objects to save, list size : ", max);
+  return 0;
+}
+
+/*!
+**
+**
+** @param cb
+** @param d
+** @param objects
+** @param objectsCount
+** @param archive
+** @param archiveMax
+** @param lines
+**
+** @return
+**/
+UNS8 initConfBackup(s_conf_backup* cb, CO_Data* d, const s_conf_object* objects, UNS16 objectsCount,
+		UNS8* archive, UNS32 archiveMax, UNS8 lines)
+{
+  s_conf_backup** c;
+  UNS16 i;
+
+  if(!lines || lines > CONF_BACKUP_MAX_LINES){
+    MSG_ERR(0x1F61, "Invalid number of lines : ", lines);
+    return 0xFF;
+  }
+  for(c = &confBackups; *c; c = &(*c)->next)
+    if(*c == cb){
+      *c = cb->next;
+      break;
+    }
+  memset(cb, 0, sizeof(*cb));
+  cb->d = d;
+  cb->objects = objects;
+  cb->objectsCount = objectsCount;
+  cb->archive = archive;
+  cb->archiveMax = archiveMax;
+  cb->lines = lines;
+  /* Number of entries, then each entry */
+  cb->nodeMax = 4;
+  for(i = 0; i < objectsCount; i++)
+    cb->nodeMax += 7 + objects[i].size;
+  cb->next = confBackups;
+  confBackups = cb;
+  return 0;
+}
+
+/*!
+** Line of a node being transferred.
+**
+** @param d
+** @param nodeId
+** @param line
+**
+** @return The context, NULL if none
+**/
+static s_conf_backup* findConfBackup(CO_Data* d, UNS8 nodeId, s_conf_line** line)
+{
+  s_conf_backup* cb;
+  UNS8 i;
+
+  for(cb = confBackups; cb; cb = cb->next)
+    if(cb->d == d && cb->state != CONF_BACKUP_IDLE)
+      for(i = 0; i < cb->lines; i++)
+        if(cb->line[i].nodeId == nodeId){
+          *line = &cb->line[i];
+          return cb;
+        }
+  return NULL;
+}
+
+/*!
+** Give an SDO client entry with no transfer on use to a node.
+**
+** @param d
+** @param nodeId
+**
+** @return 0 if OK, 0xFF if none is free
+**/
+static UNS8 confBackupClient(CO_Data* d, UNS8 nodeId)
+{
+  UNS16 offset;
+  UNS16 lastIndex;
+  UNS8 CliNbr;
+
+  CliNbr = GetSDOClientFromNodeId(d, nodeId);
+  if(CliNbr < 0xFE)
+    return 0;
+  if(CliNbr == 0xFF)
+    return 0xFF;
+
+  offset = d->firstIndex->SDO_CLT;
+  lastIndex = d->lastIndex->SDO_CLT;
+  for(CliNbr = 0; offset <= lastIndex; offset++, CliNbr++){
+    if(!getSDOlineOnUse(d, CliNbr, SDO_CLIENT, NULL))
+      continue;
+    *(UNS32*)d->objdict[offset].pSubindex[1].pObject = 0x600 + nodeId;
+    *(UNS32*)d->objdict[offset].pSubindex[2].pObject = 0x580 + nodeId;
+    *(UNS8*)d->objdict[offset].pSubindex[3].pObject = nodeId;
+    return 0;
+  }
+  return 0xFF;
+}
+
+/*!
+** All the nodes are done, pack the archive.
+**
+** @param cb
+**/
+static void confBackupFinish(s_conf_backup* cb)
+{
+  UNS8* record;
+  UNS8* out = cb->archive + CONF_BACKUP_HEADER;
+  UNS32 size, count = 0;
+  UNS8 i;
+
+  if(cb->state == CONF_BACKUP_SAVING){
+    /* The nodes were saved in slots of nodeMax bytes */
+    for(i = 0; i < cb->nodesCount; i++){
+      record = cb->archive + CONF_BACKUP_HEADER + (UNS32)i * (CONF_BACKUP_NODE_HEADER + cb->nodeMax);
+      if(!record[0])
+        continue;
+      size = CONF_BACKUP_NODE_HEADER + confBackupGet(record + 1);
+      memmove(out, record, size);
+      out += size;
+      count++;
+    }
+    confBackupPut(cb->archive, CONF_BACKUP_MAGIC);
+    confBackupPut(cb->archive + 4, count);
+    cb->archiveSize = out - cb->archive;
+  }
+  cb->state = CONF_BACKUP_IDLE;
+  if(cb->done)
+    (*cb->done)(cb, 0, 0);
+}
+
+/*!
+**
+**
+** @param cb
+** @param line
+** @param abortCode
+**/
+static void confBackupEndNode(s_conf_backup* cb, s_conf_line* line, UNS32 abortCode)
+{
+  UNS8 nodeId = line->nodeId;
+
+  if(!abortCode){
+    if(cb->state == CONF_BACKUP_SAVING){
+      confBackupPut(line->dcf, line->entries);
+      confBackupPut(line->dcf - 4, line->dcfSize);
+    }
+    cb->nodesDone++;
+  }
+  else{
+    MSG_WAR(0x2F62, "Configuration transfer failed, node : ", nodeId);
+    /* Left out of the archive */
+    if(cb->state == CONF_BACKUP_SAVING)
+      line->dcf[-CONF_BACKUP_NODE_HEADER] = 0;
+    cb->nodesFailed++;
+  }
+  line->nodeId = 0;
+  cb->running--;
+  if(cb->done)
+    (*cb->done)(cb, nodeId, abortCode);
+  confBackupStart(cb);
+}
+
+/*!
+** Give the free lines to the next nodes.
+**
+** @param cb
+**/
+static void confBackupStart(s_conf_backup* cb)
+{
+  s_conf_line* line;
+  UNS8* record;
+  UNS8 i, nodeId;
+
+  while(cb->state != CONF_BACKUP_IDLE && cb->nextNode < cb->nodesCount){
+    for(i = 0; i < cb->lines && cb->line[i].nodeId; i++)
+      ;
+    if(i == cb->lines)
+      return;
+    line = &cb->line[i];
+    if(cb->state == CONF_BACKUP_SAVING){
+      nodeId = cb->nodeIds[cb->nextNode];
+      record = cb->archive + CONF_BACKUP_HEADER + (UNS32)cb->nextNode * (CONF_BACKUP_NODE_HEADER + cb->nodeMax);
+    }
+    else{
+      nodeId = cb->nextRecord[0];
+      record = cb->nextRecord;
+    }
+    if(confBackupClient(cb->d, nodeId)){
+      /* Wait for a node to release its entry */
+      if(cb->running)
+        return;
+      MSG_ERR(0x1F63, "No SDO client free for node : ", nodeId);
+    }
+    cb->nextNode++;
+    line->nodeId = nodeId;
+    line->noBlock = 0;
+    line->object = 0;
+    line->dcf = record + CONF_BACKUP_NODE_HEADER;
+    if(cb->state == CONF_BACKUP_SAVING){
+      record[0] = nodeId;
+      line->dcfSize = 4;
+      line->entries = 0;
+    }
+    else{
+      line->dcfSize = confBackupGet(record + 1);
+      line->entries = confBackupGet(line->dcf);
+      line->cursor = line->dcf + 4;
+      cb->nextRecord = line->dcf + line->dcfSize;
+    }
+    cb->running++;
+    if(!nodeId || GetSDOClientFromNodeId(cb->d, nodeId) >= 0xFE)
+      confBackupEndNode(cb, line, SDOABT_LOCAL_CTRL_ERROR);
+    else
+      confBackupNext(cb, line);
+    /* confBackupEndNode() started the next nodes */
+    if(cb->state == CONF_BACKUP_IDLE)
+      return;
+  }
+  if(cb->state != CONF_BACKUP_IDLE && !cb->running)
+    confBackupFinish(cb);
+}
+
+/*!
+** Result of the transfer of an object.
+**
+** @param line
+** @param res
+** @param abortCode
+** @param block The transfer was a block one
+**
+** @return 1 to transfer the object again
+**/
+static UNS8 confBackupRetry(s_conf_line* line, UNS8 res, UNS32 abortCode, UNS8 block)
+{
+  /* Block transfer refused by the node */
+  if(block && res == SDO_ABORTED_RCV && abortCode != OD_NO_SUCH_OBJECT &&
+     abortCode != OD_NO_SUCH_SUBINDEX && abortCode != OD_READ_NOT_ALLOWED){
+    MSG_WAR(0x3F64, "No block transfer, node : ", line->nodeId);
+    line->noBlock = 1;
+    return 1;
+  }
+  return 0;
+}
+
+/*!
+**
+**
+** @param d
+** @param nodeId
+**/
+static void confBackupReadCallback(CO_Data* d, UNS8 nodeId)
+{
+  s_conf_line* line;
+  s_conf_backup* cb = findConfBackup(d, nodeId, &line);
+  const s_conf_object* o;
+  UNS8* entry;
+  UNS32 size, abortCode;
+  UNS8 res;
+
+  if(!cb){
+    closeSDOtransfer(d, nodeId, SDO_CLIENT);
+    return;
+  }
+  o = &cb->objects[line->object];
+  entry = line->dcf + line->dcfSize;
+  size = o->size;
+  res = getReadResultNetworkDict(d, nodeId, entry + 7, &size, &abortCode);
+  closeSDOtransfer(d, nodeId, SDO_CLIENT);
+  if(res == SDO_FINISHED){
+    entry[0] = (UNS8)o->index;
+    entry[1] = (UNS8)(o->index >> 8);
+    entry[2] = o->subIndex;
+    confBackupPut(entry + 3, size);
+    line->dcfSize += 7 + size;
+    line->entries++;
+    cb->transfers++;
+    cb->bytes += size;
+  }
+  else if(confBackupRetry(line, res, abortCode, (o->flags & CONF_OBJECT_BLOCK) && !line->noBlock)){
+    confBackupNext(cb, line);
+    return;
+  }
+  else if(abortCode == OD_NO_SUCH_OBJECT || abortCode == OD_NO_SUCH_SUBINDEX || abortCode == OD_READ_NOT_ALLOWED)
+    /* Not in the dictionary of this node */
+    MSG_WAR(0x3F65, "Object not saved : ", (UNS32)o->index << 8 | o->subIndex);
+  else{
+    confBackupEndNode(cb, line, abortCode ? abortCode : SDOABT_GENERAL_ERROR);
+    return;
+  }
+  line->object++;
+  confBackupNext(cb, line);
+}
+
+/*!
+**
+**
+** @param d
+** @param nodeId
+**/
+static void confBackupWriteCallback(CO_Data* d, UNS8 nodeId)
+{
+  s_conf_line* line;
+  s_conf_backup* cb = findConfBackup(d, nodeId, &line);
+  UNS32 size, abortCode;
+  UNS8 res;
+
+  res = getWriteResultNetworkDict(d, nodeId, &abortCode);
+  closeSDOtransfer(d, nodeId, SDO_CLIENT);
+  if(!cb)
+    return;
+  size = confBackupGet(line->cursor + 3);
+  if(res == SDO_FINISHED){
+    line->cursor += 7 + size;
+    line->entries--;
+    cb->transfers++;
+    cb->bytes += size;
+  }
+  else if(!confBackupRetry(line, res, abortCode, size >= CONF_BACKUP_BLOCK_MIN && !line->noBlock)){
+    confBackupEndNode(cb, line, abortCode ? abortCode : SDOABT_GENERAL_ERROR);
+    return;
+  }
+  confBackupNext(cb, line);
+}
+
+/*!
+** Start the transfer of the next object of a node.
+**
+** @param cb
+** @param line
+**/
+static void confBackupNext(s_conf_backup* cb, s_conf_line* line)
+{
+  const s_conf_object* o;
+  UNS8* entry;
+  UNS32 size;
+  UNS8 res;
+
+  if(cb->state == CONF_BACKUP_SAVING){
+    for(;;){
+      if(line->object == cb->objectsCount){
+        confBackupEndNode(cb, line, 0);
+        return;
+      }
+      o = &cb->objects[line->object];
+      if(!(o->flags & CONF_OBJECT_CLEAR))
+        break;
+      entry = line->dcf + line->dcfSize;
+      entry[0] = (UNS8)o->index;
+      entry[1] = (UNS8)(o->index >> 8);
+      entry[2] = o->subIndex;
+      confBackupPut(entry + 3, 1);
+      entry[7] = 0;
+      line->dcfSize += 8;
+      line->entries++;
+      line->object++;
+    }
+    /* Raw bytes, in the order of the bus */
+    res = readNetworkDictCallback(cb->d, line->nodeId, o->index, o->subIndex, visible_string,
+		    confBackupReadCallback, (o->flags & CONF_OBJECT_BLOCK) && !line->noBlock);
+  }
+  else{
+    if(!line->entries){
+      confBackupEndNode(cb, line, 0);
+      return;
+    }
+    entry = line->cursor;
+    size = confBackupGet(entry + 3);
+    res = writeNetworkDictCallBackAI(cb->d, line->nodeId, (UNS16)(entry[0] | entry[1] << 8), entry[2], size, 0,
+		    entry + 7, confBackupWriteCallback, 0, size >= CONF_BACKUP_BLOCK_MIN && !line->noBlock);
+  }
+  if(res)
+    confBackupEndNode(cb, line, SDOABT_LOCAL_CTRL_ERROR);
+}
+
+/*!
+**
+**
+** @param cb
+** @param nodeIds
+** @param nodesCount
+** @param done
+**
+** @return
+**/
+UNS8 confBackupSave(s_conf_backup* cb, const UNS8* nodeIds, UNS8 nodesCount, confBackupDone_t done)
+{
+  if(cb->state != CONF_BACKUP_IDLE){
+    MSG_ERR(0x1F66, "Configuration transfer in progress, state : ", cb->state);
+    return 0xFF;
+  }
+  if(CONF_BACKUP_HEADER + (UNS32)nodesCount * (CONF_BACKUP_NODE_HEADER + cb->nodeMax) > cb->archiveMax){
+    MSG_ERR(0x1F67, "Archive too small, bytes needed : ",
+		    CONF_BACKUP_HEADER + (UNS32)nodesCount * (CONF_BACKUP_NODE_HEADER + cb->nodeMax));
+    return 0xFF;
+  }
+  cb->nodeIds = nodeIds;
+  cb->nodesCount = nodesCount;
+  cb->nextNode = 0;
+  cb->running = 0;
+  cb->done = done;
+  cb->archiveSize = 0;
+  cb->nodesDone = cb->nodesFailed = 0;
+  cb->transfers = cb->bytes = 0;
+  cb->state = CONF_BACKUP_SAVING;
+  confBackupStart(cb);
+  return 0;
+}
+
+/*!
+**
+**
+** @param cb
+** @param archive
+** @param size
+** @param done
+**
+** @return
+**/
+UNS8 confBackupRestore(s_conf_backup* cb, UNS8* archive, UNS32 size, confBackupDone_t done)
+{
+  UNS8* p = archive + CONF_BACKUP_HEADER;
+  UNS8* end = archive + size;
+  UNS8* dcfEnd;
+  UNS32 nodes, entries, i;
+
+  if(cb->state != CONF_BACKUP_IDLE){
+    MSG_ERR(0x1F66, "Configuration transfer in progress, state : ", cb->state);
+    return 0xFF;
+  }
+  if(size < CONF_BACKUP_HEADER || confBackupGet(archive) != CONF_BACKUP_MAGIC)
+    goto invalid;
+  /* Check the bounds of every entry before writing anything */
+  nodes = confBackupGet(archive + 4);
+  if(nodes > 0xFF)
+    goto invalid;
+  for(i = 0; i < nodes; i++){
+    if(end - p < CONF_BACKUP_NODE_HEADER + 4 || confBackupGet(p + 1) > (UNS32)(end - p - CONF_BACKUP_NODE_HEADER))
+      goto invalid;
+    dcfEnd = p + CONF_BACKUP_NODE_HEADER + confBackupGet(p + 1);
+    entries = confBackupGet(p + CONF_BACKUP_NODE_HEADER);
+    for(p += CONF_BACKUP_NODE_HEADER + 4; entries--; p += 7 + confBackupGet(p + 3))
+      if(dcfEnd - p < 7 || confBackupGet(p + 3) > (UNS32)(dcfEnd - p - 7))
+        goto invalid;
+    if(p != dcfEnd)
+      goto invalid;
+  }
+  cb->nodeIds = NULL;
+  cb->nodesCount = (UNS8)nodes;
+  cb->nextNode = 0;
+  cb->nextRecord = archive + CONF_BACKUP_HEADER;
+  cb->running = 0;
+  cb->done = done;
+  cb->nodesDone = cb->nodesFailed = 0;
+  cb->transfers = cb->bytes = 0;
+  cb->state = CONF_BACKUP_RESTORING;
+  confBackupStart(cb);
+  return 0;
+invalid:
+  MSG_ERR(0x1F68, "Archive not valid, bytes : ", size);
+  return 0xFF;
+}
+
+#endif /* CO_ENABLE_CONF_BACKUP */
@@ -181,12 +181,73 @@ UNS8 init_consise_dcf(CO_Data* d,UNS8 nodeId)
     // printf("%.2x %.2x %.2x %.2x\n",dcf[0],dcf[1],dcf[2],dcf[3]);
     d->dcf_cursor = dcf + 4;
     d->dcf_entries_count = 0;
+    d->dcf_index = 0;
     d->dcf_status = DCF_STATUS_INIT;
     return 1;
     DCF_finish:
     return 0;
 }
 
+/**
+** Decode a varint of a compact concise DCF
+**
+** @param d
+** @param dcfend
+** @param value
+**
+** @return 0 if the DCF is truncated
+*/
+static UNS8 get_DCF_varint(CO_Data* d, UNS8* dcfend, UNS32* value)
+{
+  UNS8 shift = 0;
+  *value = 0;
+  while(d->dcf_cursor < dcfend && shift < 32){
+    UNS8 byte = *(d->dcf_cursor++);
+    *value |= (UNS32)(byte & 0x7F) << shift;
+    if(!(byte & 0x80))
+      return 1;
+    shift += 7;
+  }
+  return 0;
+}
+
+/**
+** Decode the next entry of a compact concise DCF, the values of 4 bytes
+** or less are expanded in dcf_value
+**
+** @param d
+** @param dcf_entry
+** @param dcfend
+**
+** @return 0 if the DCF is truncated
+*/
+static UNS8 get_next_compact_DCF_data(CO_Data* d, dcf_entry_t *dcf_entry, UNS8* dcfend)
+{
+  UNS32 delta, size, value;
+  UNS8 i;
+  if(!get_DCF_varint(d, dcfend, &delta) || d->dcf_cursor >= dcfend)
+    return 0;
+  d->dcf_index += (UNS16)((delta >> 1) ^ (0 - (delta & 1)));
+  dcf_entry->Index = d->dcf_index;
+  dcf_entry->Subindex = *(d->dcf_cursor++);
+  if(!get_DCF_varint(d, dcfend, &size))
+    return 0;
+  if(size <= 4){
+    if(!get_DCF_varint(d, dcfend, &value))
+      return 0;
+    for(i = 0; i < size; i++)
+      d->dcf_value[i] = (UNS8)(value >> (8 * i));
+    dcf_entry->Data = d->dcf_value;
+  }else{
+    if(size > (UNS32)(dcfend - d->dcf_cursor))
+      return 0;
+    dcf_entry->Data = d->dcf_cursor;
+    d->dcf_cursor += size;
+  }
+  dcf_entry->Size = size;
+  return 1;
+}
+
 UNS8 get_next_DCF_data(CO_Data* d, dcf_entry_t *dcf_entry, UNS8 nodeId)
 {
   UNS8* dcfend;
@@ -201,6 +262,15 @@ UNS8 get_next_DCF_data(CO_Data* d, dcf_entry_t *dcf_entry, UNS8 nodeId)
   dcf = *(UNS8**)d->dcf_odentry->pSubindex[nodeId].pObject;
   nb_entries = UNS32_LE(*((UNS32*)dcf));
   dcfend = dcf + szData;
+  if(nb_entries & DCF_COMPACT){
+    if(d->dcf_entries_count >= (nb_entries & ~DCF_COMPACT) ||
+       !get_next_compact_DCF_data(d, dcf_entry, dcfend))
+      return 0;
+    d->dcf_data = dcf_entry->Data;
+    d->dcf_size = dcf_entry->Size;
+    d->dcf_entries_count++;
+    return 1;
+  }
   if((UNS8*)d->dcf_cursor + 7 < (UNS8*)dcfend && d->dcf_entries_count < nb_entries){
     /* DCF data may not be 32/16b aligned, 
     * we cannot directly dereference d->dcf_cursor 
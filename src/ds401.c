@@ -0,0 +1,376 @@
+/*
+  This file is part of CanFestival, a library implementing CanOpen
+  Stack.
+
+  Copyright (C): Edouard TISSERANT and Francis DUPIN
+
+  See COPYING file for copyrights details.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+  USA
+*/
+
+/*!
+** @file   ds401.c
+** @author Edouard TISSERANT and Francis DUPIN
+**
+** @brief DS-401 digital I/O kept as packed bitmaps
+**
+** Inputs and outputs are processed 32 channels at a time. The groups
+** whose interrupt fired are recorded in a bitmap, which is then used to
+** select the event driven TPDOs to send, instead of rebuilding and
+** comparing every TPDO.
+*/
+
+#include <string.h>
+
+#include "data.h"
+#include "ds401.h"
+#include "pdo.h"
+#include "sysdep.h"
+
+#ifdef CO_ENABLE_DS401
+
+#define DS401_WORD_SIZE 4
+
+/*!
+** Unaligned load and store of four groups. The bitwise operations done
+** on the words do not depend on the byte order.
+**/
+static UNS32 DS401_load(const UNS8* p)
+{
+  UNS32 w;
+  memcpy(&w, p, DS401_WORD_SIZE);
+  return w;
+}
+
+static void DS401_store(UNS8* p, UNS32 w)
+{
+  memcpy(p, &w, DS401_WORD_SIZE);
+}
+
+/*! Load up to four groups, missing groups and absent objects read as fill.
+**
+** @param p
+** @param nb number of groups available from p
+** @param fill
+**
+** @return
+**/
+static UNS32 DS401_loadPartial(const UNS8* p, UNS8 nb, UNS32 fill)
+{
+  UNS32 w = fill;
+  if(p == NULL)
+    return fill;
+  if(nb >= DS401_WORD_SIZE)
+    return DS401_load(p);
+  memcpy(&w, p, nb);
+  return w;
+}
+
+/*! Return the array stored behind subindexes 1..n of an OD entry.
+**
+** @param d
+** @param wIndex
+** @param nb set to the number of subindexes, or 0 if the entry is absent
+** @param pArray
+**
+** @return OD_SUCCESSFUL, or an abort code if the array is unusable
+**/
+static UNS32 DS401_bindArray(CO_Data* d, UNS16 wIndex, UNS8* nb, UNS8** pArray)
+{
+  UNS32 errorCode;
+  ODCallback_t *Callback;
+  const indextable *ptrTable;
+  UNS8 i, count;
+
+  *nb = 0;
+  *pArray = NULL;
+  ptrTable = (*d->scanIndexOD)(wIndex, &errorCode, &Callback);
+  if(errorCode != OD_SUCCESSFUL)
+    return OD_SUCCESSFUL;
+
+  count = ptrTable->bSubCount - 1;
+  if(ptrTable->bSubCount < 2)
+    return OD_SUCCESSFUL;
+
+  for(i = 1; i <= count; i++){
+    if(ptrTable->pSubindex[i].size != 1 ||
+       ptrTable->pSubindex[i].pObject != (UNS8*)ptrTable->pSubindex[1].pObject + (i - 1)){
+      MSG_ERR(0x1A01, "DS401 : array not contiguous, index : ", wIndex);
+      return OD_LENGTH_DATA_INVALID;
+    }
+  }
+  *nb = count;
+  *pArray = (UNS8*)ptrTable->pSubindex[1].pObject;
+  return OD_SUCCESSFUL;
+}
+
+/*! Bind a parameter array, which must cover at least nbGroups groups.
+**
+** @param d
+** @param wIndex
+** @param nbGroups
+** @param pArray
+**
+** @return
+**/
+static UNS32 DS401_bindParameter(CO_Data* d, UNS16 wIndex, UNS8 nbGroups, const UNS8** pArray)
+{
+  UNS32 errorCode;
+  UNS8 nb;
+  UNS8* array;
+
+  errorCode = DS401_bindArray(d, wIndex, &nb, &array);
+  if(errorCode != OD_SUCCESSFUL)
+    return errorCode;
+  if(array && nb < nbGroups){
+    MSG_ERR(0x1A02, "DS401 : parameter shorter than groups, index : ", wIndex);
+    return OD_LENGTH_DATA_INVALID;
+  }
+  *pArray = array;
+  return OD_SUCCESSFUL;
+}
+
+/*!
+**
+**
+** @param d
+** @param io
+**
+** @return
+**/
+UNS32 DS401_init(CO_Data* d, s_DS401_io* io)
+{
+  UNS32 errorCode;
+  UNS8* outputs = NULL;
+  UNS32 size = 0;
+  UNS8 dataType;
+
+  memset(io, 0, sizeof(s_DS401_io));
+
+  errorCode = DS401_bindArray(d, DS401_READ_INPUTS_8_BIT, &io->nbInputs, &io->inputs);
+  if(errorCode == OD_SUCCESSFUL && io->nbInputs)
+    errorCode = DS401_bindParameter(d, DS401_POLARITY_INPUT_8_BIT, io->nbInputs, &io->inputPolarity);
+  if(errorCode == OD_SUCCESSFUL && io->nbInputs)
+    errorCode = DS401_bindParameter(d, DS401_INTERRUPT_MASK_ANY_CHANGE, io->nbInputs, &io->maskAnyChange);
+  if(errorCode == OD_SUCCESSFUL && io->nbInputs)
+    errorCode = DS401_bindParameter(d, DS401_INTERRUPT_MASK_LOW_TO_HIGH, io->nbInputs, &io->maskLowToHigh);
+  if(errorCode == OD_SUCCESSFUL && io->nbInputs)
+    errorCode = DS401_bindParameter(d, DS401_INTERRUPT_MASK_HIGH_TO_LOW, io->nbInputs, &io->maskHighToLow);
+  if(errorCode == OD_SUCCESSFUL && io->nbInputs){
+    /* 0x6005 is a simple boolean variable */
+    const indextable *ptrTable;
+    ODCallback_t *Callback;
+    UNS32 scanError;
+    ptrTable = (*d->scanIndexOD)(DS401_GLOBAL_INTERRUPT_ENABLE, &scanError, &Callback);
+    if(scanError == OD_SUCCESSFUL){
+      dataType = ptrTable->pSubindex[0].bDataType;
+      size = ptrTable->pSubindex[0].size;
+      if(size == 1 && dataType == boolean)
+        io->interruptEnable = (const UNS8*)ptrTable->pSubindex[0].pObject;
+    }
+  }
+
+  if(errorCode == OD_SUCCESSFUL)
+    errorCode = DS401_bindArray(d, DS401_WRITE_OUTPUTS_8_BIT, &io->nbOutputs, &outputs);
+  io->outputs = outputs;
+  if(errorCode == OD_SUCCESSFUL && io->nbOutputs)
+    errorCode = DS401_bindParameter(d, DS401_CHANGE_POLARITY_OUTPUTS_8_BIT, io->nbOutputs, &io->outputPolarity);
+  if(errorCode == OD_SUCCESSFUL && io->nbOutputs)
+    errorCode = DS401_bindParameter(d, DS401_FILTER_MASK_OUTPUTS_8_BIT, io->nbOutputs, &io->outputFilter);
+
+  if(errorCode != OD_SUCCESSFUL)
+    memset(io, 0, sizeof(s_DS401_io));
+  return errorCode;
+}
+
+/*! Send the event driven TPDOs which map at least one flagged 0x6000 group.
+**
+** @param d
+** @param groupEvents one bit per input group
+**
+** @return number of TPDOs triggered
+**/
+static UNS8 DS401_triggerTPDOs(CO_Data* d, const UNS8* groupEvents)
+{
+  UNS8 pdoNum = 0x00;
+  UNS8 triggered = 0;
+  UNS16 offsetObjdict = d->firstIndex->PDO_TRS;
+  UNS16 offsetObjdictMap = d->firstIndex->PDO_TRS_MAP;
+  UNS16 lastIndex = d->lastIndex->PDO_TRS;
+
+  if (!offsetObjdict || !d->CurrentCommunicationState.csPDO)
+    return 0;
+
+  for (;offsetObjdict <= lastIndex; pdoNum++, offsetObjdict++, offsetObjdictMap++)
+  {
+    const subindex* pdoSub = d->objdict[offsetObjdict].pSubindex;
+    const subindex* mapSub = d->objdict[offsetObjdictMap].pSubindex;
+    UNS8 transmissionType;
+    UNS8 nbMap, i;
+
+    /* check if TPDO is not valid */
+    if ((*(UNS32 *) pdoSub[1].pObject) & 0x80000000)
+      continue;
+    transmissionType = *(UNS8 *)pdoSub[2].pObject;
+    if (transmissionType != TRANS_EVENT_PROFILE && transmissionType != TRANS_EVENT_SPECIFIC)
+      continue;
+
+    nbMap = *(UNS8 *) mapSub[0].pObject;
+    for (i = 1; i <= nbMap; i++)
+    {
+      UNS32 mapping = *(UNS32 *) mapSub[i].pObject;
+      UNS8 group = (UNS8) ((mapping >> 8) & 0xFF);
+
+      if ((UNS16) (mapping >> 16) == DS401_READ_INPUTS_8_BIT && group &&
+          (groupEvents[(group - 1) >> 3] & (1 << ((group - 1) & 7))))
+      {
+        triggered += sendOnePDOevent(d, pdoNum);
+        break;
+      }
+    }
+  }
+  return triggered;
+}
+
+/*!
+**
+**
+** @param d
+** @param io
+** @param raw
+**
+** @return
+**/
+UNS8 DS401_updateInputs(CO_Data* d, s_DS401_io* io, const UNS8* raw)
+{
+  UNS8 groupEvents[(DS401_MAX_GROUPS + 7) / 8];
+  UNS8 interrupting = 0;
+  UNS16 group;
+
+  if(io->inputs == NULL)
+    return 0;
+
+  memset(groupEvents, 0, sizeof(groupEvents));
+
+#ifdef CO_ENABLE_OD_SUBSCRIPTIONS
+  /* The groups changed by one sample are published together */
+  if(d->odSubscriptions)
+    _beginODChangePass(d);
+#endif
+
+  for(group = 0; group < io->nbInputs; group += DS401_WORD_SIZE){
+    UNS8 nb = (UNS8)(io->nbInputs - group);
+    UNS32 previous, current, rising, falling, events;
+
+    if(nb > DS401_WORD_SIZE)
+      nb = DS401_WORD_SIZE;
+
+    previous = DS401_loadPartial(io->inputs + group, nb, 0);
+    current = DS401_loadPartial(raw + group, nb, 0) ^
+              DS401_loadPartial(io->inputPolarity ? io->inputPolarity + group : NULL, nb, 0);
+    if(current == previous)
+      continue;
+
+    if(nb == DS401_WORD_SIZE)
+      DS401_store(io->inputs + group, current);
+    else
+      memcpy(io->inputs + group, &current, nb);
+
+#ifdef CO_ENABLE_OD_SUBSCRIPTIONS
+    /* 0x6000 is written directly, without the OD callbacks */
+    if(d->odSubscriptions){
+      UNS8 before[DS401_WORD_SIZE];
+      UNS8 i;
+      DS401_store(before, previous);
+      for(i = 0; i < nb; i++)
+        if(before[i] != io->inputs[group + i])
+          _notifyODChange(d, DS401_READ_INPUTS_8_BIT, (UNS8)(group + i + 1), io->inputs + group + i, 1);
+    }
+#endif
+
+    rising = current & ~previous;
+    falling = previous & ~current;
+    events = ((rising | falling) &
+              DS401_loadPartial(io->maskAnyChange ? io->maskAnyChange + group : NULL, nb, 0xFFFFFFFF)) |
+             (rising & DS401_loadPartial(io->maskLowToHigh ? io->maskLowToHigh + group : NULL, nb, 0)) |
+             (falling & DS401_loadPartial(io->maskHighToLow ? io->maskHighToLow + group : NULL, nb, 0));
+    if(events){
+      UNS8 bytes[DS401_WORD_SIZE];
+      UNS8 i;
+      DS401_store(bytes, events);
+      for(i = 0; i < nb; i++){
+        if(bytes[i]){
+          groupEvents[(group + i) >> 3] |= 1 << ((group + i) & 7);
+          interrupting = 1;
+        }
+      }
+    }
+  }
+
+#ifdef CO_ENABLE_OD_SUBSCRIPTIONS
+  if(d->odSubscriptions)
+    _endODChangePass(d);
+#endif
+
+  if(!interrupting || (io->interruptEnable && !*io->interruptEnable))
+    return 0;
+
+  return DS401_triggerTPDOs(d, groupEvents);
+}
+
+/*!
+**
+**
+** @param d
+** @param io
+** @param physical
+**
+** @return
+**/
+UNS8 DS401_applyOutputs(CO_Data* d, s_DS401_io* io, UNS8* physical)
+{
+  UNS8 changed = 0;
+  UNS16 group;
+
+  if(io->outputs == NULL)
+    return 0;
+
+  for(group = 0; group < io->nbOutputs; group += DS401_WORD_SIZE){
+    UNS8 nb = (UNS8)(io->nbOutputs - group);
+    UNS32 previous, value, filter;
+
+    if(nb > DS401_WORD_SIZE)
+      nb = DS401_WORD_SIZE;
+
+    previous = DS401_loadPartial(physical + group, nb, 0);
+    filter = DS401_loadPartial(io->outputFilter ? io->outputFilter + group : NULL, nb, 0xFFFFFFFF);
+    value = DS401_loadPartial(io->outputs + group, nb, 0) ^
+            DS401_loadPartial(io->outputPolarity ? io->outputPolarity + group : NULL, nb, 0);
+    value = (value & filter) | (previous & ~filter);
+    if(value == previous)
+      continue;
+
+    changed = 1;
+    if(nb == DS401_WORD_SIZE)
+      DS401_store(physical + group, value);
+    else
+      memcpy(physical + group, &value, nb);
+  }
+  return changed;
+}
+
+#endif /* CO_ENABLE_DS401 */
@@ -61,8 +61,13 @@ UNS32 OnNumberOfErrorsUpdate(CO_Data* d, const indextable * unsused_indextable,
   // if 0, reset Pre-defined Error Field
   // else, don't change and give an abort message (eeror code: 0609 0030h)
 	if (*d->error_number == 0)
+	{
 		for (index = 0; index < d->error_history_size; ++index)
 			*(d->error_first_element + index) = 0;		/* clear all the fields in Pre-defined Error Field (1003h) */
+#ifdef CO_ENABLE_EMCY_RING
+		d->error_head = 0;
+#endif
+	}
 	else
 		;// abort message
   return 0;
@@ -78,6 +83,9 @@ void emergencyInit(CO_Data* d)
   RegisterSetODentryCallBack(d, 0x1003, 0x00, &OnNumberOfErrorsUpdate);
 
   *d->error_number = 0;
+#ifdef CO_ENABLE_EMCY_RING
+  d->error_head = 0;
+#endif
 }
 
 /*!
@@ -129,15 +137,15 @@ UNS8 sendEMCY(CO_Data* d, UNS16 errCode, UNS8 errRegister, const void *Specific,
 	return canSend(d->canHandle,&m);
 }
 
-/*! Sets a new error with code errCode. Also sets corresponding bits in Error register (1001h)
- **                                                                                                 
- **  
+/*! Registers a new error with code errCode, without sending the EMCY.
+ **
  ** @param d
- ** @param errCode Code of the error                                                                                        
- ** @param errRegister Bits of Error register (1001h) to be set.
- ** @return 1 if error, 0 if successful
+ ** @param errCode Code of the error
+ ** @param errRegMask Bits of Error register (1001h) to be set.
+ ** @param addInfo
+ ** @return 0 if the error is new, 1 if error_data is full, 2 if the error is already active
  */
-UNS8 EMCY_setError(CO_Data* d, UNS16 errCode, UNS8 errRegMask, UNS16 addInfo)
+UNS8 _EMCY_raiseError(CO_Data* d, UNS16 errCode, UNS8 errRegMask, UNS16 addInfo)
 {
 	UNS8 index;
 	UNS8 errRegister_tmp;
@@ -149,7 +157,7 @@ UNS8 EMCY_setError(CO_Data* d, UNS16 errCode, UNS8 errRegMask, UNS16 addInfo)
 			if (d->error_data[index].active)
 			{
 				MSG_WAR(0x3052, "EMCY message already sent", 0);
-				return 0;
+				return 2;
 			} else d->error_data[index].active = 1;		/* set as active error */
 			break;
 		}
@@ -177,18 +185,20 @@ UNS8 EMCY_setError(CO_Data* d, UNS16 errCode, UNS8 errRegMask, UNS16 addInfo)
 	*d->error_register = errRegister_tmp;
 	
 	/* set Pre-defined Error Field (1003h) */
+#ifdef CO_ENABLE_EMCY_RING
+	/* no shift, sub 1 is mapped on the newest entry */
+	d->error_head = (UNS8)((d->error_head + 1) % d->error_history_size);
+	*(d->error_first_element + d->error_head) = errCode | ((UNS32)addInfo << 16);
+#else
 	for (index = d->error_history_size - 1; index > 0; --index)
 		*(d->error_first_element + index) = *(d->error_first_element + index - 1);
 	*(d->error_first_element) = errCode | ((UNS32)addInfo << 16);
+#endif
 	if(*d->error_number < d->error_history_size) ++(*d->error_number);
-	
-	/* send EMCY message */
-	if (d->CurrentCommunicationState.csEmergency)
-		return sendEMCY(d, errCode, *d->error_register, NULL, 0);
-	else return 1;
+	return 0;
 }
 
-/*! Deletes error errCode. Also clears corresponding bits in Error register (1001h)
+/*! Sets a new error with code errCode. Also sets corresponding bits in Error register (1001h)
  **                                                                                                 
  **  
  ** @param d
@@ -196,7 +206,26 @@ UNS8 EMCY_setError(CO_Data* d, UNS16 errCode, UNS8 errRegMask, UNS16 addInfo)
  ** @param errRegister Bits of Error register (1001h) to be set.
  ** @return 1 if error, 0 if successful
  */
-void EMCY_errorRecovered(CO_Data* d, UNS16 errCode)
+UNS8 EMCY_setError(CO_Data* d, UNS16 errCode, UNS8 errRegMask, UNS16 addInfo)
+{
+	UNS8 ret = _EMCY_raiseError(d, errCode, errRegMask, addInfo);
+
+	if (ret)
+		return ret == 2 ? 0 : 1;
+	
+	/* send EMCY message */
+	if (d->CurrentCommunicationState.csEmergency)
+		return sendEMCY(d, errCode, *d->error_register, NULL, 0);
+	else return 1;
+}
+
+/*! Clears error errCode, without sending the EMCY.
+ **
+ ** @param d
+ ** @param errCode Code of the error
+ ** @return 0 if the error was not active, 1 if other errors are active, 2 if no error is left
+ */
+UNS8 _EMCY_clearError(CO_Data* d, UNS16 errCode)
 {
 	UNS8 index;
 	UNS8 errRegister_tmp;
@@ -217,17 +246,31 @@ void EMCY_errorRecovered(CO_Data* d, UNS16 errCode)
 				anyActiveError = 1;
 				errRegister_tmp |= d->error_data[index].errRegMask;
 			}
+		*d->error_register = errRegister_tmp;
 		if(anyActiveError == 0)
 		{
 			d->error_state = Error_free;
-			/* send a EMCY message with code "Error Reset or No Error" */
-			if (d->CurrentCommunicationState.csEmergency)
-				sendEMCY(d, 0x0000, 0x00, NULL, 0);
+			return 2;
 		}
-		*d->error_register = errRegister_tmp;
+		return 1;
 	}
-	else
-		MSG_WAR(0x3054, "recovered error was not active", 0);
+	MSG_WAR(0x3054, "recovered error was not active", 0);
+	return 0;
+}
+
+/*! Deletes error errCode. Also clears corresponding bits in Error register (1001h)
+ **                                                                                                 
+ **  
+ ** @param d
+ ** @param errCode Code of the error                                                                                        
+ ** @param errRegister Bits of Error register (1001h) to be set.
+ ** @return 1 if error, 0 if successful
+ */
+void EMCY_errorRecovered(CO_Data* d, UNS16 errCode)
+{
+	/* send a EMCY message with code "Error Reset or No Error" */
+	if (_EMCY_clearError(d, errCode) == 2 && d->CurrentCommunicationState.csEmergency)
+		sendEMCY(d, 0x0000, 0x00, NULL, 0);
 }
 
 /*! This function is responsible to process an EMCY canopen-message.
@@ -255,7 +298,7 @@ void proceedEMCY(CO_Data* d, Message* m)
 	nodeID = m->cob_id & 0x7F;
 	errCode = m->Data[0] | ((UNS16)m->Data[1] << 8);
 	errReg = m->Data[2];
-	(*d->post_emcy)(d, nodeID, errCode, errReg);
+	PROFILE_HOOK(d, HOOK_POST_EMCY, 0, 0, (*d->post_emcy)(d, nodeID, errCode, errReg));
 }
 
 void _post_emcy(CO_Data* d, UNS8 nodeID, UNS16 errCode, UNS8 errReg){}
@@ -0,0 +1,303 @@
+/*
+This file is part of CanFestival, a library implementing CanOpen Stack.
+
+Copyright (C): Edouard TISSERANT and Francis DUPIN
+
+See COPYING file for copyrights details.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+USA
+*/
+
+/*!
+** @file   emcyring.c
+** @author Edouard TISSERANT and Francis DUPIN
+**
+** @brief Error rings
+**
+** A ring has a single producer, so posting is a copy in the cell and a
+** release store of head, with no compare and swap. The stack drains at most
+** the errors posted before it starts, and sends the EMCY once the whole
+** drain is applied, so that an error recovered in the same drain is not
+** signalled.
+*/
+
+#include <string.h>
+#include "data.h"
+#include "objacces.h"
+#include "timers_driver.h"
+#include "emcyring.h"
+
+#ifdef CO_ENABLE_EMCY_RING
+
+#define RING_LOAD_ACQUIRE(v)     __atomic_load_n(&(v), __ATOMIC_ACQUIRE)
+#define RING_STORE_RELEASE(v, x) __atomic_store_n(&(v), (x), __ATOMIC_RELEASE)
+#define RING_EXCHANGE(v, x)      __atomic_exchange_n(&(v), (x), __ATOMIC_SEQ_CST)
+
+/* Internal, emcy.c */
+UNS8 _EMCY_raiseError(CO_Data* d, UNS16 errCode, UNS8 errRegMask, UNS16 addInfo);
+UNS8 _EMCY_clearError(CO_Data* d, UNS16 errCode);
+UNS8 sendEMCY(CO_Data* d, UNS16 errCode, UNS8 errRegister, const void *Specific, UNS8 SpecificLength);
+
+/*!
+**
+**
+** @param d
+** @param drain
+**/
+void initEMCYDrain(CO_Data* d, s_emcy_drain* drain)
+{
+  stopEMCYDrain(d);
+  memset(drain, 0, sizeof(*drain));
+  drain->inhibitTimer = TIMER_NONE;
+  d->emcyDrain = drain;
+}
+
+/*!
+**
+**
+** @param d
+**/
+void stopEMCYDrain(CO_Data* d)
+{
+  if(!d->emcyDrain)
+    return;
+  d->emcyDrain->inhibitTimer = DelAlarm(d->emcyDrain->inhibitTimer);
+  d->emcyDrain = NULL;
+}
+
+/*!
+**
+**
+** @param d
+** @param ring
+** @param cells
+** @param size
+**
+** @return
+**/
+UNS8 addEMCYRing(CO_Data* d, s_emcy_ring* ring, s_emcy_post* cells, UNS32 size)
+{
+  if(!d->emcyDrain || !size || (size & (size - 1))){
+    MSG_ERR(0x1F40, "Error ring size must be a power of 2 : ", size);
+    return 0xFF;
+  }
+  ring->d = d;
+  ring->cells = cells;
+  ring->mask = size - 1;
+  ring->head = 0;
+  ring->tail = 0;
+  ring->posted = 0;
+  ring->rejected = 0;
+  ring->next = d->emcyDrain->rings;
+  d->emcyDrain->rings = ring;
+  return 0;
+}
+
+/*!
+** Copy a post in the next cell of the ring, and publish it.
+**
+** @param ring
+** @param post
+**
+** @return 0 if posted, 0xFF if the ring is full
+**/
+static UNS8 postToRing(s_emcy_ring* ring, const s_emcy_post* post)
+{
+  s_cmd_queue* q = ring->d->cmdQueue;
+  UNS32 head = ring->head;
+
+  if(head - RING_LOAD_ACQUIRE(ring->tail) > ring->mask){
+    ring->rejected++;
+    MSG_WAR(0x2F41, "Error ring full, error dropped : ", post->errCode);
+    return 0xFF;
+  }
+  ring->cells[head & ring->mask] = *post;
+  RING_STORE_RELEASE(ring->head, head + 1);
+  ring->posted++;
+
+  /* Drained with the commands of the node */
+  if(q && !RING_EXCHANGE(q->kicked, 1))
+    TimerKick();
+  return 0;
+}
+
+/*!
+**
+**
+** @param ring
+** @param errCode
+** @param errRegMask
+** @param addInfo
+**
+** @return
+**/
+UNS8 postEMCYRingError(s_emcy_ring* ring, UNS16 errCode, UNS8 errRegMask, UNS16 addInfo)
+{
+  s_emcy_post post;
+
+  post.errCode = errCode;
+  post.addInfo = addInfo;
+  post.errRegMask = errRegMask;
+  post.recovered = 0;
+  return postToRing(ring, &post);
+}
+
+/*!
+**
+**
+** @param ring
+** @param errCode
+**
+** @return
+**/
+UNS8 postEMCYRingRecovered(s_emcy_ring* ring, UNS16 errCode)
+{
+  s_emcy_post post;
+
+  post.errCode = errCode;
+  post.addInfo = 0;
+  post.errRegMask = 0;
+  post.recovered = 1;
+  return postToRing(ring, &post);
+}
+
+/*!
+** EMCY inhibit time (0x1015), in 100 us.
+**
+** @param d
+**
+** @return 0 if the dictionary has no 0x1015
+**/
+static UNS16 EMCYInhibitTime(CO_Data* d)
+{
+  const subindex* entry;
+
+  if(_findODentry(d, 0x1015, 0, &entry) != OD_SUCCESSFUL || entry->size != sizeof(UNS16))
+    return 0;
+  return *(UNS16*)entry->pObject;
+}
+
+static void sendPendingEMCY(CO_Data* d);
+
+/*!
+** End of the inhibit time of the last EMCY sent.
+**
+** @param d
+** @param id
+**/
+static void EMCYInhibitAlarm(CO_Data* d, UNS32 id)
+{
+  if(!d->emcyDrain)
+    return;
+  d->emcyDrain->inhibitTimer = TIMER_NONE;
+  d->emcyDrain->inhibited = 0;
+  sendPendingEMCY(d);
+}
+
+/*!
+** Send the EMCY of the errors to signal, and the reset once no error is
+** left, one per inhibit time.
+**
+** @param d
+**/
+static void sendPendingEMCY(CO_Data* d)
+{
+  s_emcy_drain* drain = d->emcyDrain;
+  UNS16 inhibit;
+
+  if(!d->CurrentCommunicationState.csEmergency){
+    drain->pendingCount = 0;
+    return;
+  }
+  while(!drain->inhibited){
+    if(drain->pendingCount){
+      sendEMCY(d, drain->pending[0], *d->error_register, NULL, 0);
+      memmove(drain->pending, drain->pending + 1, --drain->pendingCount * sizeof(drain->pending[0]));
+      drain->signalled = 1;
+    }
+    else if(d->error_state == Error_free && drain->signalled){
+      /* "Error Reset or No Error" */
+      sendEMCY(d, 0x0000, 0x00, NULL, 0);
+      drain->signalled = 0;
+    }
+    else
+      return;
+    drain->sent++;
+    inhibit = EMCYInhibitTime(d);
+    if(inhibit){
+      drain->inhibited = 1;
+      drain->inhibitTimer = SetAlarm(d, 0, EMCYInhibitAlarm, US_TO_TIMEVAL((UNS32)inhibit * 100), 0);
+    }
+  }
+}
+
+/*!
+** Apply a post to 0x1001 and 0x1003, the EMCY are sent at the end of the drain.
+**
+** @param d
+** @param post
+**/
+static void applyEMCYPost(CO_Data* d, const s_emcy_post* post)
+{
+  s_emcy_drain* drain = d->emcyDrain;
+  UNS8 i;
+
+  for(i = 0; i < drain->pendingCount && drain->pending[i] != post->errCode; i++)
+    ;
+  if(!post->recovered){
+    switch(_EMCY_raiseError(d, post->errCode, post->errRegMask, post->addInfo)){
+      case 0:
+        if(i == drain->pendingCount && drain->pendingCount < EMCY_MAX_ERRORS)
+          drain->pending[drain->pendingCount++] = post->errCode;
+        break;
+      case 2:
+        drain->coalesced++;
+        break;
+    }
+  }
+  else if(_EMCY_clearError(d, post->errCode) && i < drain->pendingCount){
+    /* Recovered before being signalled */
+    memmove(drain->pending + i, drain->pending + i + 1, (--drain->pendingCount - i) * sizeof(drain->pending[0]));
+    drain->coalesced++;
+  }
+}
+
+/*!
+** Drain the rings of the node, at most one turn of each so that busy
+** producers cannot hold the stack.
+**
+** @param d
+**/
+void _drainEMCYRings(CO_Data* d)
+{
+  s_emcy_drain* drain = d->emcyDrain;
+  s_emcy_ring* ring;
+  s_emcy_post post;
+  UNS32 head;
+
+  for(ring = drain->rings; ring; ring = ring->next){
+    head = RING_LOAD_ACQUIRE(ring->head);
+    while(ring->tail != head){
+      post = ring->cells[ring->tail & ring->mask];
+      RING_STORE_RELEASE(ring->tail, ring->tail + 1);
+      drain->drained++;
+      applyEMCYPost(d, &post);
+    }
+  }
+  sendPendingEMCY(d);
+}
+
+#endif /* CO_ENABLE_EMCY_RING */
@@ -0,0 +1,172 @@
+/*
+  This file is part of CanFestival, a library implementing CanOpen
+  Stack.
+
+  Copyright (C): Edouard TISSERANT and Francis DUPIN
+
+  See COPYING file for copyrights details.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+  USA
+*/
+
+/*!
+** @file   footprint.c
+** @author Edouard TISSERANT and Francis DUPIN
+**
+** @brief CO_Data footprint report, not part of the library
+**
+** Every CO_Data field gets an object of the size of the field, compiled
+** with the configured options. "make footprint" lists them with nm in the
+** order of this file, so the sizes are those of the target even when
+** cross compiling. A new CO_Data field is one CO_DATA_FIELD line here.
+*/
+
+#include "data.h"
+
+/* __COUNTER__ numbers the objects in the order of this file, the extra
+   level expands it before it is pasted in the name */
+#define CO_DATA_OBJECT(n, name, size) \
+	const UNS8 co_data_##n##_##name[size] = {0};
+#define CO_DATA_NUMBERED(n, name, size) CO_DATA_OBJECT(n, name, size)
+#define CO_DATA_SIZE(name, size) CO_DATA_NUMBERED(__COUNTER__, name, size)
+#define CO_DATA_FIELD(field) CO_DATA_SIZE(field, sizeof(((CO_Data*)0)->field))
+
+/* Object dictionary */
+CO_DATA_FIELD(bDeviceNodeId)
+CO_DATA_FIELD(objdict)
+CO_DATA_FIELD(PDO_status)
+CO_DATA_FIELD(RxPDO_EventTimers)
+CO_DATA_FIELD(RxPDO_EventTimers_Handler)
+CO_DATA_FIELD(firstIndex)
+CO_DATA_FIELD(lastIndex)
+CO_DATA_FIELD(ObjdictSize)
+CO_DATA_FIELD(iam_a_slave)
+CO_DATA_FIELD(valueRangeTest)
+
+/* SDO */
+CO_DATA_FIELD(transfers)
+#ifdef CO_ENABLE_SDO_DEFER
+CO_DATA_FIELD(pre_sdoUpload)
+#endif
+#ifdef CO_ENABLE_SDO_BUDGET
+CO_DATA_FIELD(sdoBudget)
+#endif
+#ifdef CO_ENABLE_SDO_ZIP
+CO_DATA_FIELD(sdoZip)
+#endif
+
+/* State machine */
+CO_DATA_FIELD(nodeState)
+CO_DATA_FIELD(CurrentCommunicationState)
+CO_DATA_FIELD(initialisation)
+CO_DATA_FIELD(preOperational)
+CO_DATA_FIELD(operational)
+CO_DATA_FIELD(stopped)
+CO_DATA_FIELD(NMT_Slave_Node_Reset_Callback)
+CO_DATA_FIELD(NMT_Slave_Communications_Reset_Callback)
+
+/* NMT-heartbeat */
+CO_DATA_FIELD(ConsumerHeartbeatCount)
+CO_DATA_FIELD(ConsumerHeartbeatEntries)
+CO_DATA_FIELD(ConsumerHeartBeatTimers)
+CO_DATA_FIELD(ProducerHeartBeatTime)
+CO_DATA_FIELD(ProducerHeartBeatTimer)
+#ifdef CO_ENABLE_SHARED_HEARTBEAT
+CO_DATA_FIELD(heartbeatNext)
+CO_DATA_FIELD(heartbeatDue)
+#endif
+CO_DATA_FIELD(heartbeatError)
+#ifndef CO_PROFILE_SLAVE
+CO_DATA_FIELD(NMTable)
+#endif
+
+/* NMT-nodeguarding */
+CO_DATA_FIELD(GuardTimeTimer)
+CO_DATA_FIELD(LifeTimeTimer)
+CO_DATA_FIELD(nodeguardError)
+CO_DATA_FIELD(GuardTime)
+CO_DATA_FIELD(LifeTimeFactor)
+#ifndef CO_PROFILE_SLAVE
+CO_DATA_FIELD(nodeGuardStatus)
+#endif
+
+/* SYNC */
+CO_DATA_FIELD(syncTimer)
+CO_DATA_FIELD(COB_ID_Sync)
+CO_DATA_FIELD(Sync_Cycle_Period)
+#ifdef CO_ENABLE_TXTIME
+CO_DATA_FIELD(syncLaunchTime)
+CO_DATA_FIELD(txLaunchTime)
+#endif
+CO_DATA_FIELD(post_sync)
+CO_DATA_FIELD(post_TPDO)
+CO_DATA_FIELD(post_SlaveBootup)
+CO_DATA_FIELD(post_SlaveStateChange)
+
+/* General */
+CO_DATA_FIELD(toggle)
+CO_DATA_FIELD(canHandle)
+CO_DATA_FIELD(scanIndexOD)
+CO_DATA_FIELD(storeODSubIndex)
+#ifdef CO_ENABLE_OD_SUBSCRIPTIONS
+CO_DATA_FIELD(odSubscriptions)
+#endif
+#ifdef CO_ENABLE_PDO_REMAP
+CO_DATA_FIELD(pdoRemap)
+#endif
+#ifdef CO_ENABLE_CMD_QUEUE
+CO_DATA_FIELD(cmdQueue)
+#endif
+
+#ifndef CO_PROFILE_SLAVE
+/* DCF concise */
+CO_DATA_FIELD(dcf_odentry)
+CO_DATA_FIELD(dcf_cursor)
+CO_DATA_FIELD(dcf_entries_count)
+CO_DATA_FIELD(dcf_status)
+CO_DATA_FIELD(dcf_size)
+CO_DATA_FIELD(dcf_data)
+CO_DATA_FIELD(dcf_index)
+CO_DATA_FIELD(dcf_value)
+#endif
+
+/* EMCY */
+CO_DATA_FIELD(error_state)
+CO_DATA_FIELD(error_history_size)
+CO_DATA_FIELD(error_number)
+CO_DATA_FIELD(error_first_element)
+CO_DATA_FIELD(error_register)
+CO_DATA_FIELD(error_cobid)
+CO_DATA_FIELD(error_data)
+CO_DATA_FIELD(post_emcy)
+#ifdef CO_ENABLE_EMCY_RING
+CO_DATA_FIELD(error_head)
+CO_DATA_FIELD(emcyDrain)
+#endif
+
+#ifdef CO_ENABLE_HOOK_PROFILE
+CO_DATA_FIELD(hookProfile)
+#endif
+
+#ifdef CO_ENABLE_LSS
+/* LSS */
+CO_DATA_FIELD(lss_transfer)
+CO_DATA_FIELD(lss_StoreConfiguration)
+#endif
+
+/* The total also counts the alignment padding between the fields */
+CO_DATA_SIZE(sdo_line, sizeof(s_transfer))
+CO_DATA_SIZE(total, sizeof(CO_Data))
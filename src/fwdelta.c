@@ -0,0 +1,555 @@
+/*
+This file is part of CanFestival, a library implementing CanOpen Stack.
+
+Copyright (C): Edouard TISSERANT and Francis DUPIN
+
+See COPYING file for copyrights details.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+USA
+*/
+
+/*!
+** @file   fwdelta.c
+** @author Edouard TISSERANT and Francis DUPIN
+**
+** @brief Delta firmware update
+**
+** The delta is made of copies from the base image and of new bytes. The
+** hash of the master holds positions of the base sampled every step bytes,
+** so that it fits whatever the size of the base: a common run of at least
+** step bytes holds a sampled position, and the copy found there is
+** extended back over the new bytes before it. Code inserted or removed
+** shifts the rest of the image, so the copy following the previous one in
+** the base is tried first.
+*/
+
+#include <string.h>
+#include "data.h"
+#include "fwdelta.h"
+#include "objacces.h"
+
+#ifdef CO_ENABLE_FW_DELTA
+
+/* Update contexts and nodes, to find them in the callbacks */
+static s_fw_delta* fwDeltas = NULL;
+static s_fw_delta_node* fwDeltaNodes = NULL;
+
+static const UNS32 fwDeltaCRCTable[16] = {
+  0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+  0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+  0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+  0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+/*!
+**
+**
+** @param crc
+** @param data
+** @param size
+**
+** @return
+**/
+UNS32 fwDeltaCRC(UNS32 crc, const UNS8* data, UNS32 size)
+{
+  crc = ~crc;
+  while(size--){
+    crc ^= *data++;
+    crc = (crc >> 4) ^ fwDeltaCRCTable[crc & 0x0F];
+    crc = (crc >> 4) ^ fwDeltaCRCTable[crc & 0x0F];
+  }
+  return ~crc;
+}
+
+/*!
+**
+**
+** @param p
+**
+** @return UNS32 little endian at p
+**/
+static UNS32 fwDeltaGet(const UNS8* p)
+{
+  return (UNS32)p[0] | ((UNS32)p[1] << 8) | ((UNS32)p[2] << 16) | ((UNS32)p[3] << 24);
+}
+
+/*!
+**
+**
+** @param p
+** @param v
+**/
+static void fwDeltaPut(UNS8* p, UNS32 v)
+{
+  p[0] = (UNS8)v;
+  p[1] = (UNS8)(v >> 8);
+  p[2] = (UNS8)(v >> 16);
+  p[3] = (UNS8)(v >> 24);
+}
+
+/*!
+**
+**
+** @param p Four bytes
+**
+** @return
+**/
+static UNS32 fwDeltaHash(const UNS8* p)
+{
+  return (fwDeltaGet(p) * 2654435761U) >> (32 - FW_DELTA_HASH_BITS);
+}
+
+/*!
+**
+**
+** @param a
+** @param b
+** @param max
+**
+** @return Number of equal bytes at a and b
+**/
+static UNS32 fwDeltaMatch(const UNS8* a, const UNS8* b, UNS32 max)
+{
+  UNS32 len;
+
+  for(len = 0; len < max && a[len] == b[len]; len++)
+    ;
+  return len;
+}
+
+/*!
+** Add the new bytes from..to of the image to the delta.
+**
+** @param out
+** @param outSize
+** @param o Bytes of the delta
+** @param data
+** @param n
+**
+** @return 0 if OK, 0xFF if the delta does not fit
+**/
+static UNS8 fwDeltaAdd(UNS8* out, UNS32 outSize, UNS32* o, const UNS8* data, UNS32 n)
+{
+  if(!n)
+    return 0;
+  if(n > outSize || 5 + n > outSize - *o)
+    return 0xFF;
+  out[*o] = FW_DELTA_ADD;
+  fwDeltaPut(out + *o + 1, n);
+  memcpy(out + *o + 5, data, n);
+  *o += 5 + n;
+  return 0;
+}
+
+/*!
+**
+**
+** @param fw
+** @param base
+** @param baseSize
+** @param image
+** @param size
+** @param out
+** @param outSize
+**
+** @return
+**/
+UNS32 fwDeltaEncode(s_fw_delta* fw, const UNS8* base, UNS32 baseSize, const UNS8* image, UNS32 size,
+		UNS8* out, UNS32 outSize)
+{
+  UNS32 step = (baseSize >> FW_DELTA_HASH_BITS) + 1;
+  UNS32 o = FW_DELTA_HEADER;
+  UNS32 pos = 0;
+  UNS32 lit = 0;   /* first new byte not in the delta yet */
+  UNS32 next = 0;  /* base position following the previous copy */
+  UNS32 len, off, cand, l, i;
+
+  if(outSize < FW_DELTA_HEADER + 1)
+    return 0;
+  memset(fw->hash, 0, sizeof(fw->hash));
+  for(i = 0; baseSize >= 4 && i <= baseSize - 4; i += step)
+    fw->hash[fwDeltaHash(base + i)] = i + 1;
+
+  while(pos < size){
+    len = 0;
+    off = next;
+    if(next < baseSize)
+      len = fwDeltaMatch(base + next, image + pos, baseSize - next < size - pos ? baseSize - next : size - pos);
+    if(len < FW_DELTA_MIN_MATCH && size - pos >= 4){
+      cand = fw->hash[fwDeltaHash(image + pos)];
+      if(cand--){
+        l = fwDeltaMatch(base + cand, image + pos, baseSize - cand < size - pos ? baseSize - cand : size - pos);
+        if(l > len){
+          len = l;
+          off = cand;
+        }
+      }
+    }
+    if(len < FW_DELTA_MIN_MATCH){
+      pos++;
+      next++;
+      continue;
+    }
+    while(pos > lit && off && image[pos - 1] == base[off - 1]){
+      pos--;
+      off--;
+      len++;
+    }
+    if(fwDeltaAdd(out, outSize, &o, image + lit, pos - lit) || outSize - o < 9)
+      return 0;
+    out[o] = FW_DELTA_COPY;
+    fwDeltaPut(out + o + 1, off);
+    fwDeltaPut(out + o + 5, len);
+    o += 9;
+    pos += len;
+    lit = pos;
+    next = off + len;
+  }
+  if(fwDeltaAdd(out, outSize, &o, image + lit, size - lit) || o == outSize)
+    return 0;
+  out[o++] = FW_DELTA_END;
+
+  fwDeltaPut(out, FW_DELTA_MAGIC);
+  fwDeltaPut(out + 4, o);
+  fwDeltaPut(out + 8, baseSize);
+  fwDeltaPut(out + 12, fwDeltaCRC(0, base, baseSize));
+  fwDeltaPut(out + 16, size);
+  fwDeltaPut(out + 20, fwDeltaCRC(0, image, size));
+  return o;
+}
+
+/*!
+**
+**
+** @param base
+** @param baseSize
+** @param delta
+** @param deltaSize
+** @param out
+** @param outSize
+** @param size
+**
+** @return
+**/
+UNS32 fwDeltaApply(const UNS8* base, UNS32 baseSize, const UNS8* delta, UNS32 deltaSize,
+		UNS8* out, UNS32 outSize, UNS32* size)
+{
+  UNS32 end, newSize, n = 0, p = FW_DELTA_HEADER, off, len;
+
+  if(deltaSize < FW_DELTA_HEADER + 1 || fwDeltaGet(delta) != FW_DELTA_MAGIC)
+    return FW_DELTA_ABT_CORRUPT;
+  end = fwDeltaGet(delta + 4);
+  if(end > deltaSize || end < FW_DELTA_HEADER + 1)
+    return FW_DELTA_ABT_CORRUPT;
+  if(fwDeltaGet(delta + 8) != baseSize || fwDeltaGet(delta + 12) != fwDeltaCRC(0, base, baseSize))
+    return FW_DELTA_ABT_BASE;
+  newSize = fwDeltaGet(delta + 16);
+  if(newSize > outSize)
+    return SDOABT_OUT_OF_MEMORY;
+
+  while(p < end){
+    switch(delta[p]){
+    case FW_DELTA_END:
+      if(p + 1 != end || n != newSize || fwDeltaCRC(0, out, n) != fwDeltaGet(delta + 20))
+        return FW_DELTA_ABT_CORRUPT;
+      *size = n;
+      return 0;
+    case FW_DELTA_COPY:
+      if(end - p < 9)
+        return FW_DELTA_ABT_CORRUPT;
+      off = fwDeltaGet(delta + p + 1);
+      len = fwDeltaGet(delta + p + 5);
+      if(off > baseSize || len > baseSize - off || len > newSize - n)
+        return FW_DELTA_ABT_CORRUPT;
+      memcpy(out + n, base + off, len);
+      p += 9;
+      break;
+    case FW_DELTA_ADD:
+      if(end - p < 5)
+        return FW_DELTA_ABT_CORRUPT;
+      len = fwDeltaGet(delta + p + 1);
+      if(len > end - p - 5 || len > newSize - n)
+        return FW_DELTA_ABT_CORRUPT;
+      memcpy(out + n, delta + p + 5, len);
+      p += 5 + len;
+      break;
+    default:
+      return FW_DELTA_ABT_CORRUPT;
+    }
+    n += len;
+  }
+  return FW_DELTA_ABT_CORRUPT;
+}
+
+/*!
+**
+**
+** @param fw
+** @param bases
+** @param basesCount
+** @param delta
+** @param deltaMax
+**/
+void initFwDelta(s_fw_delta* fw, s_fw_image* bases, UNS8 basesCount, UNS8* delta, UNS32 deltaMax)
+{
+  s_fw_delta** f;
+  UNS8 i;
+
+  for(f = &fwDeltas; *f; f = &(*f)->next)
+    if(*f == fw){
+      *f = fw->next;
+      break;
+    }
+  memset(fw, 0, sizeof(*fw));
+  fw->bases = bases;
+  fw->basesCount = basesCount;
+  fw->delta = delta;
+  fw->deltaMax = deltaMax;
+  for(i = 0; i < basesCount; i++)
+    bases[i].crc = fwDeltaCRC(0, bases[i].data, bases[i].size);
+  fw->next = fwDeltas;
+  fwDeltas = fw;
+}
+
+/*!
+** Update of a node in progress.
+**
+** @param d
+** @param nodeId
+**
+** @return The context, NULL if none
+**/
+static s_fw_delta* findFwDelta(CO_Data* d, UNS8 nodeId)
+{
+  s_fw_delta* fw;
+
+  for(fw = fwDeltas; fw; fw = fw->next)
+    if(fw->d == d && fw->nodeId == nodeId && fw->state != FW_DELTA_IDLE)
+      return fw;
+  return NULL;
+}
+
+/*!
+**
+**
+** @param fw
+** @param abortCode
+**/
+static void fwDeltaEnd(s_fw_delta* fw, UNS32 abortCode)
+{
+  fw->state = FW_DELTA_IDLE;
+  if(!abortCode){
+    if(fw->deltaSize){
+      fw->deltaUpdates++;
+      fw->sentBytes += fw->deltaSize;
+    }
+    else{
+      fw->fullUpdates++;
+      fw->sentBytes += fw->size;
+    }
+    fw->imageBytes += fw->size;
+  }
+  else
+    MSG_WAR(0x3F31, "Firmware update failed, node : ", fw->nodeId);
+  if(fw->done)
+    (*fw->done)(fw, fw->nodeId, abortCode);
+}
+
+static void fwDeltaWriteCallback(CO_Data* d, UNS8 nodeId);
+
+/*!
+**
+**
+** @param fw
+**/
+static void fwDeltaWriteFull(s_fw_delta* fw)
+{
+  fw->state = FW_DELTA_FULL;
+  fw->deltaSize = 0;
+  if(writeNetworkDictCallBack(fw->d, fw->nodeId, FW_PROGRAM_INDEX, FW_PROGRAM_SUBINDEX, fw->size, domain,
+		  (void*)fw->image, fwDeltaWriteCallback, 1))
+    fwDeltaEnd(fw, SDOABT_LOCAL_CTRL_ERROR);
+}
+
+/*!
+** Result of the download of the delta or of the image.
+**
+** @param d
+** @param nodeId
+**/
+static void fwDeltaWriteCallback(CO_Data* d, UNS8 nodeId)
+{
+  s_fw_delta* fw = findFwDelta(d, nodeId);
+  UNS32 abortCode = 0;
+  UNS8 res;
+
+  res = getWriteResultNetworkDict(d, nodeId, &abortCode);
+  closeSDOtransfer(d, nodeId, SDO_CLIENT);
+  if(!fw)
+    return;
+  if(res == SDO_FINISHED)
+    abortCode = 0;
+  else if(!abortCode)
+    abortCode = SDOABT_GENERAL_ERROR;
+  /* Node without the delta object */
+  if(fw->state == FW_DELTA_DELTA && (abortCode == OD_NO_SUCH_OBJECT || abortCode == OD_NO_SUCH_SUBINDEX)){
+    MSG_WAR(0x3F32, "No delta object, whole image to node : ", nodeId);
+    fwDeltaWriteFull(fw);
+    return;
+  }
+  fwDeltaEnd(fw, abortCode);
+}
+
+/*!
+** Identification of the node read, send the delta or the image.
+**
+** @param d
+** @param nodeId
+**/
+static void fwDeltaIdentCallback(CO_Data* d, UNS8 nodeId)
+{
+  s_fw_delta* fw = findFwDelta(d, nodeId);
+  UNS32 crc = 0;
+  UNS32 size = sizeof(crc);
+  UNS32 abortCode;
+  UNS8 res, i;
+
+  res = getReadResultNetworkDict(d, nodeId, &crc, &size, &abortCode);
+  closeSDOtransfer(d, nodeId, SDO_CLIENT);
+  if(!fw)
+    return;
+  fw->deltaSize = 0;
+  if(res == SDO_FINISHED && size == sizeof(crc))
+    for(i = 0; i < fw->basesCount; i++)
+      if(fw->bases[i].crc == crc){
+        fw->deltaSize = fwDeltaEncode(fw, fw->bases[i].data, fw->bases[i].size, fw->image, fw->size,
+				fw->delta, fw->deltaMax < fw->size ? fw->deltaMax : fw->size);
+        break;
+      }
+  if(!fw->deltaSize){
+    fwDeltaWriteFull(fw);
+    return;
+  }
+  MSG_WAR(0x3F33, "Firmware delta bytes : ", fw->deltaSize);
+  fw->state = FW_DELTA_DELTA;
+  if(writeNetworkDictCallBack(d, nodeId, FW_DELTA_INDEX, FW_DELTA_SUBINDEX, fw->deltaSize, domain,
+		  fw->delta, fwDeltaWriteCallback, 1))
+    fwDeltaEnd(fw, SDOABT_LOCAL_CTRL_ERROR);
+}
+
+/*!
+**
+**
+** @param fw
+** @param d
+** @param nodeId
+** @param image
+** @param size
+** @param done
+**
+** @return
+**/
+UNS8 fwDeltaUpdate(s_fw_delta* fw, CO_Data* d, UNS8 nodeId, const UNS8* image, UNS32 size, fwDeltaDone_t done)
+{
+  if(fw->state != FW_DELTA_IDLE){
+    MSG_ERR(0x1F34, "Firmware update in progress, node : ", fw->nodeId);
+    return 0xFF;
+  }
+  fw->d = d;
+  fw->nodeId = nodeId;
+  fw->image = image;
+  fw->size = size;
+  fw->done = done;
+  fw->deltaSize = 0;
+  fw->state = FW_DELTA_IDENT;
+  if(readNetworkDictCallback(d, nodeId, FW_DELTA_IDENT_INDEX, FW_DELTA_IDENT_SUBINDEX, 0, fwDeltaIdentCallback, 0)){
+    fw->state = FW_DELTA_IDLE;
+    return 0xFF;
+  }
+  return 0;
+}
+
+/*!
+** Delta written in the domain, rebuild the image.
+**
+** @param d
+** @param od
+** @param bSubindex
+**
+** @return
+**/
+static UNS32 fwDeltaNodeCallback(CO_Data* d, const indextable* od, UNS8 bSubindex)
+{
+  s_fw_delta_node* node;
+  UNS32 abortCode, size;
+
+  for(node = fwDeltaNodes; node && node->d != d; node = node->next)
+    ;
+  if(!node)
+    return OD_SUCCESSFUL;
+  node->stagedSize = 0;
+  abortCode = fwDeltaApply(node->image, node->size, (const UNS8*)od->pSubindex[bSubindex].pObject,
+		  od->pSubindex[bSubindex].size, node->staging, node->stagingSize, &size);
+  if(abortCode){
+    MSG_WAR(0x3F35, "Firmware delta refused : ", abortCode);
+    return abortCode;
+  }
+  node->stagedSize = size;
+  if(node->staged)
+    (*node->staged)(d, node->staging, size);
+  return OD_SUCCESSFUL;
+}
+
+/*!
+**
+**
+** @param d
+** @param node
+** @param image
+** @param size
+** @param staging
+** @param stagingSize
+** @param staged
+**
+** @return
+**/
+UNS32 initFwDeltaNode(CO_Data* d, s_fw_delta_node* node, const UNS8* image, UNS32 size,
+		UNS8* staging, UNS32 stagingSize, fwDeltaStaged_t staged)
+{
+  s_fw_delta_node** n;
+  UNS32 ident = sizeof(UNS32);
+
+  for(n = &fwDeltaNodes; *n; n = &(*n)->next)
+    if(*n == node){
+      *n = node->next;
+      break;
+    }
+  node->d = d;
+  node->image = image;
+  node->size = size;
+  node->crc = fwDeltaCRC(0, image, size);
+  node->staging = staging;
+  node->stagingSize = stagingSize;
+  node->stagedSize = 0;
+  node->staged = staged;
+  /* The identification is optional */
+  writeLocalDict(d, FW_DELTA_IDENT_INDEX, FW_DELTA_IDENT_SUBINDEX, &node->crc, &ident, 0);
+  node->next = fwDeltaNodes;
+  fwDeltaNodes = node;
+  return RegisterSetODentryCallBack(d, FW_DELTA_INDEX, FW_DELTA_SUBINDEX, fwDeltaNodeCallback);
+}
+
+#endif /* CO_ENABLE_FW_DELTA */
@@ -0,0 +1,297 @@
+/*
+This file is part of CanFestival, a library implementing CanOpen Stack.
+
+Copyright (C): Edouard TISSERANT and Francis DUPIN
+
+See COPYING file for copyrights details.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+USA
+*/
+
+/*!
+** @file   hookprofile.c
+** @author Edouard TISSERANT and Francis DUPIN
+**
+** @brief Hook profiler
+**
+** The times are kept in ns on 32 bits, the difference of two readings of
+** the clock being right across its wrap-around, so a hook must return
+** within 4 s to be timed right.
+*/
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include "data.h"
+#include "hookprofile.h"
+
+#ifdef CO_ENABLE_HOOK_PROFILE
+
+static const char* const hookNames[HOOK_COUNT] = {
+  "initialisation",
+  "preOperational",
+  "operational",
+  "stopped",
+  "post_sync",
+  "post_TPDO",
+  "post_emcy",
+  "heartbeatError",
+  "nodeguardError",
+  "post_SlaveBootup",
+  "post_SlaveStateChange",
+  "storeODSubIndex",
+  "SDO callbacks",
+  "OD callbacks",
+};
+
+/*!
+**
+**
+** @param d
+** @param profile
+** @param overrun
+**/
+void initHookProfile(CO_Data* d, s_hook_profile* profile, hookOverrun_t overrun)
+{
+  d->hookProfile = profile;
+  if(!profile)
+    return;
+  memset(profile, 0, sizeof(*profile));
+  profile->overrun = overrun;
+  resetHookProfile(d);
+}
+
+/*!
+**
+**
+** @param d
+** @param hook
+** @param us
+**
+** @return
+**/
+UNS8 setHookBudget(CO_Data* d, UNS8 hook, UNS32 us)
+{
+  if(!d->hookProfile || hook >= HOOK_COUNT){
+    MSG_ERR(0x1F70, "Invalid hook : ", hook);
+    return 0xFF;
+  }
+  d->hookProfile->budget[hook] = us > 0xFFFFFFFF / 1000 ? 0xFFFFFFFF : us * 1000;
+  return 0;
+}
+
+/*!
+**
+**
+** @param d
+**/
+void resetHookProfile(CO_Data* d)
+{
+  s_hook_profile* profile = d->hookProfile;
+  UNS8 i;
+
+  if(!profile)
+    return;
+  memset(profile->slots, 0, sizeof(profile->slots));
+  for(i = 0; i < HOOK_COUNT; i++)
+    profile->slots[i].hook = i;
+  profile->slotsCount = HOOK_COUNT;
+  profile->objectsDropped = 0;
+}
+
+/*!
+** Monotonic clock, in ns.
+**
+** @return
+**/
+static UNS32 hookProfileNow(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (UNS32)ts.tv_sec * 1000000000u + (UNS32)ts.tv_nsec;
+}
+
+/*!
+**
+**
+** @param d
+**
+** @return
+**/
+UNS32 _hookProfileStart(CO_Data* d)
+{
+  return d->hookProfile ? hookProfileNow() : 0;
+}
+
+/*!
+**
+**
+** @param stats
+** @param ns
+** @param budget
+**/
+static void hookProfileCount(s_hook_stats* stats, UNS32 ns, UNS32 budget)
+{
+  UNS32 us = ns / 1000;
+  UNS8 bucket = 0;
+
+  while(us && bucket < HOOK_PROFILE_BUCKETS - 1){
+    us >>= 1;
+    bucket++;
+  }
+  stats->histogram[bucket]++;
+  stats->calls++;
+  stats->total += ns;
+  if(ns > stats->worst)
+    stats->worst = ns;
+  if(budget && ns > budget)
+    stats->overruns++;
+}
+
+/*!
+** Statistics of the callbacks of an object, NULL if no slot is left.
+**
+** @param profile
+** @param hook
+** @param index
+** @param subIndex
+**
+** @return
+**/
+static s_hook_stats* hookProfileObject(s_hook_profile* profile, UNS8 hook, UNS16 index, UNS8 subIndex)
+{
+  s_hook_stats* stats;
+  UNS8 i;
+
+  for(i = HOOK_COUNT; i < profile->slotsCount; i++){
+    stats = &profile->slots[i];
+    if(stats->hook == hook && stats->index == index && stats->subIndex == subIndex)
+      return stats;
+  }
+  if(profile->slotsCount == HOOK_PROFILE_SLOTS){
+    if(profile->objectsDropped < 0xFF)
+      profile->objectsDropped++;
+    return NULL;
+  }
+  stats = &profile->slots[profile->slotsCount++];
+  stats->hook = hook;
+  stats->index = index;
+  stats->subIndex = subIndex;
+  return stats;
+}
+
+/*!
+**
+**
+** @param d
+** @param hook
+** @param index
+** @param subIndex
+** @param start
+**/
+void _hookProfileEnd(CO_Data* d, UNS8 hook, UNS16 index, UNS8 subIndex, UNS32 start)
+{
+  s_hook_profile* profile = d->hookProfile;
+  s_hook_stats* stats;
+  UNS32 ns, budget;
+
+  /* Profile given or taken back by the hook */
+  if(!profile || !start)
+    return;
+  ns = hookProfileNow() - start;
+  budget = profile->budget[hook];
+  hookProfileCount(&profile->slots[hook], ns, budget);
+  if(hook == HOOK_SDO || hook == HOOK_OD){
+    stats = hookProfileObject(profile, hook, index, subIndex);
+    if(stats)
+      hookProfileCount(stats, ns, budget);
+  }
+  if(budget && ns > budget){
+    MSG_WAR(0x2F71, "Hook over its budget, ns : ", ns);
+    if(profile->overrun)
+      (*profile->overrun)(d, hook, index, subIndex, ns);
+  }
+}
+
+/*!
+** Append to the report, as much as fits.
+**
+** @param buf
+** @param size
+** @param len
+** @param format
+**/
+static void hookReport(char* buf, UNS32 size, UNS32* len, const char* format, ...)
+{
+  va_list args;
+  int n;
+
+  if(*len + 1 >= size)
+    return;
+  va_start(args, format);
+  n = vsnprintf(buf + *len, size - *len, format, args);
+  va_end(args);
+  if(n > 0)
+    *len = *len + n < size ? *len + n : size - 1;
+}
+
+/*!
+**
+**
+** @param d
+** @param buf
+** @param size
+**
+** @return
+**/
+UNS32 hookProfileReport(CO_Data* d, char* buf, UNS32 size)
+{
+  s_hook_profile* profile = d->hookProfile;
+  s_hook_stats* stats;
+  UNS32 len = 0;
+  char name[32];
+  UNS8 i, j;
+
+  if(!profile || !size)
+    return 0;
+  buf[0] = 0;
+  hookReport(buf, size, &len, "%-22s %8s %9s %9s %9s %8s  histogram <1us <2us <4us ...\n",
+		  "hook", "calls", "mean us", "worst us", "budget us", "overruns");
+  for(i = 0; i < profile->slotsCount; i++){
+    stats = &profile->slots[i];
+    if(!stats->calls)
+      continue;
+    if(i < HOOK_COUNT)
+      snprintf(name, sizeof(name), "%s", hookNames[i]);
+    else
+      snprintf(name, sizeof(name), "  %s 0x%04X/%u", stats->hook == HOOK_SDO ? "SDO" : "OD",
+		      stats->index, stats->subIndex);
+    hookReport(buf, size, &len, "%-22s %8lu %9.1f %9.1f %9lu %8lu ", name, (unsigned long)stats->calls,
+		    (double)stats->total / stats->calls / 1000, stats->worst / 1000.0,
+		    (unsigned long)(profile->budget[stats->hook] / 1000), (unsigned long)stats->overruns);
+    for(j = 0; j < HOOK_PROFILE_BUCKETS; j++)
+      hookReport(buf, size, &len, " %lu", (unsigned long)stats->histogram[j]);
+    hookReport(buf, size, &len, "\n");
+  }
+  if(profile->objectsDropped)
+    hookReport(buf, size, &len, "%u objects without statistics, HOOK_PROFILE_SLOTS is %u\n",
+		    profile->objectsDropped, HOOK_PROFILE_SLOTS);
+  return len;
+}
+
+#endif /* CO_ENABLE_HOOK_PROFILE */
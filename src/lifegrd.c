@@ -44,14 +44,16 @@ void ConsumerHeartbeatAlarm(CO_Data* d, UNS32 id);
 void ProducerHeartbeatAlarm(CO_Data* d, UNS32 id);
 UNS32 OnHearbeatProducerUpdate(CO_Data* d, const indextable * unused_indextable, UNS8 unused_bSubindex);
 
+#ifndef CO_PROFILE_SLAVE
 void GuardTimeAlarm(CO_Data* d, UNS32 id);
+#endif
 UNS32 OnNodeGuardUpdate(CO_Data* d, const indextable * unused_indextable, UNS8 unused_bSubindex);
 
 
 e_nodeState getNodeState (CO_Data* d, UNS8 nodeId)
 {
   e_nodeState networkNodeState = Unknown_state;
-  #if NMT_MAX_NODE_ID>0
+  #if NMT_MAX_NODE_ID>0 && !defined(CO_PROFILE_SLAVE)
   if(nodeId < NMT_MAX_NODE_ID)
     networkNodeState = d->NMTable[nodeId];
   #endif
@@ -74,10 +76,12 @@ void ConsumerHeartbeatAlarm(CO_Data* d, UNS32 id)
   /* -> avoid deleting re-assigned timer if message is received too late*/
   d->ConsumerHeartBeatTimers[id]=TIMER_NONE;
   
+#ifndef CO_PROFILE_SLAVE
   /* set node state */
   d->NMTable[nodeId] = Disconnected;
+#endif
   /*! call heartbeat error with NodeId */
-  (*d->heartbeatError)(d, nodeId);
+  PROFILE_HOOK(d, HOOK_HEARTBEAT_ERROR, 0, 0, (*d->heartbeatError)(d, nodeId));
 }
 
 void proceedNODE_GUARD(CO_Data* d, Message* m )
@@ -122,6 +126,7 @@ void proceedNODE_GUARD(CO_Data* d, Message* m )
 
       MSG_WAR(0x3110, "Received NMT nodeId : ", nodeId);
       
+#ifndef CO_PROFILE_SLAVE
       /*!
       ** Record node response for node guarding service
       */
@@ -129,13 +134,14 @@ void proceedNODE_GUARD(CO_Data* d, Message* m )
 
       if (d->NMTable[nodeId] != newNodeState)
       {
-        (*d->post_SlaveStateChange)(d, nodeId, newNodeState);
+        PROFILE_HOOK(d, HOOK_POST_SLAVE_STATE_CHANGE, 0, 0, (*d->post_SlaveStateChange)(d, nodeId, newNodeState));
         /* the slave's state receievd is stored in the NMTable */
         d->NMTable[nodeId] = newNodeState;
       }
+#endif
 
       /* Boot-Up frame reception */
-      if ( d->NMTable[nodeId] == Initialisation)
+      if ( newNodeState == Initialisation)
       {
           /*
           ** The device send the boot-up message (Initialisation)
@@ -144,10 +150,10 @@ void proceedNODE_GUARD(CO_Data* d, Message* m )
           */
           MSG_WAR(0x3100, "The NMT is a bootup from node : ", nodeId);
           /* call post SlaveBootup with NodeId */
-		  (*d->post_SlaveBootup)(d, nodeId);
+		  PROFILE_HOOK(d, HOOK_POST_SLAVE_BOOTUP, 0, 0, (*d->post_SlaveBootup)(d, nodeId));
       }
 
-      if( d->NMTable[nodeId] != Unknown_state ) {
+      if( newNodeState != Unknown_state ) {
         UNS8 index, ConsumerHeartBeat_nodeId ;
         for( index = (UNS8)0x00; index < *d->ConsumerHeartbeatCount; index++ )
           {
@@ -157,7 +163,7 @@ void proceedNODE_GUARD(CO_Data* d, Message* m )
                 TIMEVAL time = ( (d->ConsumerHeartbeatEntries[index]) & (UNS32)0x0000FFFF ) ;
                 /* Renew alarm for next heartbeat. */
                 DelAlarm(d->ConsumerHeartBeatTimers[index]);
-                d->ConsumerHeartBeatTimers[index] = SetAlarm(d, index, &ConsumerHeartbeatAlarm, MS_TO_TIMEVAL(time), 0);
+                d->ConsumerHeartBeatTimers[index] = SetAlarmWithSlack(d, index, &ConsumerHeartbeatAlarm, MS_TO_TIMEVAL(time), 0, TIMER_SLACK(MS_TO_TIMEVAL(time)));
               }
           }
       }
@@ -195,6 +201,146 @@ void ProducerHeartbeatAlarm(CO_Data* d, UNS32 id)
     }
 }
 
+#ifdef CO_ENABLE_SHARED_HEARTBEAT
+/* Heartbeats sent with one call to the driver */
+#define HEARTBEAT_BATCH 32
+
+/* Nodes of the process that produce a heartbeat, and the alarm that sends them */
+static CO_Data* heartbeat_producers = NULL;
+static UNS16 heartbeat_producers_count = 0;
+static TIMER_HANDLE heartbeat_tick_timer = TIMER_NONE;
+static UNS32 heartbeat_tick = 0;
+/* Time of the service in ms, advanced by heartbeat_tick on each tick */
+static UNS32 heartbeat_time = 0;
+
+/*! Send a batch of heartbeats, all on the same CAN port
+**
+** @param msgs
+** @param count
+** @param port
+**/
+static void HeartbeatFlush(Message* msgs, UNS16 count, CAN_PORT port)
+{
+  if(count && canSendBatch(port, msgs, count) != count)
+    MSG_ERR(0x1130, "Heartbeats not all sent: ", count);
+}
+
+/*! The shared Producer Timer Callback
+**
+** Sends the heartbeats that are due, batched by CAN port, then schedules
+** the next heartbeat of each of these nodes one period later.
+**
+** @param unused_d
+** @param unused_id
+ * @ingroup heartbeato
+**/
+static void SharedHeartbeatAlarm(CO_Data* unused_d, UNS32 unused_id)
+{
+  Message msgs[HEARTBEAT_BATCH];
+  UNS16 count = 0;
+  CAN_PORT port = NULL;
+  CO_Data* d;
+
+  heartbeat_time += heartbeat_tick;
+  for(d = heartbeat_producers; d; d = d->heartbeatNext)
+    {
+      UNS16 tmp;
+      if((INTEGER32)(heartbeat_time - d->heartbeatDue) < 0)
+        continue;
+      /* Keep the phase given at registration */
+      d->heartbeatDue += *d->ProducerHeartBeatTime;
+      if((INTEGER32)(heartbeat_time - d->heartbeatDue) >= 0)
+        d->heartbeatDue = heartbeat_time + *d->ProducerHeartBeatTime;
+      if(count == HEARTBEAT_BATCH || (count && d->canHandle != port))
+        {
+          HeartbeatFlush(msgs, count, port);
+          count = 0;
+        }
+      port = d->canHandle;
+      tmp = *d->bDeviceNodeId + 0x700;
+      msgs[count].cob_id = UNS16_LE(tmp);
+      msgs[count].len = (UNS8)0x01;
+      msgs[count].rtr = 0;
+      msgs[count].data[0] = d->nodeState; /* No toggle for heartbeat !*/
+      count++;
+    }
+  HeartbeatFlush(msgs, count, port);
+}
+
+/*! Arm the shared alarm for the registered producers
+**
+** The tick spreads the heartbeats of the shortest period over the period,
+** but is never shorter than HEARTBEAT_TICK_MS.
+**/
+static void HeartbeatRearm(void)
+{
+  UNS32 tick = 0;
+  CO_Data* d;
+
+  for(d = heartbeat_producers; d; d = d->heartbeatNext)
+    if(!tick || *d->ProducerHeartBeatTime < tick)
+      tick = *d->ProducerHeartBeatTime;
+  if(heartbeat_producers_count)
+    tick /= heartbeat_producers_count;
+  if(tick < HEARTBEAT_TICK_MS)
+    tick = HEARTBEAT_TICK_MS;
+
+  if(!heartbeat_producers)
+    {
+      heartbeat_tick_timer = DelAlarm(heartbeat_tick_timer);
+      heartbeat_tick = 0;
+    }
+  else if(tick != heartbeat_tick || heartbeat_tick_timer == TIMER_NONE)
+    {
+      DelAlarm(heartbeat_tick_timer);
+      heartbeat_tick = tick;
+      heartbeat_tick_timer = SetAlarm(NULL, 0, &SharedHeartbeatAlarm, MS_TO_TIMEVAL(tick), MS_TO_TIMEVAL(tick));
+    }
+}
+
+/*! Remove a node from the shared heartbeat producer
+**
+** @param d
+ * @ingroup heartbeato
+**/
+static void HeartbeatUnregister(CO_Data* d)
+{
+  CO_Data** p;
+
+  for(p = &heartbeat_producers; *p; p = &(*p)->heartbeatNext)
+    if(*p == d)
+      {
+        *p = d->heartbeatNext;
+        d->heartbeatNext = NULL;
+        heartbeat_producers_count--;
+        HeartbeatRearm();
+        return;
+      }
+}
+/*! Add a node to the shared heartbeat producer
+**
+** Its first heartbeat is sent one period later, shifted by a tick per
+** already registered node so that the heartbeats are spread on the bus.
+**
+** @param d
+ * @ingroup heartbeato
+**/
+static void HeartbeatRegister(CO_Data* d)
+{
+  UNS32 period = *d->ProducerHeartBeatTime;
+  UNS32 tick = heartbeat_tick ? heartbeat_tick : HEARTBEAT_TICK_MS;
+
+  HeartbeatUnregister(d);
+  d->heartbeatDue = heartbeat_time + period + (heartbeat_producers_count * tick) % period;
+  d->heartbeatNext = heartbeat_producers;
+  heartbeat_producers = d;
+  heartbeat_producers_count++;
+  HeartbeatRearm();
+}
+
+#endif
+
+#ifndef CO_PROFILE_SLAVE
 /**
  * @brief The guardTime - Timer Callback.
  * 
@@ -230,7 +376,7 @@ void GuardTimeAlarm(CO_Data* d, UNS32 id)
 
           // Call error-callback function
           if (*d->nodeguardError) {
-            (*d->nodeguardError)(d, i);
+            PROFILE_HOOK(d, HOOK_NODEGUARD_ERROR, 0, 0, (*d->nodeguardError)(d, i));
           }
 
           // Mark node as disconnected
@@ -251,6 +397,7 @@ void GuardTimeAlarm(CO_Data* d, UNS32 id)
 
 
 }
+#endif
 
 /**
  * This function is called, if index 0x100C or 0x100D is updated to
@@ -299,14 +446,18 @@ void heartbeatInit(CO_Data* d)
       TIMEVAL time = (UNS16) ( (d->ConsumerHeartbeatEntries[index]) & (UNS32)0x0000FFFF ) ;
       if ( time )
         {
-          d->ConsumerHeartBeatTimers[index] = SetAlarm(d, index, &ConsumerHeartbeatAlarm, MS_TO_TIMEVAL(time), 0);
+          d->ConsumerHeartBeatTimers[index] = SetAlarmWithSlack(d, index, &ConsumerHeartbeatAlarm, MS_TO_TIMEVAL(time), 0, TIMER_SLACK(MS_TO_TIMEVAL(time)));
         }
     }
 
   if ( *d->ProducerHeartBeatTime )
     {
+#ifdef CO_ENABLE_SHARED_HEARTBEAT
+      HeartbeatRegister(d);
+#else
       TIMEVAL time = *d->ProducerHeartBeatTime;
-      d->ProducerHeartBeatTimer = SetAlarm(d, 0, &ProducerHeartbeatAlarm, MS_TO_TIMEVAL(time), MS_TO_TIMEVAL(time));
+      d->ProducerHeartBeatTimer = SetAlarmWithSlack(d, 0, &ProducerHeartbeatAlarm, MS_TO_TIMEVAL(time), MS_TO_TIMEVAL(time), TIMER_SLACK(MS_TO_TIMEVAL(time)));
+#endif
     }
 }
 
@@ -317,11 +468,13 @@ void nodeguardInit(CO_Data* d)
   RegisterSetODentryCallBack(d, 0x100C, 0x00, &OnNodeGuardUpdate);
   RegisterSetODentryCallBack(d, 0x100D, 0x00, &OnNodeGuardUpdate);
 
+#ifndef CO_PROFILE_SLAVE
+  /* Guarding of the other nodes, a slave only answers to the requests */
   if (*d->GuardTime && *d->LifeTimeFactor) {
     UNS8 i;
 
     TIMEVAL time = *d->GuardTime;
-    d->GuardTimeTimer = SetAlarm(d, 0, &GuardTimeAlarm, MS_TO_TIMEVAL(time), MS_TO_TIMEVAL(time));
+    d->GuardTimeTimer = SetAlarmWithSlack(d, 0, &GuardTimeAlarm, MS_TO_TIMEVAL(time), MS_TO_TIMEVAL(time), TIMER_SLACK(MS_TO_TIMEVAL(time)));
     MSG_WAR(0x0, "GuardTime: ", time);
 
     for (i = 0; i < NMT_MAX_NODE_ID; i++) {
@@ -333,6 +486,7 @@ void nodeguardInit(CO_Data* d)
 
     MSG_WAR(0x0, "Timer for node-guarding startet", 0);
   }
+#endif
 
 }
 
@@ -344,6 +498,9 @@ void heartbeatStop(CO_Data* d)
       d->ConsumerHeartBeatTimers[index] = DelAlarm(d->ConsumerHeartBeatTimers[index]);
     }
 
+#ifdef CO_ENABLE_SHARED_HEARTBEAT
+  HeartbeatUnregister(d);
+#endif
   d->ProducerHeartBeatTimer = DelAlarm(d->ProducerHeartBeatTimer);
 }
 
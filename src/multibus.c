@@ -0,0 +1,334 @@
+/*
+This file is part of CanFestival, a library implementing CanOpen Stack.
+
+Copyright (C): Edouard TISSERANT and Francis DUPIN
+
+See COPYING file for copyrights details.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+USA
+*/
+
+/*!
+** @file   multibus.c
+** @author Edouard TISSERANT and Francis DUPIN
+**
+** @brief Multi-bus master
+**
+** A node-id is only unique on its bus, so each bus keeps its own master
+** CO_Data and the multi-bus master only routes the requests to it. The
+** state of the nodes stays in the NMT table and heartbeat consumers of the
+** master of their bus, and nothing is shared between the buses: a bus is
+** only touched by the thread processing it.
+*/
+
+#include "data.h"
+#include "multibus.h"
+
+#ifdef CO_ENABLE_MULTIBUS
+
+/* Internal, sdo.c */
+UNS8 GetSDOClientFromNodeId(CO_Data* d, UNS8 nodeId);
+
+/* Multi-bus masters, to find the one of a bus in the callbacks */
+static s_multibus* multibuses = NULL;
+
+/*!
+** Multi-bus master and number of the bus of a master.
+**
+** @param d
+** @param bus
+**
+** @return The multi-bus master, NULL if d is not a bus of one
+**/
+static s_multibus* findMultiBus(CO_Data* d, UNS8* bus)
+{
+  s_multibus* mb;
+  UNS8 i;
+
+  for(mb = multibuses; mb; mb = mb->next)
+    for(i = 0; i < mb->count; i++)
+      if(mb->buses[i] == d){
+        *bus = i;
+        return mb;
+      }
+  return NULL;
+}
+
+/*!
+** post_SlaveStateChange of the masters.
+**
+** @param d
+** @param nodeId
+** @param newNodeState
+**/
+static void multiBusSlaveStateChange(CO_Data* d, UNS8 nodeId, e_nodeState newNodeState)
+{
+  UNS8 bus;
+  s_multibus* mb = findMultiBus(d, &bus);
+
+  if(mb && mb->stateChange)
+    (*mb->stateChange)(mb, bus, nodeId, newNodeState);
+}
+
+/*!
+** heartbeatError of the masters.
+**
+** @param d
+** @param nodeId
+**/
+static void multiBusHeartbeatError(CO_Data* d, UNS8 nodeId)
+{
+  UNS8 bus;
+  s_multibus* mb = findMultiBus(d, &bus);
+
+  if(!mb)
+    return;
+  MSG_WAR(0x2F10, "Heartbeat lost on bus : ", bus);
+  if(mb->heartbeatError)
+    (*mb->heartbeatError)(mb, bus, nodeId);
+}
+
+/*!
+**
+**
+** @param mb
+** @param buses
+** @param count
+**
+** @return
+**/
+UNS8 initMultiBus(s_multibus* mb, CO_Data** buses, UNS8 count)
+{
+  UNS8 i;
+
+  if(!count || count == MULTIBUS_ALL){
+    MSG_ERR(0x1F11, "Invalid number of buses : ", count);
+    return 0xFF;
+  }
+  stopMultiBus(mb);
+  mb->buses = buses;
+  mb->count = count;
+  for(i = 0; i < count; i++){
+    buses[i]->post_SlaveStateChange = multiBusSlaveStateChange;
+    buses[i]->heartbeatError = multiBusHeartbeatError;
+  }
+  mb->next = multibuses;
+  multibuses = mb;
+  return 0;
+}
+
+/*!
+**
+**
+** @param mb
+**/
+void stopMultiBus(s_multibus* mb)
+{
+  s_multibus** m;
+  UNS8 i;
+
+  for(m = &multibuses; *m; m = &(*m)->next)
+    if(*m == mb){
+      *m = mb->next;
+      for(i = 0; i < mb->count; i++){
+        mb->buses[i]->post_SlaveStateChange = _post_SlaveStateChange;
+        mb->buses[i]->heartbeatError = _heartbeatError;
+      }
+      break;
+    }
+}
+
+/*!
+**
+**
+** @param mb
+** @param d
+**
+** @return
+**/
+UNS8 multiBusIndex(s_multibus* mb, CO_Data* d)
+{
+  UNS8 i;
+
+  for(i = 0; i < mb->count; i++)
+    if(mb->buses[i] == d)
+      return i;
+  return MULTIBUS_ALL;
+}
+
+/*!
+**
+**
+** @param mb
+** @param bus
+** @param nodeId
+** @param cs
+**
+** @return
+**/
+UNS8 multiBusNMT(s_multibus* mb, UNS8 bus, UNS8 nodeId, UNS8 cs)
+{
+  UNS8 err = 0;
+  UNS8 i;
+
+  if(bus != MULTIBUS_ALL){
+    if(bus >= mb->count)
+      return 0xFF;
+    return masterSendNMTstateChange(mb->buses[bus], nodeId, cs) ? 0xFF : 0;
+  }
+  for(i = 0; i < mb->count; i++)
+    if(masterSendNMTstateChange(mb->buses[i], nodeId, cs))
+      err = 0xFF;
+  return err;
+}
+
+/*!
+**
+**
+** @param mb
+** @param bus
+** @param nodeId
+**
+** @return
+**/
+e_nodeState multiBusNodeState(s_multibus* mb, UNS8 bus, UNS8 nodeId)
+{
+  if(bus >= mb->count || nodeId >= NMT_MAX_NODE_ID)
+    return Unknown_state;
+  return mb->buses[bus]->NMTable[nodeId];
+}
+
+/*!
+**
+**
+** @param mb
+** @param bus
+** @param state
+**
+** @return
+**/
+UNS32 multiBusCountNodes(s_multibus* mb, UNS8 bus, e_nodeState state)
+{
+  UNS32 n = 0;
+  UNS8 i;
+  UNS8 nodeId;
+
+  for(i = 0; i < mb->count; i++){
+    if(bus != MULTIBUS_ALL && bus != i)
+      continue;
+    /* Node-id 0 is not a node */
+    for(nodeId = 1; nodeId < NMT_MAX_NODE_ID; nodeId++)
+      if(mb->buses[i]->NMTable[nodeId] == state)
+        n++;
+  }
+  return n;
+}
+
+/*!
+** Make sure that an SDO client entry of the master of a bus addresses
+** the node. If none does, the first entry with no transfer on use is set
+** to the default SDO COB-IDs of the node.
+**
+** @param mb
+** @param bus
+** @param nodeId
+**
+** @return The master of the bus, NULL if no client entry is free
+**/
+static CO_Data* multiBusSDOclient(s_multibus* mb, UNS8 bus, UNS8 nodeId)
+{
+  CO_Data* d;
+  UNS16 offset;
+  UNS16 lastIndex;
+  UNS8 CliNbr;
+
+  if(bus >= mb->count){
+    MSG_ERR(0x1F12, "Invalid bus : ", bus);
+    return NULL;
+  }
+  d = mb->buses[bus];
+  CliNbr = GetSDOClientFromNodeId(d, nodeId);
+  if(CliNbr < 0xFE)
+    return d;
+  if(CliNbr == 0xFF)
+    return NULL;
+
+  offset = d->firstIndex->SDO_CLT;
+  lastIndex = d->lastIndex->SDO_CLT;
+  for(CliNbr = 0; offset <= lastIndex; offset++, CliNbr++){
+    if(!getSDOlineOnUse(d, CliNbr, SDO_CLIENT, NULL))
+      continue;
+    *(UNS32*)d->objdict[offset].pSubindex[1].pObject = 0x600 + nodeId;
+    *(UNS32*)d->objdict[offset].pSubindex[2].pObject = 0x580 + nodeId;
+    *(UNS8*)d->objdict[offset].pSubindex[3].pObject = nodeId;
+    MSG_WAR(0x3F13, "SDO client given to node : ", nodeId);
+    return d;
+  }
+  MSG_ERR(0x1F14, "No SDO client free on bus : ", bus);
+  return NULL;
+}
+
+/*!
+**
+**
+** @param mb
+** @param bus
+** @param nodeId
+** @param index
+** @param subIndex
+** @param count
+** @param dataType
+** @param data
+** @param Callback
+** @param useBlockMode
+**
+** @return
+**/
+UNS8 multiBusWriteNetworkDict(s_multibus* mb, UNS8 bus, UNS8 nodeId, UNS16 index, UNS8 subIndex,
+		UNS32 count, UNS8 dataType, void* data, SDOCallback_t Callback, UNS8 useBlockMode)
+{
+  CO_Data* d = multiBusSDOclient(mb, bus, nodeId);
+
+  if(!d)
+    return 0xFF;
+  return writeNetworkDictCallBack(d, nodeId, index, subIndex, count, dataType, data, Callback, useBlockMode) ? 0xFF : 0;
+}
+
+/*!
+**
+**
+** @param mb
+** @param bus
+** @param nodeId
+** @param index
+** @param subIndex
+** @param dataType
+** @param Callback
+** @param useBlockMode
+**
+** @return
+**/
+UNS8 multiBusReadNetworkDict(s_multibus* mb, UNS8 bus, UNS8 nodeId, UNS16 index, UNS8 subIndex,
+		UNS8 dataType, SDOCallback_t Callback, UNS8 useBlockMode)
+{
+  CO_Data* d = multiBusSDOclient(mb, bus, nodeId);
+
+  if(!d)
+    return 0xFF;
+  return readNetworkDictCallback(d, nodeId, index, subIndex, dataType, Callback, useBlockMode) ? 0xFF : 0;
+}
+
+#endif /* CO_ENABLE_MULTIBUS */
@@ -83,6 +83,7 @@ UNS8 masterSendNMTnodeguard(CO_Data* d, UNS8 nodeId)
   return canSend(d->canHandle,&m);
 }
 
+#ifndef CO_PROFILE_SLAVE
 /*!
 **
 **
@@ -109,4 +110,5 @@ UNS8 masterRequestNodeState(CO_Data* d, UNS8 nodeId)
   }
   return masterSendNMTnodeguard(d,nodeId);
 }
+#endif
 
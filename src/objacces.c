@@ -80,7 +80,12 @@ UNS32 _setODentry( CO_Data* d,
   if( *pExpectedSize == 0 ||
       *pExpectedSize == szData ||
       /* allow to store a shorter string than entry size */
-      (dataType == visible_string && *pExpectedSize < szData))
+      (dataType == visible_string && *pExpectedSize < szData)
+#ifdef CO_ENABLE_FW_DELTA
+      /* the delta domain is sized for the largest delta, its header gives the size */
+      || (wIndex == FW_DELTA_INDEX && dataType == domain && *pExpectedSize < szData)
+#endif
+      )
     {
 #ifdef CANOPEN_BIG_ENDIAN
       /* re-endianize do not occur for bool, strings time and domains */
@@ -113,23 +118,32 @@ UNS32 _setODentry( CO_Data* d,
       /* terminate visible_string with '\0' */
       if(dataType == visible_string && *pExpectedSize < szData)
         ((UNS8*)ptrTable->pSubindex[bSubindex].pObject)[*pExpectedSize] = 0;
+      /* clear the end of a shorter delta domain */
+      if(dataType == domain && *pExpectedSize < szData)
+        memset((UNS8*)ptrTable->pSubindex[bSubindex].pObject + *pExpectedSize, 0, szData - *pExpectedSize);
       
       *pExpectedSize = szData;
 
       /* Callbacks */
       if(Callback && Callback[bSubindex]){
-        errorCode = (Callback[bSubindex])(d, ptrTable, bSubindex);
-        if(errorCode != OD_SUCCESSFUL)
+        PROFILE_HOOK(d, HOOK_OD, wIndex, bSubindex, errorCode = (Callback[bSubindex])(d, ptrTable, bSubindex));
+        /* OD_PENDING : the value is written, only the SDO response is deferred */
+        if(errorCode != OD_SUCCESSFUL && errorCode != OD_PENDING)
         {
             return errorCode;
         }
        }
 
+#ifdef CO_ENABLE_OD_SUBSCRIPTIONS
+      if(d->odSubscriptions)
+        _notifyODChange(d, wIndex, bSubindex, ptrTable->pSubindex[bSubindex].pObject, szData);
+#endif
+
       /* TODO : Store dans NVRAM */
       if (ptrTable->pSubindex[bSubindex].bAccessType & TO_BE_SAVE){
-        (*d->storeODSubIndex)(d, wIndex, bSubindex);
+        PROFILE_HOOK(d, HOOK_STORE_OD, wIndex, bSubindex, (*d->storeODSubIndex)(d, wIndex, bSubindex));
       }
-      return OD_SUCCESSFUL;
+      return errorCode;
     }else{
       *pExpectedSize = szData;
       accessDictionaryError(wIndex, bSubindex, szData, *pExpectedSize, OD_LENGTH_DATA_INVALID);
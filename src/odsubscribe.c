@@ -0,0 +1,244 @@
+/*
+  This file is part of CanFestival, a library implementing CanOpen
+  Stack.
+
+  Copyright (C): Edouard TISSERANT and Francis DUPIN
+
+  See COPYING file for copyrights details.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+  USA
+*/
+
+/*!
+** @file   odsubscribe.c
+** @author Edouard TISSERANT and Francis DUPIN
+**
+** @brief Object dictionary change subscriptions
+**
+** The stack is the single producer of every ring : it always appends with
+** the stack mutex held. The application thread owning a subscriber is the
+** single consumer. They only share the published and head counters.
+*/
+
+#include <string.h>
+
+#include "data.h"
+#include "odsubscribe.h"
+
+#ifdef CO_ENABLE_OD_SUBSCRIPTIONS
+
+#if defined(__GNUC__)
+#define OD_LOAD_ACQUIRE(v)      __atomic_load_n(&(v), __ATOMIC_ACQUIRE)
+#define OD_STORE_RELEASE(v, x)  __atomic_store_n(&(v), (x), __ATOMIC_RELEASE)
+#else
+#define OD_LOAD_ACQUIRE(v)      (*(volatile UNS16 *)&(v))
+#define OD_STORE_RELEASE(v, x)  (*(volatile UNS16 *)&(v) = (x))
+#endif
+
+/*!
+**
+**
+** @param d
+** @param subs
+** @param clock
+**/
+void initODSubscriptions(CO_Data* d, s_od_subscriptions* subs, ODChangeClock_t clock)
+{
+  subs->first = NULL;
+  subs->clock = clock;
+  subs->pass = 0;
+  subs->inPass = 0;
+  d->odSubscriptions = subs;
+}
+
+/*!
+**
+**
+** @param d
+** @param s
+** @param firstIndex
+** @param lastIndex
+** @param subIndex
+** @param filter
+** @param context
+** @param ring
+** @param ringSize
+**
+** @return
+**/
+UNS8 subscribeODChanges(CO_Data* d, s_od_subscriber* s, UNS16 firstIndex, UNS16 lastIndex,
+		UNS8 subIndex, ODChangeFilter_t filter, void* context, s_od_change* ring, UNS16 ringSize)
+{
+  if(!d->odSubscriptions || !ring || ringSize < 2 || (ringSize & (ringSize - 1))){
+    MSG_ERR(0x1B01, "Invalid subscription, ring size : ", ringSize);
+    return 0xFF;
+  }
+  s->firstIndex = firstIndex;
+  s->lastIndex = lastIndex;
+  s->subIndex = subIndex;
+  s->filter = filter;
+  s->context = context;
+  s->ring = ring;
+  s->ringMask = ringSize - 1;
+  s->head = 0;
+  s->published = 0;
+  s->tail = 0;
+  s->overruns = 0;
+  s->next = d->odSubscriptions->first;
+  d->odSubscriptions->first = s;
+  return 0;
+}
+
+/*!
+**
+**
+** @param d
+** @param s
+**/
+void unsubscribeODChanges(CO_Data* d, s_od_subscriber* s)
+{
+  s_od_subscriber** p;
+
+  if(!d->odSubscriptions)
+    return;
+  for(p = &d->odSubscriptions->first; *p; p = &(*p)->next){
+    if(*p == s){
+      *p = s->next;
+      s->next = NULL;
+      return;
+    }
+  }
+}
+
+/*! Make the changes appended since the last call visible to the consumer.
+**
+** @param s
+**/
+static void publishODChanges(s_od_subscriber* s)
+{
+  if(s->published != s->tail)
+    OD_STORE_RELEASE(s->published, s->tail);
+}
+
+/*!
+**
+**
+** @param d
+** @param index
+** @param subIndex
+** @param value
+** @param size
+**/
+void _notifyODChange(CO_Data* d, UNS16 index, UNS8 subIndex, const void* value, UNS32 size)
+{
+  s_od_subscriptions* subs = d->odSubscriptions;
+  s_od_subscriber* s;
+  TIMEVAL timestamp = subs->clock ? subs->clock() : subs->pass;
+  UNS32 copied = size < OD_CHANGE_VALUE_SIZE ? size : OD_CHANGE_VALUE_SIZE;
+
+  for(s = subs->first; s; s = s->next){
+    s_od_change* change = NULL;
+    UNS16 i;
+
+    if(index < s->firstIndex || index > s->lastIndex)
+      continue;
+    if(s->subIndex != OD_SUBSCRIBE_ALL_SUBINDEXES && s->subIndex != subIndex)
+      continue;
+    if(s->filter && !s->filter(s->context, index, subIndex, value, size))
+      continue;
+
+    /* Coalesce with a change of the same entry not published yet */
+    for(i = s->published; i != s->tail; i++){
+      s_od_change* pending = &s->ring[i & s->ringMask];
+      if(pending->index == index && pending->subIndex == subIndex){
+        change = pending;
+        if(change->count < 0xFF)
+          change->count++;
+        break;
+      }
+    }
+    if(!change){
+      if((UNS16)(s->tail - OD_LOAD_ACQUIRE(s->head)) > s->ringMask){
+        /* Ring full : the change is lost */
+        s->overruns++;
+        continue;
+      }
+      change = &s->ring[s->tail & s->ringMask];
+      change->index = index;
+      change->subIndex = subIndex;
+      change->count = 1;
+      s->tail++;
+    }
+    change->size = size;
+    memcpy(change->value, value, copied);
+    change->timestamp = timestamp;
+
+    if(!subs->inPass)
+      publishODChanges(s);
+  }
+}
+
+/*!
+**
+**
+** @param d
+**/
+void _beginODChangePass(CO_Data* d)
+{
+  d->odSubscriptions->inPass++;
+}
+
+/*!
+**
+**
+** @param d
+**/
+void _endODChangePass(CO_Data* d)
+{
+  s_od_subscriptions* subs = d->odSubscriptions;
+  s_od_subscriber* s;
+
+  if(--subs->inPass)
+    return;
+  subs->pass++;
+  for(s = subs->first; s; s = s->next)
+    publishODChanges(s);
+}
+
+/*!
+**
+**
+** @param s
+** @param batch
+** @param max
+**
+** @return
+**/
+UNS16 readODChanges(s_od_subscriber* s, s_od_change* batch, UNS16 max)
+{
+  UNS16 head = s->head;
+  UNS16 available = (UNS16)(OD_LOAD_ACQUIRE(s->published) - head);
+  UNS16 n;
+
+  if(available > max)
+    available = max;
+  for(n = 0; n < available; n++)
+    batch[n] = s->ring[(UNS16)(head + n) & s->ringMask];
+  OD_STORE_RELEASE(s->head, (UNS16)(head + available));
+  return available;
+}
+
+#endif /* CO_ENABLE_OD_SUBSCRIPTIONS */
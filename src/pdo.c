@@ -266,7 +266,7 @@ proceedPDO (CO_Data * d, Message * m)
                                       (UNS8) (((*pMappingParameter) >> 8) &
                                               0xFF), tmp, &ByteSize, 0);
 
-                        if (objDict != OD_SUCCESSFUL)
+                        if (objDict != OD_SUCCESSFUL && objDict != OD_PENDING)
                           {
                             MSG_ERR (0x1938,
                                      "error accessing to the mapped var : ",
@@ -479,10 +479,21 @@ static inline void copyBits (UNS8 NbBits, const UNS8 * SrcByteIndex, UNS8 SrcBit
 
 static inline uint8_t sendPdo(CO_Data * d, UNS32 pdoNum, Message * pdo)
 {
+	UNS8 res;
+
 	MSG_WAR (0x396D, "sendPDO cobId :", UNS16_LE(pdo->cob_id));
 	MSG_WAR (0x396E, "     Nb octets  : ", pdo->len);
 
-	if (canSend (d->canHandle, pdo)) {
+#ifdef CO_ENABLE_TXTIME
+	res = CAN_TXTIME_UNSUPPORTED;
+	/* Sent while processing a scheduled SYNC : queue it right behind the SYNC */
+	if (d->txLaunchTime)
+		res = canSendAt (d->canHandle, pdo, d->txLaunchTime);
+	if (res == CAN_TXTIME_UNSUPPORTED)
+#endif
+	res = canSend (d->canHandle, pdo);
+
+	if (res) {
 		/*store_as_last_message */
 		d->PDO_status[pdoNum].last_message = *pdo;
 		return 1;
@@ -539,8 +550,9 @@ sendOnePDOevent (CO_Data * d, UNS8 pdoNum)
 		if (EventTimerDuration)
 		{
 			DelAlarm (PDO_status->event_timer);
-			PDO_status->event_timer = SetAlarm (d, pdoNum, &PDOEventTimerAlarm,
-						MS_TO_TIMEVAL (EventTimerDuration), 0);
+			PDO_status->event_timer = SetAlarmWithSlack (d, pdoNum, &PDOEventTimerAlarm,
+						MS_TO_TIMEVAL (EventTimerDuration), 0,
+						TIMER_SLACK (MS_TO_TIMEVAL (EventTimerDuration)));
 		}
 
 		if (InhibitTimerDuration)
@@ -0,0 +1,322 @@
+/*
+  This file is part of CanFestival, a library implementing CanOpen
+  Stack.
+
+  Copyright (C): Edouard TISSERANT and Francis DUPIN
+
+  See COPYING file for copyrights details.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+  USA
+*/
+
+
+/*!
+** @file   pdoremap.c
+** @author Edouard TISSERANT and Francis DUPIN
+**
+** @brief PDO mapping swap
+**
+** The staged mappings and the mapping parameters are only accessed with the
+** stack mutex held, so a swap is seen whole by the PDO processing.
+*/
+
+#include "data.h"
+#include "objacces.h"
+#include "pdoremap.h"
+
+#ifdef CO_ENABLE_PDO_REMAP
+
+/*!
+**
+**
+** @param d
+** @param remap
+** @param slots
+** @param slotsCount
+**/
+void initPDORemap(CO_Data* d, s_pdo_remap* remap, s_pdo_mapping* slots, UNS8 slotsCount)
+{
+  UNS8 i;
+  for(i = 0; i < slotsCount; i++)
+    slots[i].mapIndex = 0;
+  remap->slots = slots;
+  remap->slotsCount = slotsCount;
+  remap->staged = 0;
+  remap->swaps = 0;
+  d->pdoRemap = remap;
+}
+
+/*!
+** Check a mapping against the object dictionary
+**
+** @param d
+** @param mapIndex
+** @param count
+** @param entries
+**
+** @return OD_SUCCESSFUL or an SDO abort code
+**/
+static UNS32 checkPDOMapping(CO_Data* d, UNS16 mapIndex, UNS8 count, const UNS32* entries)
+{
+  UNS32 errorCode;
+  ODCallback_t *Callback;
+  const indextable *mapEntry;
+  UNS8 isRPDO = mapIndex >= 0x1600 && mapIndex <= 0x17FF;
+  UNS16 bits = 0;
+  UNS8 i;
+
+  if(!isRPDO && !(mapIndex >= 0x1A00 && mapIndex <= 0x1BFF))
+    return OD_NO_SUCH_OBJECT;
+  mapEntry = (*d->scanIndexOD)(mapIndex, &errorCode, &Callback);
+  if(errorCode != OD_SUCCESSFUL)
+    return errorCode;
+  if(count >= mapEntry->bSubCount || count > PDO_MAX_MAPPED)
+    return OD_VALUE_TOO_HIGH;
+
+  for(i = 0; i < count; i++)
+    {
+      UNS16 index = (UNS16)(entries[i] >> 16);
+      UNS8 subIndex = (UNS8)(entries[i] >> 8);
+      UNS8 size = (UNS8)entries[i];
+      const subindex* it = NULL;
+
+      if(!size)
+        return OD_NOT_MAPPABLE;
+      bits += size;
+      if(bits > 64)
+        return OD_PDO_LENGTH_EXCEEDED;
+      /* Dummy mapping of the standard data types */
+      if(isRPDO && index >= 0x0001 && index <= 0x0007)
+        continue;
+      if(_findODentry(d, index, subIndex, &it) != OD_SUCCESSFUL)
+        return OD_NOT_MAPPABLE;
+      /* The mapped bits must hold the object, as buildPDO checks */
+      if(it->size > (UNS32)(1 + ((size - 1) >> 3)))
+        return OD_NOT_MAPPABLE;
+      if(isRPDO ? it->bAccessType == RO : (it->bAccessType & WO) != 0)
+        return OD_NOT_MAPPABLE;
+    }
+  return OD_SUCCESSFUL;
+}
+
+/*!
+** Slot of the mapping staged for mapIndex, or a free one
+**
+** @param remap
+** @param mapIndex
+**
+** @return NULL if all the slots are used by other PDOs
+**/
+static s_pdo_mapping* getPDOMappingSlot(s_pdo_remap* remap, UNS16 mapIndex)
+{
+  s_pdo_mapping* freeSlot = NULL;
+  UNS8 i;
+  for(i = 0; i < remap->slotsCount; i++)
+    {
+      if(remap->slots[i].mapIndex == mapIndex)
+        return &remap->slots[i];
+      if(!remap->slots[i].mapIndex && !freeSlot)
+        freeSlot = &remap->slots[i];
+    }
+  return freeSlot;
+}
+
+/*!
+**
+**
+** @param d
+** @param mapIndex
+** @param count
+** @param entries
+**
+** @return
+**/
+UNS32 stagePDOMapping(CO_Data* d, UNS16 mapIndex, UNS8 count, const UNS32* entries)
+{
+  s_pdo_mapping* slot;
+  UNS32 errorCode;
+  UNS8 i;
+
+  if(!d->pdoRemap)
+    return SDOABT_LOCAL_CTRL_ERROR;
+  errorCode = checkPDOMapping(d, mapIndex, count, entries);
+  if(errorCode != OD_SUCCESSFUL)
+    return errorCode;
+  slot = getPDOMappingSlot(d->pdoRemap, mapIndex);
+  if(!slot)
+    return SDOABT_OUT_OF_MEMORY;
+
+  if(!slot->mapIndex)
+    d->pdoRemap->staged++;
+  slot->mapIndex = mapIndex;
+  slot->count = count;
+  for(i = 0; i < count; i++)
+    slot->entries[i] = entries[i];
+  MSG_WAR(0x3A01, "PDO mapping staged for index : ", mapIndex);
+  return OD_SUCCESSFUL;
+}
+
+/*!
+**
+**
+** @param d
+**/
+void cancelPDOMappings(CO_Data* d)
+{
+  UNS8 i;
+  if(!d->pdoRemap)
+    return;
+  for(i = 0; i < d->pdoRemap->slotsCount; i++)
+    d->pdoRemap->slots[i].mapIndex = 0;
+  d->pdoRemap->staged = 0;
+}
+
+/*!
+**
+**
+** @param d
+**
+** @return
+**/
+UNS8 commitPDOMappings(CO_Data* d)
+{
+  s_pdo_remap* remap = d->pdoRemap;
+  UNS8 changed = 0;
+  UNS8 i, j;
+
+  if(!remap || !remap->staged)
+    return 0;
+
+  for(i = 0; i < remap->slotsCount; i++)
+    {
+      s_pdo_mapping* slot = &remap->slots[i];
+      UNS32 size;
+      UNS8 zero = 0;
+
+      if(!slot->mapIndex)
+        continue;
+      /* As a configuration tool does: clear the count, write the
+         entries, then set the count */
+      size = sizeof(UNS8);
+      writeLocalDict(d, slot->mapIndex, 0, &zero, &size, 0);
+      for(j = 0; j < slot->count; j++)
+        {
+          size = sizeof(UNS32);
+          writeLocalDict(d, slot->mapIndex, j + 1, &slot->entries[j], &size, 0);
+        }
+      size = sizeof(UNS8);
+      writeLocalDict(d, slot->mapIndex, 0, &slot->count, &size, 0);
+
+      /* Nothing else depends on the mapping but the last TPDO sent, for
+         the change detection: the new layout is always sent */
+      if(slot->mapIndex >= 0x1A00)
+        {
+          UNS16 pdoNum = slot->mapIndex - 0x1A00;
+          if(d->firstIndex->PDO_TRS && pdoNum <= d->lastIndex->PDO_TRS - d->firstIndex->PDO_TRS)
+            d->PDO_status[pdoNum].last_message.cob_id = 0;
+        }
+      MSG_WAR(0x3A02, "PDO mapping swapped for index : ", slot->mapIndex);
+      slot->mapIndex = 0;
+      changed++;
+    }
+  remap->staged = 0;
+  remap->swaps++;
+  return changed;
+}
+
+/*!
+** Whether a record of the domain before end is for mapIndex
+**
+** @param data
+** @param end
+** @param mapIndex
+**
+** @return
+**/
+static UNS8 isPDOMappingRecorded(const UNS8* data, UNS32 end, UNS16 mapIndex)
+{
+  UNS32 offset = 0;
+  while(offset < end)
+    {
+      if((data[offset] | (data[offset + 1] << 8)) == mapIndex)
+        return 1;
+      offset += 3 + 4 * (UNS32)data[offset + 2];
+    }
+  return 0;
+}
+
+/*!
+**
+**
+** @param d
+** @param OD_entry
+** @param bSubindex
+**
+** @return
+**/
+UNS32 PDORemapObjectCallback(CO_Data* d, const indextable* OD_entry, UNS8 bSubindex)
+{
+  const UNS8* data = (const UNS8*)OD_entry->pSubindex[bSubindex].pObject;
+  UNS32 size = OD_entry->pSubindex[bSubindex].size;
+  UNS32 entries[PDO_MAX_MAPPED];
+  UNS8 pass;
+
+  if(!d->pdoRemap)
+    return SDOABT_LOCAL_CTRL_ERROR;
+
+  /* First pass checks all the records, second pass stages them */
+  for(pass = 0; pass < 2; pass++)
+    {
+      UNS32 offset = 0;
+      UNS8 needed = 0;
+
+      while(offset + 3 <= size)
+        {
+          UNS32 record = offset;
+          UNS16 mapIndex = data[offset] | (data[offset + 1] << 8);
+          UNS8 count = data[offset + 2];
+          UNS32 errorCode;
+          UNS8 i;
+
+          if(!mapIndex)
+            break;
+          offset += 3;
+          if(count > PDO_MAX_MAPPED || offset + 4 * (UNS32)count > size)
+            return OD_LENGTH_DATA_INVALID;
+          for(i = 0; i < count; i++, offset += 4)
+            entries[i] = data[offset] | (data[offset + 1] << 8) |
+              ((UNS32)data[offset + 2] << 16) | ((UNS32)data[offset + 3] << 24);
+
+          if(pass == 0)
+            {
+              s_pdo_mapping* slot = getPDOMappingSlot(d->pdoRemap, mapIndex);
+              errorCode = checkPDOMapping(d, mapIndex, count, entries);
+              if(errorCode != OD_SUCCESSFUL)
+                return errorCode;
+              /* A PDO listed twice takes one slot, the last record wins */
+              if((!slot || !slot->mapIndex) && !isPDOMappingRecorded(data, record, mapIndex))
+                needed++;
+            }
+          else
+            stagePDOMapping(d, mapIndex, count, entries);
+        }
+      if(pass == 0 && needed > d->pdoRemap->slotsCount - d->pdoRemap->staged)
+        return SDOABT_OUT_OF_MEMORY;
+    }
+  return OD_SUCCESSFUL;
+}
+
+#endif
@@ -137,13 +137,15 @@ INLINE UNS8 _readNetworkDict (CO_Data* d, UNS8 nodeId, UNS16 index, UNS8 subInde
 void SDOTimeoutAlarm(CO_Data* d, UNS32 id)
 {
 	UNS16 offset;
-	UNS8 nodeId;
-	/* Get the client->server cobid.*/
-	offset = d->firstIndex->SDO_CLT;
-	if ((offset == 0) || ((offset+d->transfers[id].CliServNbr) > d->lastIndex->SDO_CLT)) {
-		return ;
+	UNS8 nodeId = 0;
+	/* Get the client->server cobid. A server line has no SDO client entry.*/
+	if (d->transfers[id].whoami == SDO_CLIENT) {
+		offset = d->firstIndex->SDO_CLT;
+		if ((offset == 0) || ((offset+d->transfers[id].CliServNbr) > d->lastIndex->SDO_CLT)) {
+			return ;
+		}
+		nodeId = (UNS8) *((UNS32*) d->objdict[offset+d->transfers[id].CliServNbr].pSubindex[3].pObject);
 	}
-	nodeId = (UNS8) *((UNS32*) d->objdict[offset+d->transfers[id].CliServNbr].pSubindex[3].pObject);
 	MSG_ERR(0x1A01, "SDO timeout. SDO response not received.", 0);
 	MSG_WAR(0x2A02, "server node id : ", nodeId);
 	MSG_WAR(0x2A02, "         index : ", d->transfers[id].index);
@@ -159,7 +161,7 @@ void SDOTimeoutAlarm(CO_Data* d, UNS32 id)
 	/* Call the user function to inform of the problem.*/
 	if(d->transfers[id].Callback)
 		/*If ther is a callback, it is responsible to close SDO transfer (client)*/
-		(*d->transfers[id].Callback)(d, nodeId);
+		PROFILE_HOOK(d, HOOK_SDO, d->transfers[id].index, d->transfers[id].subIndex, (*d->transfers[id].Callback)(d, nodeId));
 	/*Reset the line if (whoami == SDO_SERVER) or the callback did not close the line.
 	  Otherwise this sdo transfer would never be closed. */
 	if(d->transfers[id].abortCode == SDOABT_TIMED_OUT) 
@@ -178,6 +180,16 @@ d->transfers[id].timer = SetAlarm(d,id,&SDOTimeoutAlarm,MS_TO_TIMEVAL(SDO_TIMEOU
 	MSG_WAR(0x3A07, "restartSDO_TIMER for line : ", line);\
 if(d->transfers[id].timer != TIMER_NONE) { StopSDO_TIMER(id) StartSDO_TIMER(id) }
 
+#define StopSDO_PACING(id) \
+d->transfers[id].paceTimer = DelAlarm(d->transfers[id].paceTimer);
+
+/* Max segments of a block sent at once by a data producer */
+#ifdef SDO_BLOCK_BURST
+#define SDO_BLOCK_BURST_MAX SDO_BLOCK_BURST
+#else
+#define SDO_BLOCK_BURST_MAX 127
+#endif
+
 /*!
  ** Reset all sdo buffers
  **
@@ -472,7 +484,8 @@ UNS8 initSDOline (CO_Data* d, UNS8 line, UNS8 CliServNbr, UNS16 index, UNS8 subI
 {
 	MSG_WAR(0x3A25, "init SDO line nb : ", line);
 	if (state == SDO_DOWNLOAD_IN_PROGRESS       || state == SDO_UPLOAD_IN_PROGRESS ||
-        state == SDO_BLOCK_DOWNLOAD_IN_PROGRESS || state == SDO_BLOCK_UPLOAD_IN_PROGRESS){
+        state == SDO_BLOCK_DOWNLOAD_IN_PROGRESS || state == SDO_BLOCK_UPLOAD_IN_PROGRESS ||
+        state == SDO_DOWNLOAD_PENDING || state == SDO_UPLOAD_PENDING || state == SDO_BLOCK_UPLOAD_PENDING){
 		StartSDO_TIMER(line)
 	}else{
 		StopSDO_TIMER(line)
@@ -491,9 +504,15 @@ UNS8 initSDOline (CO_Data* d, UNS8 line, UNS8 CliServNbr, UNS16 index, UNS8 subI
     d->transfers[line].lastblockoffset = 0;
     d->transfers[line].seqno = 0;
     d->transfers[line].endfield = 0;
+    d->transfers[line].burst = SDO_BLOCK_BURST_MAX;
     d->transfers[line].rxstep = RXSTEP_INIT;
+	StopSDO_PACING(line)
 	d->transfers[line].dataType = 0;
 	d->transfers[line].Callback = NULL;
+#ifdef CO_ENABLE_SDO_ZIP
+	if (d->sdoZip && d->sdoZip->mode != SDO_ZIP_FREE && d->sdoZip->line == line)
+		d->sdoZip->mode = SDO_ZIP_FREE;
+#endif
 #ifdef SDO_DYNAMIC_BUFFER_ALLOCATION
 	free(d->transfers[line].dynamicData);
 	d->transfers[line].dynamicData = 0;
@@ -649,6 +668,188 @@ UNS8 setSDOlineRestBytes (CO_Data* d, UNS8 line, UNS32 nbBytes)
 	return 0;
 }
 
+#ifdef CO_ENABLE_SDO_BUDGET
+static void SDObudgetAlarm (CO_Data* d, UNS32 id);
+
+/*!
+ **
+ **
+ ** @param budget
+ ** @param rate
+ ** @param depth
+ **
+ ** @return
+ **/
+UNS8 initSDObudget (s_sdo_budget* budget, UNS32 rate, UNS32 depth)
+{
+	if (rate < 1000 || rate > 1000000 || depth < SDO_FRAME_BITS || depth > 0x7FFFFFFF) {
+		MSG_ERR(0x1AE0, "SDO budget : invalid rate or depth ", rate);
+		return 0xFF;
+	}
+	budget->rate = rate;
+	budget->depth = depth;
+	budget->tokens = (INTEGER32) depth;
+	budget->remainder = 0;
+	/* A frame of tokens per tick, rounded up */
+	budget->tick = (SDO_FRAME_BITS * 1000000 + rate - 1) / rate;
+	budget->timer = TIMER_NONE;
+	budget->timerData = NULL;
+	budget->first = 0;
+	budget->count = 0;
+	budget->frames = 0;
+	budget->bits = 0;
+	budget->queued = 0;
+	budget->overflows = 0;
+	budget->paced = 0;
+	return 0;
+}
+
+/*!
+ **
+ **
+ ** @param d
+ ** @param budget
+ **/
+void setSDObudget (CO_Data* d, s_sdo_budget* budget)
+{
+	s_sdo_budget* old = d->sdoBudget;
+
+	/* The refill alarm is found through the node, give it up */
+	if (old && old->timerData == d) {
+		old->timer = DelAlarm(old->timer);
+		old->timerData = NULL;
+	}
+	d->sdoBudget = budget;
+}
+
+/*!
+ ** Arm the refill of the budget, if it is not yet.
+ **
+ ** @param d
+ ** @param b
+ **/
+static void startSDObudgetRefill (CO_Data* d, s_sdo_budget* b)
+{
+	if (b->timer == TIMER_NONE) {
+		b->timer = SetAlarm(d, 0, &SDObudgetAlarm,
+				US_TO_TIMEVAL(b->tick), US_TO_TIMEVAL(b->tick));
+		b->timerData = d;
+	}
+}
+
+/*!
+ ** Send an SDO frame, take its tokens.
+ **
+ ** @param d
+ ** @param b
+ ** @param m
+ **
+ ** @return canSend result
+ **/
+static UNS8 sendSDObudgetFrame (CO_Data* d, s_sdo_budget* b, Message* m)
+{
+	b->tokens -= SDO_FRAME_BITS;
+	b->frames++;
+	b->bits += SDO_FRAME_BITS;
+	startSDObudgetRefill(d, b);
+	return canSend(d->canHandle, m);
+}
+
+/*!
+ ** Send an SDO frame within the budget of the node, or queue it until the
+ ** budget has the tokens. The queued frames are sent in order.
+ **
+ ** @param d
+ ** @param m
+ **
+ ** @return 0 if sent or queued, canSend result otherwise
+ **/
+static UNS8 budgetSDO (CO_Data* d, Message* m)
+{
+	s_sdo_budget* b = d->sdoBudget;
+	UNS8 last;
+
+	if (!b->count && b->tokens >= SDO_FRAME_BITS)
+		return sendSDObudgetFrame(d, b, m);
+	if (b->count == SDO_BUDGET_QUEUE) {
+		/* Sent over budget rather than lost */
+		MSG_WAR(0x2AE1, "SDO budget queue full, frame sent over budget : ", m->cob_id);
+		b->overflows++;
+		return sendSDObudgetFrame(d, b, m);
+	}
+	last = (b->first + b->count) % SDO_BUDGET_QUEUE;
+	b->nodes[last] = d;
+	b->queue[last] = *m;
+	b->count++;
+	b->queued++;
+	startSDObudgetRefill(d, b);
+	return 0;
+}
+
+/*!
+ ** Refill the budget of the node, send the queued frames it allows. The
+ ** alarm stops once the bucket is full.
+ **
+ ** @param d
+ ** @param id
+ **/
+static void SDObudgetAlarm (CO_Data* d, UNS32 id)
+{
+	s_sdo_budget* b = d->sdoBudget;
+	CO_Data* sender;
+
+	if (!b)
+		return;
+	/* rate * tick stays below 2^32 as rate is at most 1 Mbit/s */
+	b->remainder += b->rate * b->tick;
+	b->tokens += (INTEGER32) (b->remainder / 1000000);
+	b->remainder %= 1000000;
+	while (b->count && b->tokens >= SDO_FRAME_BITS) {
+		sender = b->nodes[b->first];
+		/* Kept queued if the driver refuses it */
+		if (canSend(sender->canHandle, &b->queue[b->first]))
+			break;
+		b->tokens -= SDO_FRAME_BITS;
+		b->frames++;
+		b->bits += SDO_FRAME_BITS;
+		b->first = (b->first + 1) % SDO_BUDGET_QUEUE;
+		b->count--;
+	}
+	if (!b->count && b->tokens >= (INTEGER32) b->depth) {
+		b->tokens = (INTEGER32) b->depth;
+		b->remainder = 0;
+		b->timer = DelAlarm(b->timer);
+		b->timerData = NULL;
+	}
+}
+
+/*!
+ ** Time until a block segment can be sent within the budget of the node,
+ ** after the frames queued.
+ **
+ ** @param d
+ **
+ ** @return 0 if it can be sent now
+ **/
+static TIMEVAL SDObudgetDelay (CO_Data* d)
+{
+	s_sdo_budget* b = d->sdoBudget;
+	INTEGER32 missing;
+
+	if (!b)
+		return 0;
+	missing = (INTEGER32) (SDO_FRAME_BITS * (b->count + 1)) - b->tokens;
+	if (missing <= 0)
+		return 0;
+	startSDObudgetRefill(d, b);
+	b->paced++;
+	if (missing > 1000000)
+		missing = 1000000;
+	/* Rounded up and a microsecond after the refill tick, not before */
+	return US_TO_TIMEVAL(((UNS32) missing * 1000 + b->rate / 1000 - 1) / (b->rate / 1000) + 1);
+}
+#endif
+
 /*!
  **
  **
@@ -698,6 +899,10 @@ UNS8 sendSDO (CO_Data* d, UNS8 whoami, UNS8 CliServNbr, UNS8 *pData)
 	for (i = 0 ; i < 8 ; i++) {
 		m.data[i] =  pData[i];
 	}
+#ifdef CO_ENABLE_SDO_BUDGET
+	if (d->sdoBudget)
+		return budgetSDO(d, &m);
+#endif
 	return canSend(d->canHandle,&m);
 }
 
@@ -734,6 +939,605 @@ UNS8 sendSDOabort (CO_Data* d, UNS8 whoami, UNS8 CliServNbr, UNS16 index, UNS8 s
 	return ret;
 }
 
+#ifdef CO_ENABLE_SDO_ZIP
+/*!
+ ** Compression context of a line.
+ **
+ ** @param d
+ ** @param line
+ **
+ ** @return The context, NULL if the transfer of the line is not compressed
+ **/
+static s_sdo_zip* zipSDOline (CO_Data* d, UNS8 line)
+{
+	s_sdo_zip* zip = d->sdoZip;
+
+	if (zip && (zip->mode == SDO_ZIP_ENCODE || zip->mode == SDO_ZIP_DECODE) && zip->line == line)
+		return zip;
+	return NULL;
+}
+
+/*!
+ ** Data of a line holding a whole object, allocated if needed.
+ **
+ ** @param d
+ ** @param line
+ ** @param size Bytes of the object
+ **
+ ** @return The data, NULL if the object does not fit
+ **/
+static UNS8* zipSDOlineData (CO_Data* d, UNS8 line, UNS32 size)
+{
+	if (size <= SDO_MAX_LENGTH_TRANSFER)
+		return d->transfers[line].data;
+#ifdef SDO_DYNAMIC_BUFFER_ALLOCATION
+	if (d->transfers[line].dynamicData == NULL) {
+		d->transfers[line].dynamicData = (UNS8*) malloc(size);
+		if (d->transfers[line].dynamicData == NULL)
+			return NULL;
+		d->transfers[line].dynamicDataSize = size;
+	}
+	if (d->transfers[line].dynamicDataSize >= size)
+		return d->transfers[line].dynamicData;
+#endif //SDO_DYNAMIC_BUFFER_ALLOCATION
+	return NULL;
+}
+
+/*!
+ ** Answer of the server to the compressed transfer asked for by a client.
+ **
+ ** @param d
+ ** @param line
+ ** @param confirmed Flag of the initiate response
+ ** @param mode SDO_ZIP_ENCODE or SDO_ZIP_DECODE
+ ** @param size Bytes of the object
+ **
+ ** @return 0 if OK, 0xFF if the object does not fit the line
+ **/
+static UNS8 acceptSDOzip (CO_Data* d, UNS8 line, UNS8 confirmed, UNS8 mode, UNS32 size)
+{
+	s_sdo_zip* zip = d->sdoZip;
+
+	if (!zip || zip->mode != SDO_ZIP_REQUESTED || zip->line != line)
+		return 0;
+	if (!confirmed) {
+		MSG_WAR(0x3AF6, "SDO. Compression refused, uncompressed transfer on line : ", line);
+		zip->mode = SDO_ZIP_FREE;
+		zip->fallbacks++;
+		return 0;
+	}
+	if (!zipSDOlineData(d, line, size)) {
+		zip->mode = SDO_ZIP_FREE;
+		return 0xFF;
+	}
+	startSDOzip(zip, line, mode, size);
+	return 0;
+}
+
+/*!
+ ** Count a compressed transfer completed and release the context.
+ **
+ ** @param d
+ ** @param line
+ **/
+static void endSDOzip (CO_Data* d, UNS8 line)
+{
+	s_sdo_zip* zip = zipSDOline(d, line);
+
+	if (!zip)
+		return;
+	zip->transfers++;
+	zip->rawBytes += zip->size;
+	zip->wireBytes += zip->tokenWire + zip->bufLen;
+	zip->mode = SDO_ZIP_FREE;
+	MSG_WAR(0x3AF7, "SDO. Compressed transfer completed on line : ", line);
+}
+#endif
+
+/*!
+ ** Store the data of block segments received, decoded if the transfer is
+ ** compressed.
+ **
+ ** @param d
+ ** @param line
+ ** @param nbBytes
+ ** @param data
+ **
+ ** @return
+ **/
+static UNS8 SDOblockToLine (CO_Data* d, UNS8 line, UNS32 nbBytes, UNS8* data)
+{
+#ifdef CO_ENABLE_SDO_ZIP
+	s_sdo_zip* zip = zipSDOline(d, line);
+
+	if (zip) {
+		if (unzipSDO(zip, zipSDOlineData(d, line, zip->size), data, (UNS8) nbBytes)) {
+			MSG_ERR(0x1AF8, "SDO error : Compressed stream not valid on line : ", line);
+			return 0xFF;
+		}
+		d->transfers[line].offset = zip->rawPos;
+		return 0;
+	}
+#endif
+	return SDOtoLine(d, line, nbBytes, data);
+}
+
+/*!
+ ** Acknowledge of a block by the data consumer : the data producer goes
+ ** on from the first segment not received.
+ **
+ ** @param d
+ ** @param line
+ ** @param AckSeq
+ **
+ ** @return 1 if all the data are acknowledged, 0 to send the next block,
+ ** 0xFF if AckSeq is not valid
+ **/
+static UNS8 ackSDOblock (CO_Data* d, UNS8 line, UNS8 AckSeq)
+{
+	UNS32 nbBytes;
+#ifdef CO_ENABLE_SDO_ZIP
+	s_sdo_zip* zip = zipSDOline(d, line);
+
+	if (zip) {
+		if (AckSeq > d->transfers[line].seqno)
+			return 0xFF;
+		if ((AckSeq == d->transfers[line].seqno) && zip->end && (zip->bufPos == zip->bufLen) && !zip->segLen)
+			return 1;
+		d->transfers[line].offset = d->transfers[line].lastblockoffset + 7 * AckSeq;
+		/* The stream is made again from the first segment lost */
+		if (d->transfers[line].offset != zipSDOwire(zip))
+			zipSDOrewind(zip, zipSDOlineData(d, line, zip->size), d->transfers[line].offset);
+		return 0;
+	}
+#endif
+	getSDOlineRestBytes(d, line, &nbBytes);
+	if ((nbBytes == 0) && (AckSeq == d->transfers[line].seqno))
+		return 1;
+	d->transfers[line].offset = d->transfers[line].lastblockoffset + 7 * AckSeq;
+	if (d->transfers[line].offset > d->transfers[line].count)
+		return 0xFF;
+	return 0;
+}
+
+/*!
+ ** Start of a block sent by the data producer.
+ **
+ ** @param d
+ ** @param line
+ **/
+static void startSDOblock (CO_Data* d, UNS8 line)
+{
+	d->transfers[line].lastblockoffset = d->transfers[line].offset;
+	d->transfers[line].seqno = 0;
+#ifdef CO_ENABLE_SDO_ZIP
+	if (zipSDOline(d, line))
+		zipSDOmark(d->sdoZip);
+#endif
+}
+
+static void SDOBlockPacingAlarm (CO_Data* d, UNS32 id);
+
+/*!
+ ** Send the next segments of the current block, at most burst of them.
+ ** The rest of the block is sent later by SDOBlockPacingAlarm, so that the
+ ** other messages are not delayed by a whole block. A segment refused by the
+ ** CAN driver (Tx queue full) halves the burst and is sent again later.
+ **
+ ** @param d
+ ** @param line
+ **
+ ** @return 0 or 0xFF if the transfer has been aborted
+ **/
+static UNS8 sendSDOblockSegments (CO_Data* d, UNS8 line)
+{
+	UNS8 data[8];
+	UNS8 SeqNo;
+	UNS8 sent = 0;
+	UNS8 last;
+	UNS32 nbBytes;
+	UNS8 i;
+	TIMEVAL pace = US_TO_TIMEVAL(SDO_BLOCK_PACING_US);
+#ifdef CO_ENABLE_SDO_BUDGET
+	TIMEVAL wait;
+#endif
+#ifdef CO_ENABLE_SDO_ZIP
+	s_sdo_zip* zip = zipSDOline(d, line);
+#endif
+
+	while (d->transfers[line].seqno < d->transfers[line].blksize) {
+#ifdef CO_ENABLE_SDO_BUDGET
+		/* Wait for the budget rather than queue a whole block */
+		if ((wait = SDObudgetDelay(d)) != 0) {
+			pace = wait;
+			break;
+		}
+#endif
+		SeqNo = d->transfers[line].seqno + 1;
+#ifdef CO_ENABLE_SDO_ZIP
+		if (zip) {
+			/* Next bytes of the stream, the offset counts them */
+			nbBytes = zipSDOsegment(zip, zipSDOlineData(d, line, zip->size));
+			last = zip->segLast;
+			for (i = 0 ; i < nbBytes ; i++)
+				data[i + 1] = zip->seg[i];
+		}
+		else
+#endif
+		{
+			getSDOlineRestBytes(d, line, &nbBytes);
+			last = nbBytes <= 7;
+			if (!last)
+				nbBytes = 7;
+			if (lineToSDO(d, line, nbBytes, data + 1)) {
+				failedSDO(d, d->transfers[line].CliServNbr, d->transfers[line].whoami,
+						d->transfers[line].index, d->transfers[line].subIndex, SDOABT_GENERAL_ERROR);
+				return 0xFF;
+			}
+		}
+		if (!last) {
+			/* The segment to transfer is not the last one.*/
+			data[0] = SeqNo;
+		}
+		else {
+			/* Last segment is in this block */
+			data[0] = 0x80 | SeqNo;
+			for (i = nbBytes + 1 ; i < 8 ; i++)
+				data[i] = 0;
+		}
+		MSG_WAR(0x3AA5, "SDO. Sending block segment ", SeqNo);
+		if (sendSDO(d, d->transfers[line].whoami, d->transfers[line].CliServNbr, data)) {
+			/* Not sent, retry later at a lower rate */
+#ifdef CO_ENABLE_SDO_ZIP
+			/* The segment of the stream is kept for the retry */
+			if (!zip)
+#endif
+			d->transfers[line].offset -= nbBytes;
+			if (d->transfers[line].burst > 1)
+				d->transfers[line].burst >>= 1;
+			break;
+		}
+#ifdef CO_ENABLE_SDO_ZIP
+		if (zip) {
+			zipSDOsent(zip);
+			d->transfers[line].offset += nbBytes;
+		}
+#endif
+		d->transfers[line].seqno = SeqNo;
+		if (last) {
+			d->transfers[line].endfield = (UNS8) (7 - nbBytes);
+			return 0;
+		}
+		if (++sent >= d->transfers[line].burst)
+			break;
+	}
+	if (d->transfers[line].seqno < d->transfers[line].blksize)
+		d->transfers[line].paceTimer = SetAlarm(d, line, &SDOBlockPacingAlarm, pace, 0);
+	return 0;
+}
+
+/*!
+ ** Send the rest of a block
+ **
+ ** @param d
+ ** @param id
+ **/
+static void SDOBlockPacingAlarm (CO_Data* d, UNS32 id)
+{
+	d->transfers[id].paceTimer = TIMER_NONE;
+	if (d->transfers[id].state == SDO_BLOCK_UPLOAD_IN_PROGRESS ||
+		d->transfers[id].state == SDO_BLOCK_DOWNLOAD_IN_PROGRESS)
+		sendSDOblockSegments(d, (UNS8) id);
+}
+
+/*!
+ ** Adapt the burst of a data producer to the acknowledge of a block :
+ ** one more segment if the whole block was received, half if some were lost.
+ **
+ ** @param d
+ ** @param line
+ ** @param AckSeq
+ **/
+static void adaptSDOblockBurst (CO_Data* d, UNS8 line, UNS8 AckSeq)
+{
+	if (AckSeq < d->transfers[line].seqno) {
+		if (d->transfers[line].burst > 1)
+			d->transfers[line].burst >>= 1;
+	}
+	else if (d->transfers[line].burst < SDO_BLOCK_BURST_MAX)
+		d->transfers[line].burst++;
+}
+
+/*!
+ ** Block size requested by a data consumer for the next block : half the
+ ** current one if segments of the block were lost, one more otherwise, up
+ ** to SDO_BLOCK_SIZE.
+ **
+ ** @param d
+ ** @param line
+ ** @param LastSeqNo Sequence number of the segment ending the block
+ **
+ ** @return the block size
+ **/
+static UNS8 nextSDOblockSize (CO_Data* d, UNS8 line, UNS8 LastSeqNo)
+{
+	if (d->transfers[line].seqno < LastSeqNo) {
+		MSG_WAR(0x3AB8, "SDO. Segments lost in block, last received : ", d->transfers[line].seqno);
+		if (d->transfers[line].blksize > 1)
+			d->transfers[line].blksize >>= 1;
+	}
+	else if (d->transfers[line].blksize < SDO_BLOCK_SIZE)
+		d->transfers[line].blksize++;
+	return d->transfers[line].blksize;
+}
+
+/*!
+ ** Answer an initiate upload request : expedited if the entry fits in the
+ ** response frame, else segmented on a new line.
+ **
+ ** @param d
+ ** @param CliServNbr
+ ** @param index
+ ** @param subIndex
+ **
+ ** @return
+ **/
+static UNS8 serveSDOupload (CO_Data* d, UNS8 CliServNbr, UNS16 index, UNS8 subIndex)
+{
+	UNS8 line;
+	UNS32 nbBytes;
+	UNS32 errorCode;
+	UNS8 dataType;
+	UNS8 data[8];
+	UNS32 i;
+
+	/* Try first to read the data directly in the response frame. It succeeds */
+	/* for all the entries fitting an expedited upload, which need no line. */
+	nbBytes = 4;
+	errorCode = getODentry(d, index, subIndex, (void *) (data + 4), &nbBytes, &dataType, 1);
+	if (errorCode == OD_SUCCESSFUL) {
+		/* Expedited upload. (cs = 2 ; e = 1) */
+		data[0] = (UNS8)((2 << 5) | ((4 - nbBytes) << 2) | 3);
+		data[1] = index & 0xFF;        /* LSB */
+		data[2] = (index >> 8) & 0xFF; /* MSB */
+		data[3] = subIndex;
+		for (i = 4 + nbBytes ; i < 8 ; i++)
+			data[i] = 0;
+		MSG_WAR(0x3A96, "SDO. Sending expedited upload initiate response defined at index 0x1200 + ",
+				CliServNbr);
+		sendSDO(d, SDO_SERVER, CliServNbr, data);
+		return 0;
+	}
+	/* SDOABT_OUT_OF_MEMORY only means the entry is too large for an expedited upload */
+	if (errorCode != SDOABT_OUT_OF_MEMORY) {
+		MSG_ERR(0x1A94, "SDO error : Unable to copy the data from object dictionary. Err code : ",
+				errorCode);
+		failedSDO(d, CliServNbr, SDO_SERVER, index, subIndex, errorCode);
+		return 0xFF;
+	}
+	/* No line on use. Great !*/
+	/* Try to open a new line.*/
+	if (getSDOfreeLine( d, SDO_SERVER, &line )) {
+		MSG_ERR(0x1A71, "SDO error : No line free, too many SDO in progress. Aborted.", 0);
+		failedSDO(d, CliServNbr, SDO_SERVER, index, subIndex, SDOABT_LOCAL_CTRL_ERROR);
+		return 0xFF;
+	}
+	initSDOline(d, line, CliServNbr, index, subIndex, SDO_UPLOAD_IN_PROGRESS);
+	/* Transfer data from dictionary to the line structure. */
+	errorCode = objdictToSDOline(d, line);
+	if (errorCode) {
+		MSG_ERR(0x1A94, "SDO error : Unable to copy the data from object dictionary. Err code : ",
+				errorCode);
+		failedSDO(d, CliServNbr, SDO_SERVER, index, subIndex, errorCode);
+		return 0xFF;
+	}
+	/* Preparing the response.*/
+	getSDOlineRestBytes(d, line, &nbBytes);	/* Nb bytes to transfer ? */
+	/* normal transfer. (segmented). */
+	/* code to send the initiate upload response. (cs = 2) */
+	data[0] = (2 << 5) | 1;
+	data[1] = index & 0xFF;        /* LSB */
+	data[2] = (index >> 8) & 0xFF; /* MSB */
+	data[3] = subIndex;
+	data[4] = (UNS8) nbBytes;
+	data[5] = (UNS8) (nbBytes >> 8);
+	data[6] = (UNS8) (nbBytes >> 16);
+	data[7] = (UNS8) (nbBytes >> 24);
+	MSG_WAR(0x3A95, "SDO. Sending normal upload initiate response defined at index 0x1200 + ", CliServNbr);
+	sendSDO(d, SDO_SERVER, CliServNbr, data);
+	return 0;
+}
+
+/*!
+ ** Answer an initiate block upload request on a new line.
+ **
+ ** @param d
+ ** @param CliServNbr
+ ** @param index
+ ** @param subIndex
+ ** @param peerCRCsupport
+ ** @param blksize
+ ** @param zip The client asks for a compressed transfer
+ **
+ ** @return
+ **/
+static UNS8 serveSDOblockUpload (CO_Data* d, UNS8 CliServNbr, UNS16 index, UNS8 subIndex,
+		UNS8 peerCRCsupport, UNS8 blksize, UNS8 zip)
+{
+	UNS8 line;
+	UNS32 nbBytes;
+	UNS32 errorCode;
+	UNS8 data[8];
+
+	/* Try to open a new line.*/
+	if (getSDOfreeLine( d, SDO_SERVER, &line )) {
+		MSG_ERR(0x1A73, "SDO error : No line free, too many SDO in progress. Aborted.", 0);
+		failedSDO(d, CliServNbr, SDO_SERVER, index, subIndex, SDOABT_LOCAL_CTRL_ERROR);
+		return 0xFF;
+	}
+	initSDOline(d, line, CliServNbr, index, subIndex, SDO_BLOCK_UPLOAD_IN_PROGRESS);
+	d->transfers[line].peerCRCsupport = peerCRCsupport;
+	d->transfers[line].blksize = blksize;
+	/* Transfer data from dictionary to the line structure. */
+	errorCode = objdictToSDOline(d, line);
+	if (errorCode) {
+		MSG_ERR(0x1A95, "SDO error : Unable to copy the data from object dictionary. Err code : ",
+				errorCode);
+		failedSDO(d, CliServNbr, SDO_SERVER, index, subIndex, errorCode);
+		return 0xFF;
+	}
+	/* Preparing the response.*/
+	getSDOlineRestBytes(d, line, &nbBytes);	/* get Nb bytes to transfer */
+	d->transfers[line].objsize = nbBytes;
+	data[0] = (6 << 5) | (1 << 1) | SDO_BSS_INITIATE_UPLOAD_RESPONSE;
+#ifdef CO_ENABLE_SDO_ZIP
+	if (zip && d->sdoZip && d->sdoZip->mode == SDO_ZIP_FREE && nbBytes >= SDO_ZIP_MIN_SIZE) {
+		startSDOzip(d->sdoZip, line, SDO_ZIP_ENCODE, nbBytes);
+		data[0] |= SDO_ZIP_FLAG;
+	}
+#endif
+	data[1] = index & 0xFF;        /* LSB */
+	data[2] = (index >> 8) & 0xFF; /* MSB */
+	data[3] = subIndex;
+	data[4] = (UNS8) nbBytes;
+	data[5] = (UNS8) (nbBytes >> 8);
+	data[6] = (UNS8) (nbBytes >> 16);
+	data[7] = (UNS8) (nbBytes >> 24);
+	MSG_WAR(0x3A9A, "SDO. Sending normal block upload initiate response defined at index 0x1200 + ", CliServNbr);
+	sendSDO(d, SDO_SERVER, CliServNbr, data);
+	return 0;
+}
+
+#ifdef CO_ENABLE_SDO_DEFER
+/*!
+ ** Open a server line waiting for completeSDOtransfer(). The SDO timer
+ ** aborts the transfer if the completion does not come.
+ **
+ ** @param d
+ ** @param CliServNbr
+ ** @param index
+ ** @param subIndex
+ ** @param state SDO_DOWNLOAD_PENDING, SDO_UPLOAD_PENDING or SDO_BLOCK_UPLOAD_PENDING
+ ** @param line
+ **
+ ** @return 0 if OK, 0xFF if no line is free, the abort has been sent
+ **/
+static UNS8 deferSDOline (CO_Data* d, UNS8 CliServNbr, UNS16 index, UNS8 subIndex, UNS8 state, UNS8 *line)
+{
+	if (getSDOfreeLine( d, SDO_SERVER, line )) {
+		MSG_ERR(0x1AF2, "SDO error : No line free to defer the response. Aborted.", 0);
+		failedSDO(d, CliServNbr, SDO_SERVER, index, subIndex, SDOABT_LOCAL_CTRL_ERROR);
+		return 0xFF;
+	}
+	initSDOline(d, *line, CliServNbr, index, subIndex, state);
+	MSG_WAR(0x3AF3, "SDO. Response deferred at line : ", *line);
+	return 0;
+}
+
+/*!
+ ** Keep the response to a download until completeSDOtransfer(), the data
+ ** are already written.
+ **
+ ** @param d
+ ** @param line
+ ** @param data The response frame
+ **/
+static void holdSDOresponse (CO_Data* d, UNS8 line, const UNS8 *data)
+{
+	UNS8 i;
+
+	d->transfers[line].state = SDO_DOWNLOAD_PENDING;
+	RestartSDO_TIMER(line)
+	for (i = 0 ; i < 8 ; i++)
+		d->transfers[line].tmpData[i] = data[i];
+}
+
+/*!
+ ** Call the pre_sdoUpload hook of the node before an upload is served.
+ **
+ ** @param d
+ ** @param CliServNbr
+ ** @param index
+ ** @param subIndex
+ ** @param state Pending state of the line if the response is deferred
+ ** @param line The pending line
+ **
+ ** @return OD_SUCCESSFUL to serve the upload now, OD_PENDING if the
+ ** response is deferred, else an abort has been sent
+ **/
+static UNS32 preSDOupload (CO_Data* d, UNS8 CliServNbr, UNS16 index, UNS8 subIndex, UNS8 state, UNS8 *line)
+{
+	UNS32 errorCode;
+
+	if (!d->pre_sdoUpload)
+		return OD_SUCCESSFUL;
+	errorCode = (*d->pre_sdoUpload)(d, index, subIndex);
+	if (errorCode == OD_PENDING) {
+		if (deferSDOline(d, CliServNbr, index, subIndex, state, line))
+			return SDOABT_LOCAL_CTRL_ERROR;
+	}
+	else if (errorCode != OD_SUCCESSFUL) {
+		MSG_ERR(0x1AF4, "SDO error : Upload refused by pre_sdoUpload. Err code : ", errorCode);
+		failedSDO(d, CliServNbr, SDO_SERVER, index, subIndex, errorCode);
+	}
+	return errorCode;
+}
+
+/*!
+ **
+ **
+ ** @param d
+ ** @param index
+ ** @param subIndex
+ ** @param abortCode
+ **
+ ** @return
+ **/
+UNS8 completeSDOtransfer (CO_Data* d, UNS16 index, UNS8 subIndex, UNS32 abortCode)
+{
+	UNS8 line;
+	UNS8 CliServNbr;
+	UNS8 state;
+	UNS8 peerCRCsupport;
+	UNS8 blksize;
+	UNS8 zip;
+	UNS8 err = 0xFF;
+
+	for (line = 0 ; line < SDO_MAX_SIMULTANEOUS_TRANSFERS ; line++) {
+		state = d->transfers[line].state;
+		if ((d->transfers[line].whoami != SDO_SERVER) ||
+				(d->transfers[line].index != index) || (d->transfers[line].subIndex != subIndex) ||
+				(state != SDO_DOWNLOAD_PENDING && state != SDO_UPLOAD_PENDING && state != SDO_BLOCK_UPLOAD_PENDING))
+			continue;
+		err = 0;
+		CliServNbr = d->transfers[line].CliServNbr;
+		MSG_WAR(0x3AF5, "SDO. Completing deferred response at line : ", line);
+		if (abortCode) {
+			failedSDO(d, CliServNbr, SDO_SERVER, index, subIndex, abortCode);
+		}
+		else if (state == SDO_DOWNLOAD_PENDING) {
+			sendSDO(d, SDO_SERVER, CliServNbr, d->transfers[line].tmpData);
+			resetSDOline(d, line);
+		}
+		else {
+			/* The entry is read now, on a new line */
+			peerCRCsupport = d->transfers[line].peerCRCsupport;
+			blksize = d->transfers[line].blksize;
+			zip = 0;
+#ifdef CO_ENABLE_SDO_ZIP
+			zip = d->sdoZip && d->sdoZip->mode == SDO_ZIP_REQUESTED && d->sdoZip->line == line;
+#endif
+			resetSDOline(d, line);
+			if (state == SDO_UPLOAD_PENDING)
+				serveSDOupload(d, CliServNbr, index, subIndex);
+			else
+				serveSDOblockUpload(d, CliServNbr, index, subIndex, peerCRCsupport, blksize, zip);
+		}
+	}
+	return err;
+}
+#endif
+
 /*!
  **
  **
@@ -888,28 +1692,39 @@ UNS8 proceedSDO (CO_Data* d, Message *m)
 					failedSDO(d, CliServNbr, whoami, index, subIndex, SDOABT_GENERAL_ERROR);
 					return 0xFF;
 				}
-				/* Sending the SDO response, CS = 1 */
+				/* The SDO response, CS = 1 */
 				data[0] = (1 << 5) | (d->transfers[line].toggle << 4);
 				for (i = 1 ; i < 8 ; i++)
 					data[i] = 0;
-				MSG_WAR(0x3A73, "SDO. Send response to download request defined at index 0x1200 + ", CliServNbr);
-				sendSDO(d, whoami, CliServNbr, data);
-				/* Inverting the toggle for the next segment. */
-				d->transfers[line].toggle = ! d->transfers[line].toggle & 1;
-				/* If it was the last segment, */
+				/* If it was the last segment, the data are written before the response */
+				/* so that the client gets an abort if they are refused. */
 				if (getSDOc(m->data[0])) {
 					/* Transfering line data to object dictionary. */
 					/* The code does not use the "d" of initiate frame. So it is safe if e=s=0 */
 					errorCode = SDOlineToObjdict(d, line);
+#ifdef CO_ENABLE_SDO_DEFER
+					if (errorCode == OD_PENDING) {
+						holdSDOresponse(d, line, data);
+						return 0;
+					}
+#endif
 					if (errorCode) {
 						MSG_ERR(0x1A54, "SDO error : Unable to copy the data in the object dictionary", 0);
 						failedSDO(d, CliServNbr, whoami, index, subIndex, errorCode);
 						return 0xFF;
 					}
+				}
+				MSG_WAR(0x3A73, "SDO. Send response to download request defined at index 0x1200 + ", CliServNbr);
+				sendSDO(d, whoami, CliServNbr, data);
+				if (getSDOc(m->data[0])) {
 					/* Release of the line */
 					resetSDOline(d, line);
 					MSG_WAR(0x3A74, "SDO. End of download defined at index 0x1200 + ", CliServNbr);
 				}
+				else {
+					/* Inverting the toggle for the next segment. */
+					d->transfers[line].toggle = ! d->transfers[line].toggle & 1;
+				}
 			} /* end if SERVER */
 			else { /* if CLIENT */
 				/* I am CLIENT */
@@ -947,7 +1762,7 @@ UNS8 proceedSDO (CO_Data* d, Message *m)
 					/* The code is safe for the case e=s=0 in initiate frame. */
 					StopSDO_TIMER(line)
 						d->transfers[line].state = SDO_FINISHED;
-					if(d->transfers[line].Callback) (*d->transfers[line].Callback)(d,nodeId);
+					if(d->transfers[line].Callback) PROFILE_HOOK(d, HOOK_SDO, d->transfers[line].index, d->transfers[line].subIndex, (*d->transfers[line].Callback)(d,nodeId));
 
 					MSG_WAR(0x3A77, "SDO. End of upload from node : ", nodeId);
 				}
@@ -979,42 +1794,40 @@ UNS8 proceedSDO (CO_Data* d, Message *m)
 					failedSDO(d, CliServNbr, whoami, index, subIndex, SDOABT_LOCAL_CTRL_ERROR);
 					return 0xFF;
 				}
-				/* No line on use. Great ! */
-				/* Try to open a new line. */
-				err = getSDOfreeLine( d, whoami, &line );
-				if (err) {
-					MSG_ERR(0x1A82, "SDO error : No line free, too many SDO in progress. Aborted.", 0);
-					failedSDO(d, CliServNbr, whoami, index, subIndex, SDOABT_LOCAL_CTRL_ERROR);
-					return 0xFF;
-				}
-				initSDOline(d, line, CliServNbr, index, subIndex, SDO_DOWNLOAD_IN_PROGRESS);
-
 				if (getSDOe(m->data[0])) { /* If SDO expedited */
+					/* SDO expedited -> transfer finished in one frame. The data are stored */
+					/* directly in the dictionary, without opening a line nor arming a timer. */
+					MSG_WAR(0x3A83, "SDO Initiate Download is an expedited transfer. Finished. ", 0);
 					/* nb of data to be downloaded */
 					nbBytes = 4 - getSDOn2(m->data[0]);
-					/* Storing the data in the line structure. */
-					d->transfers[line].count = nbBytes;
-					err = SDOtoLine(d, line, nbBytes, (*m).data + 4);
-
-					if (err) {
-						failedSDO(d, CliServNbr, whoami, index, subIndex, SDOABT_GENERAL_ERROR);
-						return 0xFF;
+					/* setODentry may endianize in place : work on a copy of the frame data. */
+					for (i = 0 ; i < nbBytes ; i++)
+						data[i] = m->data[4 + i];
+					errorCode = setODentry(d, index, subIndex, (void *) data, &nbBytes, 1);
+#ifdef CO_ENABLE_SDO_DEFER
+					if (errorCode == OD_PENDING) {
+						if (deferSDOline(d, CliServNbr, index, subIndex, SDO_DOWNLOAD_PENDING, &line))
+							return 0xFF;
 					}
-
-					/* SDO expedited -> transfer finished. Data can be stored in the dictionary. */
-					/*The line will be reseted when it is downloading in the dictionary. */
-					MSG_WAR(0x3A83, "SDO Initiate Download is an expedited transfer. Finished. ", 0);
-					/* Transfering line data to object dictionary. */
-					errorCode = SDOlineToObjdict(d, line);
+					else
+#endif
 					if (errorCode) {
 						MSG_ERR(0x1A84, "SDO error : Unable to copy the data in the object dictionary", 0);
 						failedSDO(d, CliServNbr, whoami, index, subIndex, errorCode);
 						return 0xFF;
 					}
-					/* Release of the line. */
-					resetSDOline(d, line);
 				}
 				else {/* So, if it is not an expedited transfer */
+					/* No line on use. Great ! */
+					/* Try to open a new line. */
+					err = getSDOfreeLine( d, whoami, &line );
+					if (err) {
+						MSG_ERR(0x1A82, "SDO error : No line free, too many SDO in progress. Aborted.", 0);
+						failedSDO(d, CliServNbr, whoami, index, subIndex, SDOABT_LOCAL_CTRL_ERROR);
+						return 0xFF;
+					}
+					initSDOline(d, line, CliServNbr, index, subIndex, SDO_DOWNLOAD_IN_PROGRESS);
+
 					if (getSDOs(m->data[0])) {
 						nbBytes = (m->data[4]) + ((UNS32)(m->data[5])<<8) + ((UNS32)(m->data[6])<<16) + ((UNS32)(m->data[7])<<24);
 						err = setSDOlineRestBytes(d, line, nbBytes);
@@ -1031,6 +1844,12 @@ UNS8 proceedSDO (CO_Data* d, Message *m)
 				data[3] = subIndex;
 				for (i = 4 ; i < 8 ; i++)
 					data[i] = 0;
+#ifdef CO_ENABLE_SDO_DEFER
+				if (getSDOe(m->data[0]) && errorCode == OD_PENDING) {
+					holdSDOresponse(d, line, data);
+					return 0;
+				}
+#endif
 				sendSDO(d, whoami, CliServNbr, data);
 			} /* end if I am SERVER */
 			else {
@@ -1060,7 +1879,7 @@ UNS8 proceedSDO (CO_Data* d, Message *m)
 					MSG_WAR(0x3A87, "SDO End download. segment response received. OK. from nodeId", nodeId);
 					StopSDO_TIMER(line)
 						d->transfers[line].state = SDO_FINISHED;
-					if(d->transfers[line].Callback) (*d->transfers[line].Callback)(d,nodeId);
+					if(d->transfers[line].Callback) PROFILE_HOOK(d, HOOK_SDO, d->transfers[line].index, d->transfers[line].subIndex, (*d->transfers[line].Callback)(d,nodeId));
 					return 0x00;
 				}
 				/* At least one transfer to send.	*/
@@ -1110,59 +1929,12 @@ UNS8 proceedSDO (CO_Data* d, Message *m)
 					failedSDO(d, CliServNbr, whoami, index, subIndex, SDOABT_LOCAL_CTRL_ERROR);
 					return 0xFF;
 				}
-				/* No line on use. Great !*/
-				/* Try to open a new line.*/
-				err = getSDOfreeLine( d, whoami, &line );
-				if (err) {
-					MSG_ERR(0x1A71, "SDO error : No line free, too many SDO in progress. Aborted.", 0);
-					failedSDO(d, CliServNbr, whoami, index, subIndex, SDOABT_LOCAL_CTRL_ERROR);
-					return 0xFF;
-				}
-				initSDOline(d, line, CliServNbr, index, subIndex, SDO_UPLOAD_IN_PROGRESS);
-				/* Transfer data from dictionary to the line structure. */
-				errorCode = objdictToSDOline(d, line);
-
-				if (errorCode) {
-					MSG_ERR(0x1A94, "SDO error : Unable to copy the data from object dictionary. Err code : ",
-							errorCode);
-					failedSDO(d, CliServNbr, whoami, index, subIndex, errorCode);
-					return 0xFF;
-				}
-				/* Preparing the response.*/
-				getSDOlineRestBytes(d, line, &nbBytes);	/* Nb bytes to transfer ? */
-				if (nbBytes > 4) {
-					/* normal transfer. (segmented). */
-					/* code to send the initiate upload response. (cs = 2) */
-					data[0] = (2 << 5) | 1;
-					data[1] = index & 0xFF;        /* LSB */
-					data[2] = (index >> 8) & 0xFF; /* MSB */
-					data[3] = subIndex;
-					data[4] = (UNS8) nbBytes;
-					data[5] = (UNS8) (nbBytes >> 8);
-					data[6] = (UNS8) (nbBytes >> 16);
-					data[7] = (UNS8) (nbBytes >> 24);
- 					MSG_WAR(0x3A95, "SDO. Sending normal upload initiate response defined at index 0x1200 + ", nodeId);
-					sendSDO(d, whoami, CliServNbr, data);
-				}
-				else {
-					/* Expedited upload. (cs = 2 ; e = 1) */
-					data[0] = (UNS8)((2 << 5) | ((4 - nbBytes) << 2) | 3);
-					data[1] = index & 0xFF;        /* LSB */
-					data[2] = (index >> 8) & 0xFF; /* MSB */
-					data[3] = subIndex;
-					err = lineToSDO(d, line, nbBytes, data + 4);
-					if (err) {
-						failedSDO(d, CliServNbr, whoami, index, subIndex, SDOABT_GENERAL_ERROR);
-						return 0xFF;
-					}
-					for (i = 4 + nbBytes ; i < 8 ; i++)
-						data[i] = 0;
-					MSG_WAR(0x3A96, "SDO. Sending expedited upload initiate response defined at index 0x1200 + ",
-							CliServNbr);
-					sendSDO(d, whoami, CliServNbr, data);
-					/* Release the line.*/
-					resetSDOline(d, line);
-				}
+#ifdef CO_ENABLE_SDO_DEFER
+				errorCode = preSDOupload(d, CliServNbr, index, subIndex, SDO_UPLOAD_PENDING, &line);
+				if (errorCode != OD_SUCCESSFUL)
+					return errorCode == OD_PENDING ? 0 : 0xFF;
+#endif
+				return serveSDOupload(d, CliServNbr, index, subIndex);
 			} /* end if I am SERVER*/
 			else {
 				/* I am CLIENT */
@@ -1194,7 +1966,7 @@ UNS8 proceedSDO (CO_Data* d, Message *m)
 					StopSDO_TIMER(line)
 						d->transfers[line].count = nbBytes;
 					d->transfers[line].state = SDO_FINISHED;
-					if(d->transfers[line].Callback) (*d->transfers[line].Callback)(d,nodeId);
+					if(d->transfers[line].Callback) PROFILE_HOOK(d, HOOK_SDO, d->transfers[line].index, d->transfers[line].subIndex, (*d->transfers[line].Callback)(d,nodeId));
 					return 0;
 				}
 				else { /* So, if it is not an expedited transfer */
@@ -1295,7 +2067,7 @@ UNS8 proceedSDO (CO_Data* d, Message *m)
 					MSG_WAR(0x3AA6, "SDO End download expedited. Response received. from nodeId", nodeId);
 					StopSDO_TIMER(line)
 						d->transfers[line].state = SDO_FINISHED;
-					if(d->transfers[line].Callback) (*d->transfers[line].Callback)(d,nodeId);
+					if(d->transfers[line].Callback) PROFILE_HOOK(d, HOOK_SDO, d->transfers[line].index, d->transfers[line].subIndex, (*d->transfers[line].Callback)(d,nodeId));
 					return 0x00;
 				}
 				if (nbBytes > 7) {
@@ -1350,7 +2122,7 @@ UNS8 proceedSDO (CO_Data* d, Message *m)
 						d->transfers[line].state = SDO_ABORTED_RCV;
 					d->transfers[line].abortCode = abortCode;
 					MSG_WAR(0x3AB0, "SD0. Received SDO abort. Line state ABORTED. Code : ", abortCode);
-					if(d->transfers[line].Callback) (*d->transfers[line].Callback)(d,nodeId);
+					if(d->transfers[line].Callback) PROFILE_HOOK(d, HOOK_SDO, d->transfers[line].index, d->transfers[line].subIndex, (*d->transfers[line].Callback)(d,nodeId));
 				}
 				else
 					MSG_WAR(0x3AB1, "SD0. Received SDO abort. No line found. Code : ", abortCode);
@@ -1373,38 +2145,25 @@ UNS8 proceedSDO (CO_Data* d, Message *m)
 					    failedSDO(d, CliServNbr, whoami, index, subIndex, SDOABT_LOCAL_CTRL_ERROR);
 					    return 0xFF;
 				    }
-				    /* No line on use. Great !*/
-				    /* Try to open a new line.*/
-				    err = getSDOfreeLine( d, whoami, &line );
-				    if (err) {
-					    MSG_ERR(0x1A73, "SDO error : No line free, too many SDO in progress. Aborted.", 0);
-					    failedSDO(d, CliServNbr, whoami, index, subIndex, SDOABT_LOCAL_CTRL_ERROR);
-					    return 0xFF;
+#ifdef CO_ENABLE_SDO_DEFER
+				    errorCode = preSDOupload(d, CliServNbr, index, subIndex, SDO_BLOCK_UPLOAD_PENDING, &line);
+				    if (errorCode == OD_PENDING) {
+					    d->transfers[line].peerCRCsupport = ((m->data[0])>>2) & 1;
+					    d->transfers[line].blksize = m->data[4];
+#ifdef CO_ENABLE_SDO_ZIP
+					    /* Keep the context for the response */
+					    if (((m->data[0]) & SDO_ZIP_FLAG) && d->sdoZip && d->sdoZip->mode == SDO_ZIP_FREE) {
+						    d->sdoZip->mode = SDO_ZIP_REQUESTED;
+						    d->sdoZip->line = line;
+					    }
+#endif
+					    return 0;
 				    }
-				    initSDOline(d, line, CliServNbr, index, subIndex, SDO_BLOCK_UPLOAD_IN_PROGRESS);
-                    d->transfers[line].peerCRCsupport = ((m->data[0])>>2) & 1;
-                    d->transfers[line].blksize = m->data[4];
-				    /* Transfer data from dictionary to the line structure. */
-				    errorCode = objdictToSDOline(d, line);
-				    if (errorCode) {
-					    MSG_ERR(0x1A95, "SDO error : Unable to copy the data from object dictionary. Err code : ",
-							errorCode);
-					    failedSDO(d, CliServNbr, whoami, index, subIndex, errorCode);
+				    if (errorCode != OD_SUCCESSFUL)
 					    return 0xFF;
-				    }
- 				    /* Preparing the response.*/
-				    getSDOlineRestBytes(d, line, &nbBytes);	/* get Nb bytes to transfer */
-                    d->transfers[line].objsize = nbBytes;
-                    data[0] = (6 << 5) | (1 << 1) | SDO_BSS_INITIATE_UPLOAD_RESPONSE;
-					data[1] = index & 0xFF;        /* LSB */
-					data[2] = (index >> 8) & 0xFF; /* MSB */
-					data[3] = subIndex;
-					data[4] = (UNS8) nbBytes;
-					data[5] = (UNS8) (nbBytes >> 8);
-					data[6] = (UNS8) (nbBytes >> 16);
-					data[7] = (UNS8) (nbBytes >> 24);
-					MSG_WAR(0x3A9A, "SDO. Sending normal block upload initiate response defined at index 0x1200 + ", nodeId);
-					sendSDO(d, whoami, CliServNbr, data);
+#endif
+				    return serveSDOblockUpload(d, CliServNbr, index, subIndex, ((m->data[0])>>2) & 1, m->data[4],
+						    ((m->data[0])>>3) & 1);
                 }
 				else if (SubCommand == SDO_BCS_END_UPLOAD_REQUEST) {
 				    MSG_WAR(0x3AA2, "Received SDO block END upload request defined at index 0x1200 + ", CliServNbr);
@@ -1417,6 +2176,9 @@ UNS8 proceedSDO (CO_Data* d, Message *m)
 					    failedSDO(d, CliServNbr, whoami, 0, 0, SDOABT_LOCAL_CTRL_ERROR);
 					    return 0xFF;
 				    }
+#ifdef CO_ENABLE_SDO_ZIP
+					endSDOzip(d, line);
+#endif
                     /* Release the line */
 					resetSDOline(d, line);
                 }
@@ -1439,8 +2201,9 @@ UNS8 proceedSDO (CO_Data* d, Message *m)
 					    MSG_WAR(0x3AA2, "Received SDO block upload response defined at index 0x1200 + ", CliServNbr);
                         d->transfers[line].blksize = m->data[2];
                         AckSeq = (m->data[1]) & 0x7f;
-                        getSDOlineRestBytes(d, line, &nbBytes);
-                        if((nbBytes == 0) && (AckSeq == d->transfers[line].seqno)){ /* Si tout est envoyé et confirmé reçu on envoi un block end upload response */
+                        adaptSDOblockBurst(d, line, AckSeq);
+                        err = ackSDOblock(d, line, AckSeq);
+                        if(err == 1){ /* Si tout est envoyé et confirmé reçu on envoi un block end upload response */
                             data[0] = (6 << 5) | ((d->transfers[line].endfield) << 2) | SDO_BSS_END_UPLOAD_RESPONSE;
                             for (i = 1 ; i < 8 ; i++)
 						        data[i] = 0;
@@ -1448,9 +2211,7 @@ UNS8 proceedSDO (CO_Data* d, Message *m)
 					        sendSDO(d, whoami, CliServNbr, data);
                             break;
                         }
-                        else
-                            d->transfers[line].offset = d->transfers[line].lastblockoffset + 7 * AckSeq;
-                        if(d->transfers[line].offset > d->transfers[line].count) { /* Bad AckSeq reveived (too high) */
+                        if(err) { /* Bad AckSeq reveived (too high) */
 					        MSG_ERR(0x1AA1, "SDO error : Received upload response with bad ackseq index 0x1200 + ",
 							    CliServNbr);
 					        failedSDO(d, CliServNbr, whoami, 0, 0, SDOABT_LOCAL_CTRL_ERROR);
@@ -1459,37 +2220,10 @@ UNS8 proceedSDO (CO_Data* d, Message *m)
            			}
                     else
 					    MSG_WAR(0x3AA2, "Received SDO block START upload defined at index 0x1200 + ", CliServNbr);
-                    d->transfers[line].lastblockoffset = (UNS8) d->transfers[line].offset;
-                    for(SeqNo = 1 ; SeqNo <= d->transfers[line].blksize ; SeqNo++) {
-                        d->transfers[line].seqno = SeqNo;
-				        getSDOlineRestBytes(d, line, &nbBytes);
-                        if (nbBytes > 7) {
-					        /* The segment to transfer is not the last one.*/
- 					        data[0] = SeqNo;
-					        err = lineToSDO(d, line, 7, data + 1);
-					        if (err) {
-						        failedSDO(d, CliServNbr, whoami, index, subIndex, SDOABT_GENERAL_ERROR);
-						        return 0xFF;
-					        }
-					        MSG_WAR(0x3AA5, "SDO. Sending upload segment defined at index 0x1200 + ", CliServNbr);
-					        sendSDO(d, whoami, CliServNbr, data);
-				        }
-				        else {
-					        /* Last segment is in this block */
-					        data[0] = 0x80 | SeqNo;
-					        err = lineToSDO(d, line, nbBytes, data + 1);
-					        if (err) {
-						        failedSDO(d, CliServNbr, whoami, index, subIndex, SDOABT_GENERAL_ERROR);
-						        return 0xFF;
-					        }
-					        for (i = nbBytes + 1 ; i < 8 ; i++)
-						        data[i] = 0;
-					        MSG_WAR(0x3AA5, "SDO. Sending last upload segment defined at index 0x1200 + ", CliServNbr);
-					        sendSDO(d, whoami, CliServNbr, data);
-                            d->transfers[line].endfield = (UNS8) (7 - nbBytes);
-                            break;
-				        }
-                    }
+                    startSDOblock(d, line);
+                    StopSDO_PACING(line)
+                    if (sendSDOblockSegments(d, line))
+                        return 0xFF;
                 }
 			}      /* end if SERVER */
 			else { /* if CLIENT (block download) */
@@ -1509,12 +2243,16 @@ UNS8 proceedSDO (CO_Data* d, Message *m)
                         subIndex = d->transfers[line].subIndex;
                         d->transfers[line].peerCRCsupport = ((m->data[0])>>2) & 1;
                         d->transfers[line].blksize = m->data[4];
+#ifdef CO_ENABLE_SDO_ZIP
+                        acceptSDOzip(d, line, (m->data[0]) & SDO_ZIP_FLAG, SDO_ZIP_ENCODE, d->transfers[line].count);
+#endif
                     }
                     else {
                     	d->transfers[line].blksize = m->data[2];
                         AckSeq = (m->data[1]) & 0x7f;
-                        getSDOlineRestBytes(d, line, &nbBytes);
-                        if((nbBytes == 0) && (AckSeq == d->transfers[line].seqno)){ /* Si tout est envoyé et confirmé reçu on envoi un block end download request */
+                        adaptSDOblockBurst(d, line, AckSeq);
+                        err = ackSDOblock(d, line, AckSeq);
+                        if(err == 1){ /* Si tout est envoyé et confirmé reçu on envoi un block end download request */
                             data[0] = (6 << 5) | ((d->transfers[line].endfield) << 2) | SDO_BCS_END_DOWNLOAD_REQUEST;
                             for (i = 1 ; i < 8 ; i++)
 						        data[i] = 0;
@@ -1522,52 +2260,26 @@ UNS8 proceedSDO (CO_Data* d, Message *m)
 					        sendSDO(d, whoami, CliServNbr, data);
                             break;
                         }
-                        else
-                            d->transfers[line].offset = d->transfers[line].lastblockoffset + 7 * AckSeq;
-                        if(d->transfers[line].offset > d->transfers[line].count) { /* Bad AckSeq reveived (too high) */
+                        if(err) { /* Bad AckSeq reveived (too high) */
 					        MSG_ERR(0x1AA1, "SDO error : Received upload segment with bad ackseq index 0x1200 + ",
 							    CliServNbr);
 					        failedSDO(d, CliServNbr, whoami, 0, 0, SDOABT_LOCAL_CTRL_ERROR);
 					        return 0xFF;
                         }
 					}
-                 	d->transfers[line].lastblockoffset = (UNS8) d->transfers[line].offset;
-                	for(SeqNo = 1 ; SeqNo <= d->transfers[line].blksize ; SeqNo++) {
-                        d->transfers[line].seqno = SeqNo;
-				        getSDOlineRestBytes(d, line, &nbBytes);
-                        if (nbBytes > 7) {
-					        /* The segment to transfer is not the last one.*/
- 					        data[0] = SeqNo;
-					        err = lineToSDO(d, line, 7, data + 1);
-					        if (err) {
-						        failedSDO(d, CliServNbr, whoami, index, subIndex, SDOABT_GENERAL_ERROR);
-						        return 0xFF;
-					        }
-					        MSG_WAR(0x3AAB, "SDO. Sending download segment to node id ", nodeId);
-					        sendSDO(d, whoami, CliServNbr, data);
-				        }
-				        else {
-					        /* Last segment is in this block */
-					        data[0] = 0x80 | SeqNo;
-					        err = lineToSDO(d, line, nbBytes, data + 1);
-					        if (err) {
-						        failedSDO(d, CliServNbr, whoami, index, subIndex, SDOABT_GENERAL_ERROR);
-						        return 0xFF;
-					        }
-					        for (i = nbBytes + 1 ; i < 8 ; i++)
-						        data[i] = 0;
-					        MSG_WAR(0x3AAB, "SDO. Sending last download segment to node id ", nodeId);
-					        sendSDO(d, whoami, CliServNbr, data);
-                            d->transfers[line].endfield = (UNS8) (7 - nbBytes);
-                            break;
-				        }
-                    }
+                 	startSDOblock(d, line);
+                 	StopSDO_PACING(line)
+                 	if (sendSDOblockSegments(d, line))
+                 	    return 0xFF;
 				}
 				else if (SubCommand == SDO_BSS_END_DOWNLOAD_RESPONSE) {
 					MSG_WAR(0x3AAC, "SDO End block download response from nodeId", nodeId);
+#ifdef CO_ENABLE_SDO_ZIP
+					endSDOzip(d, line);
+#endif
 					StopSDO_TIMER(line)
 					d->transfers[line].state = SDO_FINISHED;
-					if(d->transfers[line].Callback) (*d->transfers[line].Callback)(d,nodeId);
+					if(d->transfers[line].Callback) PROFILE_HOOK(d, HOOK_SDO, d->transfers[line].index, d->transfers[line].subIndex, (*d->transfers[line].Callback)(d,nodeId));
 					return 0x00;
 				}
 				else {
@@ -1606,9 +2318,18 @@ UNS8 proceedSDO (CO_Data* d, Message *m)
 					if ((m->data[0]) & 2)	/* if data set size is indicated */
                     	d->transfers[line].objsize = (UNS32)m->data[4] + (UNS32)m->data[5]*256 + (UNS32)m->data[6]*256*256 + (UNS32)m->data[7]*256*256*256;
                     data[0] = (5 << 5) | SDO_BSS_INITIATE_DOWNLOAD_RESPONSE;
+#ifdef CO_ENABLE_SDO_ZIP
+					/* The stream is decoded in the line, the size of the object is needed */
+					if (((m->data[0]) & SDO_ZIP_FLAG) && ((m->data[0]) & 2) && d->sdoZip && d->sdoZip->mode == SDO_ZIP_FREE &&
+							zipSDOlineData(d, line, d->transfers[line].objsize)) {
+						startSDOzip(d->sdoZip, line, SDO_ZIP_DECODE, d->transfers[line].objsize);
+						data[0] |= SDO_ZIP_FLAG;
+					}
+#endif
 					data[1] = (UNS8) index;        /* LSB */
 					data[2] = (UNS8) (index >> 8); /* MSB */
 					data[3] = subIndex;
+					d->transfers[line].blksize = SDO_BLOCK_SIZE;
 					data[4] = SDO_BLOCK_SIZE;
 					data[5] = data[6] = data[7] = 0;
 					MSG_WAR(0x3AAD, "SDO. Sending block download initiate response - index 0x1200 + ", CliServNbr);
@@ -1627,7 +2348,7 @@ UNS8 proceedSDO (CO_Data* d, Message *m)
 						}
 						data[0] = (5 << 5) | SDO_BSS_DOWNLOAD_RESPONSE;
 						data[1] = d->transfers[line].seqno;
-						data[2] = SDO_BLOCK_SIZE;
+						data[2] = nextSDOblockSize(d, line, SeqNo);
 						data[3] = data[4] = data[5] = data[6] = data[7] = 0;
 						MSG_WAR(0x3AAE, "SDO. Sending block download response - index 0x1200 + ", CliServNbr);
 						sendSDO(d, whoami, CliServNbr, data);
@@ -1637,16 +2358,16 @@ UNS8 proceedSDO (CO_Data* d, Message *m)
 					   	if (SeqNo == (d->transfers[line].seqno + 1)) {	
 							d->transfers[line].seqno = SeqNo;
 							/* Store the data in the transfer structure. */
-							err = SDOtoLine(d, line, 7, (*m).data + 1);
+							err = SDOblockToLine(d, line, 7, (*m).data + 1);
 							if (err) {
 								failedSDO(d, CliServNbr, whoami, d->transfers[line].index,  d->transfers[line].subIndex, SDOABT_GENERAL_ERROR);
 								return 0xFF;
 							}
 						}
-						if (SeqNo == SDO_BLOCK_SIZE) {
+						if (SeqNo == d->transfers[line].blksize) {
 							data[0] = (5 << 5) | SDO_BSS_DOWNLOAD_RESPONSE;
 							data[1] = d->transfers[line].seqno;
-							data[2] = SDO_BLOCK_SIZE;
+							data[2] = nextSDOblockSize(d, line, SeqNo);
 							data[3] = data[4] = data[5] = data[6] = data[7] = 0;
 							MSG_WAR(0x3AAE, "SDO. Sending block download response - index 0x1200 + ", CliServNbr);
 							sendSDO(d, whoami, CliServNbr, data);
@@ -1665,7 +2386,7 @@ UNS8 proceedSDO (CO_Data* d, Message *m)
     		    	RestartSDO_TIMER(line)
 					NbBytesNoData = (m->data[0]>>2) & 0x07;
 					/* Store the data in the transfer structure. */
-					err = SDOtoLine(d, line, 7-NbBytesNoData, d->transfers[line].tmpData + 1);
+					err = SDOblockToLine(d, line, 7-NbBytesNoData, d->transfers[line].tmpData + 1);
 					if (err) {
 						failedSDO(d, CliServNbr, whoami, d->transfers[line].index,  d->transfers[line].subIndex, SDOABT_GENERAL_ERROR);
 						return 0xFF;
@@ -1677,18 +2398,28 @@ UNS8 proceedSDO (CO_Data* d, Message *m)
 	    						return 0xFF;
 						}
 					}
+#ifdef CO_ENABLE_SDO_ZIP
+					endSDOzip(d, line);
+#endif
 					data[0] = (5 << 5) | SDO_BSS_END_DOWNLOAD_RESPONSE;
 					for (i = 1 ; i < 8 ; i++)
 						data[i] = 0;
-					MSG_WAR(0x3AAF, "SDO. Sending block download end response - index 0x1200 + ", CliServNbr);
-					sendSDO(d, whoami, CliServNbr, data);
-					/* Transfering line data to object dictionary. */
+					/* Transfering line data to object dictionary, before the response */
+					/* so that the client gets an abort if they are refused. */
 					errorCode = SDOlineToObjdict(d, line);
+#ifdef CO_ENABLE_SDO_DEFER
+					if (errorCode == OD_PENDING) {
+						holdSDOresponse(d, line, data);
+						return 0;
+					}
+#endif
 					if (errorCode) {
 						MSG_ERR(0x1AAF, "SDO error : Unable to copy the data in the object dictionary", 0);
 						failedSDO(d, CliServNbr, whoami, d->transfers[line].index, d->transfers[line].subIndex, errorCode);
 						return 0xFF;
 					}
+					MSG_WAR(0x3AAF, "SDO. Sending block download end response - index 0x1200 + ", CliServNbr);
+					sendSDO(d, whoami, CliServNbr, data);
 					/* Release of the line */
 					resetSDOline(d, line);
 					MSG_WAR(0x3AAF, "SDO. End of block download defined at index 0x1200 + ", CliServNbr);
@@ -1709,6 +2440,13 @@ UNS8 proceedSDO (CO_Data* d, Message *m)
                         d->transfers[line].peerCRCsupport = ((m->data[0])>>2) & 1;
 					    if ((m->data[0]) & 2)	/* if data set size is indicated */
                     	    d->transfers[line].objsize = (UNS32)m->data[4] + (UNS32)m->data[5]*256 + (UNS32)m->data[6]*256*256 + (UNS32)m->data[7]*256*256*256;
+#ifdef CO_ENABLE_SDO_ZIP
+                        if (acceptSDOzip(d, line, (m->data[0]) & SDO_ZIP_FLAG, SDO_ZIP_DECODE, d->transfers[line].objsize)) {
+                            MSG_ERR(0x1AF9, "SDO error : No buffer for the compressed upload from node id ", nodeId);
+                            failedSDO(d, CliServNbr, whoami, d->transfers[line].index, d->transfers[line].subIndex, SDOABT_OUT_OF_MEMORY);
+                            return 0xFF;
+                        }
+#endif
                         data[0] = (5 << 5) | SDO_BCS_START_UPLOAD;
 					    for (i = 1 ; i < 8 ; i++)
 						    data[i] = 0;
@@ -1727,7 +2465,7 @@ UNS8 proceedSDO (CO_Data* d, Message *m)
 						}
 						data[0] = (5 << 5) | SDO_BCS_UPLOAD_RESPONSE;
 						data[1] = d->transfers[line].seqno;
-						data[2] = SDO_BLOCK_SIZE;
+						data[2] = nextSDOblockSize(d, line, SeqNo);
 						data[3] = data[4] = data[5] = data[6] = data[7] = 0;
 						MSG_WAR(0x3AB7, "SDO. Sending block upload response to node id ", nodeId);
 						sendSDO(d, whoami, CliServNbr, data);
@@ -1737,16 +2475,16 @@ UNS8 proceedSDO (CO_Data* d, Message *m)
 					   	if (SeqNo == (d->transfers[line].seqno + 1)) {	
 							d->transfers[line].seqno = SeqNo;
 							/* Store the data in the transfer structure. */
-							err = SDOtoLine(d, line, 7, (*m).data + 1);
+							err = SDOblockToLine(d, line, 7, (*m).data + 1);
 							if (err) {
 								failedSDO(d, CliServNbr, whoami, d->transfers[line].index,  d->transfers[line].subIndex, SDOABT_GENERAL_ERROR);
 								return 0xFF;
 							}
 						}
-						if (SeqNo == SDO_BLOCK_SIZE) {
+						if (SeqNo == d->transfers[line].blksize) {
 							data[0] = (5 << 5) | SDO_BCS_UPLOAD_RESPONSE;
 							data[1] = d->transfers[line].seqno;
-							data[2] = SDO_BLOCK_SIZE;
+							data[2] = nextSDOblockSize(d, line, SeqNo);
 							data[3] = data[4] = data[5] = data[6] = data[7] = 0;
 							MSG_WAR(0x3AAE, "SDO. Sending block upload response to node id ", nodeId);
 							sendSDO(d, whoami, CliServNbr, data);
@@ -1763,7 +2501,7 @@ UNS8 proceedSDO (CO_Data* d, Message *m)
 					}
 					NbBytesNoData = (m->data[0]>>2) & 0x07;
 					/* Store the data in the transfer structure. */
-					err = SDOtoLine(d, line, 7-NbBytesNoData, d->transfers[line].tmpData + 1);
+					err = SDOblockToLine(d, line, 7-NbBytesNoData, d->transfers[line].tmpData + 1);
 					if (err) {
 						failedSDO(d, CliServNbr, whoami, d->transfers[line].index,  d->transfers[line].subIndex, SDOABT_GENERAL_ERROR);
 						return 0xFF;
@@ -1781,9 +2519,12 @@ UNS8 proceedSDO (CO_Data* d, Message *m)
 					MSG_WAR(0x3AAF, "SDO. Sending block upload end request to node id ", nodeId);
 					sendSDO(d, whoami, CliServNbr, data);
 					MSG_WAR(0x3AAF, "SDO. End of block upload request", 0);
+#ifdef CO_ENABLE_SDO_ZIP
+					endSDOzip(d, line);
+#endif
                     StopSDO_TIMER(line)
 					d->transfers[line].state = SDO_FINISHED;
-				    if(d->transfers[line].Callback) (*d->transfers[line].Callback)(d,nodeId);
+				    if(d->transfers[line].Callback) PROFILE_HOOK(d, HOOK_SDO, d->transfers[line].index, d->transfers[line].subIndex, (*d->transfers[line].Callback)(d,nodeId));
 				}
 			}      /* end if CLIENT */
 			break;
@@ -1947,6 +2688,14 @@ INLINE UNS8 _writeNetworkDict (CO_Data* d, UNS8 nodeId, UNS16 index,
 	}
     if(useBlockMode) {
 	    buf[0] = (6 << 5) | (1 << 1 );   /* CCS = 6 , CC = 0 , S = 1 , CS = 0 */
+#ifdef CO_ENABLE_SDO_ZIP
+	    /* Compressed if the server has the capability, confirmed by its response */
+	    if (d->sdoZip && d->sdoZip->mode == SDO_ZIP_FREE && count >= SDO_ZIP_MIN_SIZE && getSDOzipPeer(d, nodeId) == 1) {
+		    d->sdoZip->mode = SDO_ZIP_REQUESTED;
+		    d->sdoZip->line = line;
+		    buf[0] |= SDO_ZIP_FLAG;
+	    }
+#endif
  	    for (i = 0 ; i < 4 ; i++)
 		    buf[i+4] = (UNS8)((count >> (i<<3))); /* i*8 */
     }
@@ -2122,9 +2871,17 @@ INLINE UNS8 _readNetworkDict (CO_Data* d, UNS8 nodeId, UNS16 index, UNS8 subInde
 	    /* Send the SDO to the server. Initiate block upload, cs=0. */
 	    d->transfers[line].dataType = dataType;
 	    data[0] = (5 << 5) | SDO_BCS_INITIATE_UPLOAD_REQUEST;
+#ifdef CO_ENABLE_SDO_ZIP
+	    if (d->sdoZip && d->sdoZip->mode == SDO_ZIP_FREE && getSDOzipPeer(d, nodeId) == 1) {
+		    d->sdoZip->mode = SDO_ZIP_REQUESTED;
+		    d->sdoZip->line = line;
+		    data[0] |= SDO_ZIP_FLAG;
+	    }
+#endif
 	    data[1] = index & 0xFF;        /* LSB */
 	    data[2] = (index >> 8) & 0xFF; /* MSB */
 	    data[3] = subIndex;
+	    d->transfers[line].blksize = SDO_BLOCK_SIZE;
 	    data[4] = SDO_BLOCK_SIZE;
 	    for (i = 5 ; i < 8 ; i++)
 		    data[i] = 0;
@@ -0,0 +1,399 @@
+/*
+This file is part of CanFestival, a library implementing CanOpen Stack.
+
+Copyright (C): Edouard TISSERANT and Francis DUPIN
+
+See COPYING file for copyrights details.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+USA
+*/
+
+/*!
+** @file   sdozip.c
+** @author Edouard TISSERANT and Francis DUPIN
+**
+** @brief Compressed block transfers
+**
+** The stream is LZ77, the matches pointing back at most SDO_ZIP_WINDOW
+** bytes into the object. The decoder writes the object in the data of the
+** line, where the matches are read back. The encoder reads the object in
+** the data of the line and makes one token at a time, so a lost segment
+** cannot be sent again from a buffer: the encoder goes back to the token
+** of the first segment of the block and makes the stream again. The hash
+** only gives the last position of each hash, and positions older than the
+** window are not used, so it is rebuilt from the window before that token
+** and the same tokens come out.
+*/
+
+#include <string.h>
+#include "data.h"
+#include "sdozip.h"
+
+#ifdef CO_ENABLE_SDO_ZIP
+
+/* Decoder states */
+#define ZIP_TOKEN 0
+#define ZIP_LITERALS 1
+#define ZIP_DIST_LOW 2
+#define ZIP_DIST_HIGH 3
+
+/*!
+**
+**
+** @param zip
+**/
+void initSDOzip(s_sdo_zip* zip)
+{
+  memset(zip, 0, sizeof(*zip));
+}
+
+/*!
+**
+**
+** @param d
+** @param zip
+**/
+void setSDOzip(CO_Data* d, s_sdo_zip* zip)
+{
+  d->sdoZip = zip;
+}
+
+/*!
+** Result of the read of the capability object.
+**
+** @param d
+** @param nodeId
+**/
+static void probeSDOzipCallback(CO_Data* d, UNS8 nodeId)
+{
+  s_sdo_zip* zip = d->sdoZip;
+  UNS32 capability = 0;
+  UNS32 size = sizeof(capability);
+  UNS32 abortCode;
+  UNS8 res;
+
+  res = getReadResultNetworkDict(d, nodeId, &capability, &size, &abortCode);
+  closeSDOtransfer(d, nodeId, SDO_CLIENT);
+  if(!zip)
+    return;
+  zip->known[nodeId >> 3] |= 1 << (nodeId & 7);
+  if(res == SDO_FINISHED && (capability & SDO_ZIP_CAPABILITY_LZ))
+    zip->capable[nodeId >> 3] |= 1 << (nodeId & 7);
+  else
+    zip->capable[nodeId >> 3] &= ~(1 << (nodeId & 7));
+  MSG_WAR(0x3F20, "SDO compression capability of node : ", nodeId);
+}
+
+/*!
+**
+**
+** @param d
+** @param nodeId
+**
+** @return
+**/
+UNS8 probeSDOzip(CO_Data* d, UNS8 nodeId)
+{
+  if(!d->sdoZip || nodeId > 127)
+    return 0xFF;
+  return readNetworkDictCallback(d, nodeId, SDO_ZIP_CAPABILITY_INDEX, 0, 0, probeSDOzipCallback, 0) ? 0xFF : 0;
+}
+
+/*!
+**
+**
+** @param d
+** @param nodeId
+**
+** @return
+**/
+UNS8 getSDOzipPeer(CO_Data* d, UNS8 nodeId)
+{
+  s_sdo_zip* zip = d->sdoZip;
+
+  if(!zip || nodeId > 127 || !(zip->known[nodeId >> 3] & (1 << (nodeId & 7))))
+    return SDO_ZIP_PEER_UNKNOWN;
+  return (zip->capable[nodeId >> 3] >> (nodeId & 7)) & 1;
+}
+
+/*!
+** Give the context to a transfer.
+**
+** @param zip
+** @param line
+** @param mode
+** @param size Bytes of the object
+**/
+void startSDOzip(s_sdo_zip* zip, UNS8 line, UNS8 mode, UNS32 size)
+{
+  zip->mode = mode;
+  zip->line = line;
+  zip->end = 0;
+  zip->size = size;
+  zip->rawPos = 0;
+  zip->hashPos = 0;
+  zip->tokenRaw = 0;
+  zip->tokenWire = 0;
+  zip->markRaw = 0;
+  zip->markWire = 0;
+  zip->bufLen = 0;
+  zip->bufPos = 0;
+  zip->segLen = 0;
+  zip->state = ZIP_TOKEN;
+  if(mode == SDO_ZIP_ENCODE)
+    memset(zip->hash, 0, sizeof(zip->hash));
+}
+
+/*!
+**
+**
+** @param raw Three bytes
+**
+** @return
+**/
+static UNS32 zipHash(const UNS8* raw)
+{
+  UNS32 v = ((UNS32)raw[0] << 16) | ((UNS32)raw[1] << 8) | raw[2];
+
+  return (v * 2654435761U) >> (32 - SDO_ZIP_HASH_BITS);
+}
+
+/*!
+** Longest match at a position, with the positions before it in the hash.
+**
+** @param zip
+** @param raw
+** @param pos
+** @param dist Distance of the match
+**
+** @return Length of the match, 0 if none
+**/
+static UNS32 zipMatch(s_sdo_zip* zip, const UNS8* raw, UNS32 pos, UNS32* dist)
+{
+  UNS32 cand;
+  UNS32 len;
+  UNS32 max;
+
+  if(pos + SDO_ZIP_MATCH_MIN > zip->size)
+    return 0;
+  for(; zip->hashPos < pos; zip->hashPos++)
+    zip->hash[zipHash(raw + zip->hashPos)] = zip->hashPos + 1;
+  cand = zip->hash[zipHash(raw + pos)];
+  if(!cand || pos - (cand - 1) > SDO_ZIP_WINDOW)
+    return 0;
+  cand--;
+  max = zip->size - pos;
+  if(max > SDO_ZIP_MATCH_MAX)
+    max = SDO_ZIP_MATCH_MAX;
+  for(len = 0; len < max && raw[cand + len] == raw[pos + len]; len++)
+    ;
+  if(len < SDO_ZIP_MATCH_MIN)
+    return 0;
+  *dist = pos - cand;
+  return len;
+}
+
+/*!
+** Make the next token in buf.
+**
+** @param zip
+** @param raw
+**/
+static void zipToken(s_sdo_zip* zip, const UNS8* raw)
+{
+  UNS32 len;
+  UNS32 dist;
+  UNS32 n;
+
+  zip->tokenRaw = zip->rawPos;
+  zip->tokenWire += zip->bufLen;
+  zip->bufPos = 0;
+  if(zip->rawPos == zip->size){
+    zip->buf[0] = SDO_ZIP_END;
+    zip->bufLen = 1;
+    zip->end = 1;
+    return;
+  }
+  len = zipMatch(zip, raw, zip->rawPos, &dist);
+  if(len){
+    zip->buf[0] = (UNS8)(0x80 | (len - SDO_ZIP_MATCH_MIN));
+    zip->buf[1] = (UNS8)(dist - 1);
+    zip->buf[2] = (UNS8)((dist - 1) >> 8);
+    zip->bufLen = 3;
+    zip->rawPos += len;
+    return;
+  }
+  /* Literals up to the next match */
+  for(n = 1; n < SDO_ZIP_LITERAL_MAX && zip->rawPos + n < zip->size; n++)
+    if(zipMatch(zip, raw, zip->rawPos + n, &dist))
+      break;
+  zip->buf[0] = (UNS8)(n - 1);
+  memcpy(zip->buf + 1, raw + zip->rawPos, n);
+  zip->bufLen = (UNS8)(n + 1);
+  zip->rawPos += n;
+}
+
+/*!
+** Make the next segment of the stream, or give back the one not sent.
+** The segment is in seg, segLast is set if it holds the end token.
+**
+** @param zip
+** @param raw The object
+**
+** @return Number of bytes of the segment
+**/
+UNS8 zipSDOsegment(s_sdo_zip* zip, const UNS8* raw)
+{
+  if(zip->segLen)
+    return zip->segLen;
+  zip->segRaw = zip->tokenRaw;
+  zip->segWire = zip->tokenWire;
+  if(zip->bufPos == zip->bufLen && !zip->end){
+    zipToken(zip, raw);
+    zip->segRaw = zip->tokenRaw;
+    zip->segWire = zip->tokenWire;
+  }
+  while(zip->segLen < 7){
+    if(zip->bufPos == zip->bufLen){
+      if(zip->end)
+        break;
+      zipToken(zip, raw);
+    }
+    zip->seg[zip->segLen++] = zip->buf[zip->bufPos++];
+  }
+  zip->segLast = zip->end && zip->bufPos == zip->bufLen;
+  return zip->segLen;
+}
+
+/*!
+**
+**
+** @param zip
+**/
+void zipSDOsent(s_sdo_zip* zip)
+{
+  zip->segLen = 0;
+}
+
+/*!
+** Stream position of the next segment to send.
+**
+** @param zip
+**
+** @return
+**/
+UNS32 zipSDOwire(s_sdo_zip* zip)
+{
+  return zip->tokenWire + zip->bufPos - zip->segLen;
+}
+
+/*!
+** Keep the token of the first segment of a block, to send it again.
+**
+** @param zip
+**/
+void zipSDOmark(s_sdo_zip* zip)
+{
+  if(zip->segLen){
+    zip->markRaw = zip->segRaw;
+    zip->markWire = zip->segWire;
+  }
+  else{
+    zip->markRaw = zip->tokenRaw;
+    zip->markWire = zip->tokenWire;
+  }
+}
+
+/*!
+** Go back in the stream of the block, to send the segments lost again.
+**
+** @param zip
+** @param raw The object
+** @param wire Stream position, not before the block
+**/
+void zipSDOrewind(s_sdo_zip* zip, const UNS8* raw, UNS32 wire)
+{
+  zip->rawPos = zip->markRaw;
+  zip->tokenWire = zip->markWire;
+  zip->bufLen = 0;
+  zip->bufPos = 0;
+  zip->segLen = 0;
+  zip->end = 0;
+  memset(zip->hash, 0, sizeof(zip->hash));
+  zip->hashPos = zip->markRaw > SDO_ZIP_WINDOW ? zip->markRaw - SDO_ZIP_WINDOW : 0;
+  zipToken(zip, raw);
+  while(zip->tokenWire + zip->bufLen < wire && !zip->end)
+    zipToken(zip, raw);
+  zip->bufPos = (UNS8)(wire - zip->tokenWire);
+  MSG_WAR(0x3F21, "SDO compressed stream sent again from : ", wire);
+}
+
+/*!
+** Decode stream bytes into the object.
+**
+** @param zip
+** @param raw The object, zip->size bytes
+** @param data
+** @param nbBytes
+**
+** @return 0 if OK, 0xFF if the stream is not valid
+**/
+UNS8 unzipSDO(s_sdo_zip* zip, UNS8* raw, const UNS8* data, UNS8 nbBytes)
+{
+  UNS32 dist;
+  UNS8 c;
+
+  for(; nbBytes && !zip->end; nbBytes--){
+    c = *data++;
+    zip->tokenWire++;
+    switch(zip->state){
+    case ZIP_TOKEN:
+      if(c == SDO_ZIP_END)
+        zip->end = 1;
+      else if(c & 0x80){
+        zip->run = (UNS8)((c & 0x7F) + SDO_ZIP_MATCH_MIN);
+        zip->state = ZIP_DIST_LOW;
+      }
+      else{
+        zip->run = (UNS8)(c + 1);
+        zip->state = ZIP_LITERALS;
+      }
+      break;
+    case ZIP_LITERALS:
+      if(zip->rawPos >= zip->size)
+        return 0xFF;
+      raw[zip->rawPos++] = c;
+      if(!--zip->run)
+        zip->state = ZIP_TOKEN;
+      break;
+    case ZIP_DIST_LOW:
+      zip->distLow = c;
+      zip->state = ZIP_DIST_HIGH;
+      break;
+    default:
+      dist = ((UNS32)c << 8 | zip->distLow) + 1;
+      if(dist > zip->rawPos || zip->run > zip->size - zip->rawPos)
+        return 0xFF;
+      for(; zip->run; zip->run--, zip->rawPos++)
+        raw[zip->rawPos] = raw[zip->rawPos - dist];
+      zip->state = ZIP_TOKEN;
+      break;
+    }
+  }
+  return 0;
+}
+
+#endif /* CO_ENABLE_SDO_ZIP */
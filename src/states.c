@@ -63,6 +63,16 @@ e_nodeState getState(CO_Data* d)
 void canDispatch(CO_Data* d, Message *m)
 {
 	UNS16 cob_id = UNS16_LE(m->cob_id);
+#ifdef CO_ENABLE_CMD_QUEUE
+	/* Commands posted by the application threads first */
+	if(d->cmdQueue)
+		_runCommands(d);
+#endif
+#ifdef CO_ENABLE_OD_SUBSCRIPTIONS
+	/* Changes made while processing the message are published at once */
+	if(d->odSubscriptions)
+		_beginODChangePass(d);
+#endif
 	 switch(cob_id >> 7)
 	{
 		case SYNC:		/* can be a SYNC or a EMCY message */
@@ -115,6 +125,72 @@ void canDispatch(CO_Data* d, Message *m)
 			break;
 #endif
 	}
+#ifdef CO_ENABLE_OD_SUBSCRIPTIONS
+	if(d->odSubscriptions)
+		_endODChangePass(d);
+#endif
+}
+
+/* Dispatch order of canDispatchBatch, by CANopen priority */
+#define DISPATCH_NMT		0
+#define DISPATCH_SYNC		1
+#define DISPATCH_EMCY		2
+#define DISPATCH_TIME		3
+#define DISPATCH_PDO		4
+#define DISPATCH_SDO		5 /* and LSS */
+#define DISPATCH_HEARTBEAT	6 /* and node guarding */
+#define DISPATCH_CLASSES	7
+
+/*!
+** Priority class of a message
+**
+** @param m
+**
+** @return DISPATCH_NMT .. DISPATCH_HEARTBEAT
+**/
+static UNS8 dispatchClass(Message const *m)
+{
+	UNS16 cob_id = UNS16_LE(m->cob_id);
+	switch(cob_id >> 7)
+	{
+		case NMT:		return DISPATCH_NMT;
+		case SYNC:		return cob_id == 0x080 ? DISPATCH_SYNC : DISPATCH_EMCY;
+		case TIME_STAMP:	return DISPATCH_TIME;
+		case SDOtx:
+		case SDOrx:
+		case LSS:		return DISPATCH_SDO;
+		case NODE_GUARD:	return DISPATCH_HEARTBEAT;
+		default:		return DISPATCH_PDO;
+	}
+}
+
+/*!
+** Dispatch pending messages by priority class: NMT, SYNC, EMCY, TIME,
+** PDO, SDO, then heartbeat. The messages of a class keep their order, so
+** do the messages of a COB-ID.
+**
+** @param d
+** @param m
+** @param count
+**/
+void canDispatchBatch(CO_Data* d, Message *m, UNS16 count)
+{
+	UNS8 present = 0; /* Classes found in the batch */
+	UNS8 class;
+	UNS16 i;
+
+	for(i = 0; i < count; i++)
+		present |= 1 << dispatchClass(&m[i]);
+
+	/* One pass per class found, down to the last one */
+	for(class = 0; present; class++, present >>= 1)
+	{
+		if(!(present & 1))
+			continue;
+		for(i = 0; i < count; i++)
+			if(dispatchClass(&m[i]) == class)
+				canDispatch(d, &m[i]);
+	}
 }
 
 #define StartOrStop(CommType, FuncStart, FuncStop) \
@@ -167,7 +243,7 @@ UNS8 setState(CO_Data* d, e_nodeState newState)
 				switchCommunicationState(d, &newCommunicationState);
 				/* call user app init callback now. */
 				/* d->initialisation MUST NOT CALL SetState */
-				(*d->initialisation)(d);				
+				PROFILE_HOOK(d, HOOK_INITIALISATION, 0, 0, (*d->initialisation)(d));				
 			}
 
 			/* Automatic transition - No break statement ! */
@@ -181,7 +257,7 @@ UNS8 setState(CO_Data* d, e_nodeState newState)
 				s_state_communication newCommunicationState = {0, 1, 1, 1, 1, 0, 1};
 				d->nodeState = Pre_operational;
 				switchCommunicationState(d, &newCommunicationState);
-                (*d->preOperational)(d);
+                PROFILE_HOOK(d, HOOK_PRE_OPERATIONAL, 0, 0, (*d->preOperational)(d));
 			}
 			break;
 								
@@ -192,7 +268,7 @@ UNS8 setState(CO_Data* d, e_nodeState newState)
 				d->nodeState = Operational;
 				newState = Operational;
 				switchCommunicationState(d, &newCommunicationState);
-				(*d->operational)(d);
+				PROFILE_HOOK(d, HOOK_OPERATIONAL, 0, 0, (*d->operational)(d));
 			}
 			break;
 						
@@ -203,7 +279,7 @@ UNS8 setState(CO_Data* d, e_nodeState newState)
 				d->nodeState = Stopped;
 				newState = Stopped;
 				switchCommunicationState(d, &newCommunicationState);
-				(*d->stopped)(d);
+				PROFILE_HOOK(d, HOOK_STOPPED, 0, 0, (*d->stopped)(d));
 			}
 			break;
 			default:
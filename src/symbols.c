@@ -8,7 +8,9 @@
 // CanFestival symbols available to other kernel modules
 
 // dcf.h
+#ifndef CO_PROFILE_SLAVE
 EXPORT_SYMBOL (send_consise_dcf);
+#endif
 
 // emcy.h
 EXPORT_SYMBOL (_post_emcy);
@@ -42,7 +44,9 @@ EXPORT_SYMBOL (getConfigResultNetworkNode);
 // nmtMaster.h
 EXPORT_SYMBOL (masterSendNMTstateChange);
 EXPORT_SYMBOL (masterSendNMTnodeguard);
+#ifndef CO_PROFILE_SLAVE
 EXPORT_SYMBOL (masterRequestNodeState);
+#endif
 
 // nmtSlave.h
 EXPORT_SYMBOL (proceedNMTstateChange);
@@ -95,6 +99,9 @@ EXPORT_SYMBOL (readNetworkDict);
 EXPORT_SYMBOL (readNetworkDictCallback);
 EXPORT_SYMBOL (getReadResultNetworkDict);
 EXPORT_SYMBOL (getWriteResultNetworkDict);
+#ifdef CO_ENABLE_SDO_DEFER
+EXPORT_SYMBOL (completeSDOtransfer);
+#endif
 
 // states.h
 EXPORT_SYMBOL (_initialisation);
@@ -53,6 +53,58 @@ void SyncAlarm(CO_Data* d, UNS32 id);
 UNS32 OnCOB_ID_SyncUpdate(CO_Data* d, const indextable * unsused_indextable, 
 	UNS8 unsused_bSubindex);
 
+#ifdef CO_ENABLE_TXTIME
+/* syncLaunchTime value once the driver refused a launch time */
+#define SYNC_TXTIME_UNSUPPORTED ((UNS64)-1)
+
+/*!
+** Queue the SYNC one cycle period ahead, with a launch time, so that it
+** leaves at a precise instant whatever the timer and scheduling jitter.
+** The synchronous TPDOs are queued with the same launch time, right
+** behind the SYNC. Their data are thus sampled one period before they
+** are sent.
+**
+** @param d
+**
+** @return 1 if the SYNC was queued, 0 if it must be sent immediately
+**/
+static UNS8 sendScheduledSYNC(CO_Data* d)
+{
+  Message m;
+  UNS64 period = (UNS64)*d->Sync_Cycle_Period * 1000;
+  UNS64 now;
+  UNS8 res;
+
+  if (d->syncLaunchTime == SYNC_TXTIME_UNSUPPORTED)
+    return 0;
+
+  /* (Re)start the schedule if it is not started yet or fell behind */
+  now = canTxTime();
+  if (d->syncLaunchTime <= now)
+    d->syncLaunchTime = now + period;
+
+  MSG_WAR(0x3003, "sendSYNC scheduled ", 0);
+
+  m.cob_id = (UNS16)UNS16_LE(*d->COB_ID_Sync);
+  m.rtr = NOT_A_REQUEST;
+  m.len = 0;
+
+  res = canSendAt(d->canHandle, &m, d->syncLaunchTime);
+  if (res == CAN_TXTIME_UNSUPPORTED) {
+    MSG_WAR(0x3004, "SYNC launch time not supported by the CAN driver", 0);
+    d->syncLaunchTime = SYNC_TXTIME_UNSUPPORTED;
+    return 0;
+  }
+
+  d->txLaunchTime = d->syncLaunchTime;
+  proceedSYNC(d);
+  d->txLaunchTime = 0;
+
+  d->syncLaunchTime += period;
+  return 1;
+}
+#endif
+
 /*!                                                                                                
 **                                                                                                 
 **                                                                                                 
@@ -61,6 +113,10 @@ UNS32 OnCOB_ID_SyncUpdate(CO_Data* d, const indextable * unsused_indextable,
 **/   
 void SyncAlarm(CO_Data* d, UNS32 id)
 {
+#ifdef CO_ENABLE_TXTIME
+	if (sendScheduledSYNC(d))
+		return;
+#endif
 	sendSYNC(d) ;
 }
 
@@ -93,6 +149,10 @@ void startSYNC(CO_Data* d)
 	RegisterSetODentryCallBack(d, 0x1005, 0, &OnCOB_ID_SyncUpdate);
 	RegisterSetODentryCallBack(d, 0x1006, 0, &OnCOB_ID_SyncUpdate);
 
+#ifdef CO_ENABLE_TXTIME
+	d->syncLaunchTime = 0;
+#endif
+
 	if(*d->COB_ID_Sync & 0x40000000ul && *d->Sync_Cycle_Period)
 	{
 		d->syncTimer = SetAlarm(
@@ -169,8 +229,13 @@ UNS8 proceedSYNC(CO_Data* d)
   UNS8 res;
   
   MSG_WAR(0x3002, "SYNC received. Proceed. ", 0);
+
+#ifdef CO_ENABLE_PDO_REMAP
+  /* The staged PDO mappings apply from this SYNC on */
+  commitPDOMappings(d);
+#endif
   
-  (*d->post_sync)(d);
+  PROFILE_HOOK(d, HOOK_POST_SYNC, 0, 0, (*d->post_sync)(d));
 
   /* only operational state allows PDO transmission */
   if(! d->CurrentCommunicationState.csPDO) 
@@ -179,7 +244,7 @@ UNS8 proceedSYNC(CO_Data* d)
   res = _sendSyncPDOevent(d);
   
   /*Call user app callback*/
-  (*d->post_TPDO)(d);
+  PROFILE_HOOK(d, HOOK_POST_TPDO, 0, 0, (*d->post_TPDO)(d));
   
   return res;
   
@@ -36,13 +36,20 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include "timer.h"
 
 /*  ---------  The timer table --------- */
-s_timer_entry timers[MAX_NB_TIMER] = {{TIMER_FREE, NULL, NULL, 0, 0, 0},};
-
-TIMEVAL total_sleep_time = TIMEVAL_MAX;
-TIMER_HANDLE last_timer_raw = -1;
+#ifdef CO_ENABLE_TIMER_CONTEXTS
+/* The timers driver gives the table of the calling thread */
+#define timer_table() getTimerContext()
+#else
+s_timer_context timer_context = TIMER_CONTEXT_INITIALIZER;
+#define timer_table() (&timer_context)
+#endif
 
 #define min_val(a,b) ((a<b)?a:b)
 
+/* Latest time an armed row may be trigged, relative to the last dispatch */
+#define row_deadline(row) \
+	((row)->slack > TIMEVAL_MAX - (row)->val ? TIMEVAL_MAX : (row)->val + (row)->slack)
+
 /*!
 ** -------  Use this to declare a new alarm ------
 **
@@ -56,11 +63,33 @@ TIMER_HANDLE last_timer_raw = -1;
 **/
 TIMER_HANDLE SetAlarm(CO_Data* d, UNS32 id, TimerCallback_t callback, TIMEVAL value, TIMEVAL period)
 {
+	return SetAlarmWithSlack(d, id, callback, value, period, 0);
+}
+
+/*!
+** -------  Use this to declare an alarm that can be delayed ------
+**
+** The alarm is trigged at most slack after value, together with the
+** alarms due at the same wake-up. A periodic alarm can also be trigged up
+** to slack before its time, the following periods are kept.
+**
+** @param d
+** @param id
+** @param callback
+** @param value
+** @param period
+** @param slack
+**
+** @return
+**/
+TIMER_HANDLE SetAlarmWithSlack(CO_Data* d, UNS32 id, TimerCallback_t callback, TIMEVAL value, TIMEVAL period, TIMEVAL slack)
+{
+	s_timer_context *tc = timer_table();
 	TIMER_HANDLE row_number;
 	s_timer_entry *row;
 
 	/* in order to decide new timer setting we have to run over all timer rows */
-	for(row_number=0, row=timers; row_number <= last_timer_raw + 1 && row_number < MAX_NB_TIMER; row_number++, row++)
+	for(row_number=0, row=tc->timers; row_number <= tc->last_timer_raw + 1 && row_number < MAX_NB_TIMER; row_number++, row++)
 	{
 		if (callback && 	/* if something to store */
 		   row->state == TIMER_FREE) /* and empty row */
@@ -68,16 +97,15 @@ TIMER_HANDLE SetAlarm(CO_Data* d, UNS32 id, TimerCallback_t callback, TIMEVAL va
 			TIMEVAL real_timer_value;
 			TIMEVAL elapsed_time;
 
-			if (row_number == last_timer_raw + 1) last_timer_raw++;
+			if (row_number == tc->last_timer_raw + 1) tc->last_timer_raw++;
 
 			elapsed_time = getElapsedTime();
 			/* set next wakeup alarm if new entry is sooner than others, or if it is alone */
-			real_timer_value = value;
-			real_timer_value = min_val(real_timer_value, TIMEVAL_MAX);
+			real_timer_value = slack > TIMEVAL_MAX - value ? TIMEVAL_MAX : value + slack;
 
-			if (total_sleep_time > elapsed_time && total_sleep_time - elapsed_time > real_timer_value)
+			if (tc->total_sleep_time > elapsed_time && tc->total_sleep_time - elapsed_time > real_timer_value)
 			{
-				total_sleep_time = elapsed_time + real_timer_value;
+				tc->total_sleep_time = elapsed_time + real_timer_value;
 				setTimer(real_timer_value);
 			}
 			row->callback = callback;
@@ -85,6 +113,7 @@ TIMER_HANDLE SetAlarm(CO_Data* d, UNS32 id, TimerCallback_t callback, TIMEVAL va
 			row->id = id;
 			row->val = value + elapsed_time;
 			row->interval = period;
+			row->slack = slack;
 			row->state = TIMER_ARMED;
 			return row_number;
 		}
@@ -106,9 +135,10 @@ TIMER_HANDLE DelAlarm(TIMER_HANDLE handle)
 	MSG_WAR(0x3320, "DelAlarm. handle = ", handle);
 	if(handle != TIMER_NONE)
 	{
-		if(handle == last_timer_raw)
-			last_timer_raw--;
-		timers[handle].state = TIMER_FREE;
+		s_timer_context *tc = timer_table();
+		if(handle == tc->last_timer_raw)
+			tc->last_timer_raw--;
+		tc->timers[handle].state = TIMER_FREE;
 	}
 	return TIMER_NONE;
 }
@@ -120,22 +150,25 @@ TIMER_HANDLE DelAlarm(TIMER_HANDLE handle)
 int tdcount=0;
 void TimeDispatch(void)
 {
+	s_timer_context *tc = timer_table();
 	TIMER_HANDLE i;
 	TIMEVAL next_wakeup = TIMEVAL_MAX; /* used to compute when should normaly occur next wakeup */
 	/* First run : change timer state depending on time */
 	/* Get time since timer signal */
 	UNS32 overrun = (UNS32)getElapsedTime();
 
-	TIMEVAL real_total_sleep_time = total_sleep_time + overrun;
+	TIMEVAL real_total_sleep_time = tc->total_sleep_time + overrun;
+	UNS32 trigged = 0;
 
 	s_timer_entry *row;
 
-	for(i=0, row = timers; i <= last_timer_raw; i++, row++)
+	for(i=0, row = tc->timers; i <= tc->last_timer_raw; i++, row++)
 	{
 		if (row->state & TIMER_ARMED) /* if row is active */
 		{
 			if (row->val <= real_total_sleep_time) /* to be trigged */
 			{
+				trigged++;
 				if (!row->interval) /* if simply outdated */
 				{
 					row->state = TIMER_TRIG; /* ask for trig */
@@ -144,33 +177,48 @@ void TimeDispatch(void)
 				{
 					/* set val as interval, with 32 bit overrun correction, */
 					/* modulo for 64 bit not available on all platforms     */
-					row->val = row->interval - (overrun % (UNS32)row->interval);
+					row->val = row->interval - ((UNS32)(real_total_sleep_time - row->val) % (UNS32)row->interval);
 					row->state = TIMER_TRIG_PERIOD; /* ask for trig, periodic */
 					/* Check if this new timer value is the soonest */
-					if(row->val < next_wakeup)
-						next_wakeup = row->val;
+					if(row_deadline(row) < next_wakeup)
+						next_wakeup = row_deadline(row);
 				}
 			}
+			else if (row->interval && row->val - real_total_sleep_time <= row->slack)
+			{
+				/* Periodic and due within its slack : trigged now, */
+				/* the next period starts from its time             */
+				trigged++;
+				row->val = row->interval + (row->val - real_total_sleep_time);
+				row->state = TIMER_TRIG_PERIOD;
+				if(row_deadline(row) < next_wakeup)
+					next_wakeup = row_deadline(row);
+			}
 			else
 			{
 				/* Each armed timer value in decremented. */
 				row->val -= real_total_sleep_time;
 
 				/* Check if this new timer value is the soonest */
-				if(row->val < next_wakeup)
-					next_wakeup = row->val;
+				if(row_deadline(row) < next_wakeup)
+					next_wakeup = row_deadline(row);
 			}
 		}
 	}
 
+	tc->stats.wakeups++;
+	tc->stats.alarms += trigged;
+	if (!trigged)
+		tc->stats.idle++;
+
 	/* Remember how much time we should sleep. */
-	total_sleep_time = next_wakeup;
+	tc->total_sleep_time = next_wakeup;
 
 	/* Set timer to soonest occurence */
 	setTimer(next_wakeup);
 
 	/* Then trig them or not. */
-	for(i=0, row = timers; i<=last_timer_raw; i++, row++)
+	for(i=0, row = tc->timers; i<=tc->last_timer_raw; i++, row++)
 	{
 		if (row->state & TIMER_TRIG)
 		{
@@ -179,4 +227,9 @@ void TimeDispatch(void)
 				(*row->callback)(row->d, row->id); /* trig ! */
 		}
 	}
+
+#ifdef CO_ENABLE_CMD_QUEUE
+	/* After the alarms, so that the alarms the commands set start from now */
+	_runCommandQueues();
+#endif
 }